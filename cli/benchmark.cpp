@@ -0,0 +1,454 @@
+#include "benchmark.h"
+#include "../src/footprint.h"
+#include "../src/trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static const char * precisionName[3] = {"double", "float", "q16"};
+static const char * phaseName[BENCH_PHASES] = {"setup", "allocate", "tables", "solve", "export"};
+
+// record of a run sent from the forked process (the phases come first)
+enum {REC_WALL = BENCH_PHASES, REC_PEAK, REC_START, REC_EXPORT, REC_VALUE, REC_SIZE};
+
+// ===================================================
+
+/** Resident set size of the process in MB (0 if unknown). */
+static double rssMB(){
+  ifstream f("/proc/self/statm");
+  long pages = 0, resident = 0;
+  if (!(f >> pages >> resident)) return(0);
+  return((double)resident*sysconf(_SC_PAGESIZE)/1048576);
+}
+
+/** Peak resident set size of the process in MB. */
+static double peakRssMB(){
+  struct rusage u;
+  getrusage(RUSAGE_SELF, &u);
+#ifdef __APPLE__
+  return((double)u.ru_maxrss/1048576);   // bytes
+#else
+  return((double)u.ru_maxrss/1024);      // kB
+#endif
+}
+
+/** Median of the values. */
+static double median(vector<double> v){
+  sort(v.begin(), v.end());
+  int n = v.size();
+  return(n%2==1 ? v[n/2] : (v[n/2-1]+v[n/2])/2);
+}
+
+// ===================================================
+
+string BenchCase::name() const {
+  ostringstream s;
+  for(size_t i=0; i<sizes.size(); i++) s << (i>0 ? "x" : "") << sizes[i];
+  s << ":" << tMax << ":" << opNum;
+  return(s.str());
+}
+
+// ===================================================
+
+BenchCase BenchCase::Parse(const string & spec, const ModelParam & base){
+  BenchCase c;
+  c.tMax = base.tMax;
+  c.opNum = base.opNum;
+  istringstream s(spec);
+  string grid, token;
+  getline(s, grid, ':');
+  if (getline(s, token, ':')) c.tMax = atoi(token.c_str());
+  if (getline(s, token, ':')) c.opNum = atoi(token.c_str());
+  istringstream g(grid);
+  while (getline(g, token, 'x')) c.sizes.push_back(atoi(token.c_str()));
+  bool ok = (c.sizes.size()==6) && (c.tMax>1) && (c.opNum>0);
+  for(size_t i=0; i<c.sizes.size(); i++) ok = ok && (c.sizes[i]>0);
+  if (!ok) throw runtime_error("Cannot parse the benchmark case " + spec + " (use MWxSWxMPxSPxTxP[:tMax[:opNum]])");
+  return(c);
+}
+
+// ===================================================
+
+ScalingBenchmark::ScalingBenchmark(const ModelParam & base, ostream & out) : base(base), out(out),
+  precision(MDPV::PREC_DOUBLE), exportCsv(true) {}
+
+// ===================================================
+
+vector<BenchCase> ScalingBenchmark::DefaultCases() const {
+  const char * grids[] = {"5x1x3x2x3x4", "9x1x3x2x3x4", "17x1x3x2x3x4", "33x1x3x2x3x4",   // MW
+                          "9x2x3x2x3x4", "9x1x6x2x3x4", "9x1x6x4x3x4",                    // SW, MP and SP
+                          "9x1x3x2x6x4", "9x1x3x2x6x8"};                                  // weather
+  vector<BenchCase> cases;
+  for(size_t i=0; i<sizeof(grids)/sizeof(grids[0]); i++) cases.push_back(BenchCase::Parse(grids[i], base));
+  BenchCase c = BenchCase::Parse("9x1x3x2x3x4", base);
+  int tMax = c.tMax;
+  c.tMax = tMax/2;                  // horizon
+  cases.push_back(c);
+  c.tMax = 2*tMax;
+  cases.push_back(c);
+  c.tMax = tMax;
+  for(int n=1; n<=2*base.opNum; n*=2){   // operations
+    if (n==base.opNum) continue;
+    c.opNum = n;
+    cases.push_back(c);
+  }
+  return(cases);
+}
+
+// ===================================================
+
+void ScalingBenchmark::Regrid(vector<double> & centers, DisMat & dis, int n, vector<double> * vals1, vector<double> * vals2){
+  int nb = centers.size();
+  if (n==nb) return;
+  vector<double> c(n), v1(n), v2(n);
+  for(int j=0; j<n; j++){
+    if (nb==1) {   // range [c/2, 2c]
+      double lo = centers[0]>0 ? centers[0]/2 : centers[0]-1;
+      double hi = centers[0]>0 ? 2*centers[0] : centers[0]+1;
+      c[j] = (n==1) ? centers[0] : lo + (hi-lo)*j/(n-1);
+      if (vals1!=NULL) v1[j] = (*vals1)[0];
+      if (vals2!=NULL) v2[j] = (*vals2)[0];
+      continue;
+    }
+    double pos = (n==1) ? (nb-1)/2.0 : (double)j*(nb-1)/(n-1);
+    int i = min((int)pos, nb-2);
+    double w = pos-i;
+    c[j] = (1-w)*centers[i] + w*centers[i+1];
+    if (vals1!=NULL) v1[j] = (1-w)*(*vals1)[i] + w*(*vals1)[i+1];
+    if (vals2!=NULL) v2[j] = (1-w)*(*vals2)[i] + w*(*vals2)[i+1];
+  }
+  vector<double> rowWise;
+  for(int j=0; j<n; j++){
+    rowWise.push_back(c[j]);
+    rowWise.push_back( j==0 ? dis(0,1) : (c[j-1]+c[j])/2 );
+    rowWise.push_back( j==n-1 ? dis(nb-1,2) : (c[j]+c[j+1])/2 );
+  }
+  centers = c;
+  dis = DisMat(rowWise);
+  if (vals1!=NULL) *vals1 = v1;
+  if (vals2!=NULL) *vals2 = v2;
+}
+
+// ===================================================
+
+ModelParam ScalingBenchmark::Synthetic(const BenchCase & c) const {
+  ModelParam p = base;
+  Regrid(p.centerPointsAvgWat, p.disAvgWat, c.sizes[0], &p.stress, &p.strength);
+  Regrid(p.centerPointsSdWat, p.disSdWat, c.sizes[1]);
+  Regrid(p.centerPointsMeanPos, p.disMeanPos, c.sizes[2]);
+  Regrid(p.centerPointsSdPos, p.disSdPos, c.sizes[3]);
+  Regrid(p.centerPointsTem, p.disTem, c.sizes[4]);
+  Regrid(p.centerPointsPre, p.disPre, c.sizes[5]);
+  if ( (c.tMax==base.tMax) && (c.opNum==base.opNum) ) return(p);
+
+  // the operations back to back with opD scaled to the horizon
+  int n = c.opNum, nb = base.opNum;
+  double f = (double)c.tMax/base.tMax;
+  double sum = 0;
+  p.opNum = n;
+  p.tMax = c.tMax;
+  p.opSeq.assign(n, 0); p.opE.assign(n, 0); p.opL.assign(n, 0); p.opD.assign(n, 0);
+  p.opFixCost.assign(n, 0); p.watTh.assign(n, 0); p.watUpper.assign(n, 0); p.watLower.assign(n, 0);
+  p.opDelay.assign(n-1, 0);
+  for(int i=0; i<n; i++){
+    int j = i%nb;
+    p.opSeq[i] = i+1;
+    p.opD[i] = max(1.0, floor(base.opD[j]*f*nb/n+0.5));
+    p.opFixCost[i] = base.opFixCost[j];
+    p.watTh[i] = base.watTh[j];
+    p.watUpper[i] = base.watUpper[j];
+    p.watLower[i] = base.watLower[j];
+    if ( (i<n-1) && !base.opDelay.empty() ) p.opDelay[i] = base.opDelay[i%base.opDelay.size()];
+    sum += p.opD[i];
+  }
+  if (sum>c.tMax-1) throw runtime_error("The operations of the benchmark case " + c.name() + " do not fit in the horizon");
+  p.opE[0] = 1;
+  for(int i=1; i<n; i++) p.opE[i] = p.opE[i-1]+p.opD[i-1];
+  p.opL[n-1] = c.tMax;
+  for(int i=n-2; i>=0; i--) p.opL[i] = p.opL[i+1]-p.opD[i+1];
+  p.minOpt = (int)floor(base.minOpt*f+0.5);
+  p.maxOpt = (int)floor(base.maxOpt*f+0.5);
+  return(p);
+}
+
+// ===================================================
+
+void ScalingBenchmark::RunOnce(const ModelParam & param, const string & policyFile, double * rec) const {
+  typedef chrono::steady_clock Clock;
+  ostream nullOut(NULL);
+  rec[REC_START] = rssMB();
+  Clock::time_point start = Clock::now(), last = start, now;
+
+  MDPV model(param, nullOut);
+  model.setPrecision(precision);
+  now = Clock::now(); rec[BENCH_SETUP] = chrono::duration<double>(now-last).count(); last = now;
+  model.AllocateValues();
+  now = Clock::now(); rec[BENCH_ALLOCATE] = chrono::duration<double>(now-last).count(); last = now;
+  for(int g=0; g<TAB_GROUPS; g++) model.calcTables((TableGroup)g);
+  now = Clock::now(); rec[BENCH_TABLES] = chrono::duration<double>(now-last).count(); last = now;
+  model.SolveMDP();
+  rec[REC_VALUE] = model.initialValue();
+  now = Clock::now(); rec[BENCH_SOLVE] = chrono::duration<double>(now-last).count(); last = now;
+  if (exportCsv) model.printPolicy(policyFile);
+  else model.writePolicy(policyFile);
+  now = Clock::now(); rec[BENCH_EXPORT] = chrono::duration<double>(now-last).count(); last = now;
+
+  rec[REC_WALL] = chrono::duration<double>(now-start).count();
+  rec[REC_PEAK] = peakRssMB();
+  ifstream f(policyFile.c_str(), ios::binary | ios::ate);
+  rec[REC_EXPORT] = f ? (double)f.tellg()/1048576 : 0;
+  f.close();
+  remove(policyFile.c_str());
+}
+
+// ===================================================
+
+vector<BenchResult> ScalingBenchmark::Run(const vector<BenchCase> & cases, int repeats, const string & policyFile){
+  if (repeats<1) repeats = 1;
+  vector<BenchResult> res;
+  out << "Scaling benchmark: " << cases.size() << " cases, " << repeats << " runs each (" << precisionName[precision]
+      << " precision, " << (exportCsv ? "csv" : "binary") << " export)" << endl;
+  for(size_t k=0; k<cases.size(); k++){
+    TRACE_SPAN_ARG("benchCase", (int)k);
+    BenchResult r;
+    r.c = cases[k];
+    r.status = "ok";
+    r.repeats = 0;
+    r.states = r.expectations = r.estimateMB = 0;
+    r.wall = r.wallMin = r.wallMax = r.peakMB = r.modelMB = r.statesPerSecond = r.exportMB = r.value = -1;
+    for(int i=0; i<BENCH_PHASES; i++) r.seconds[i] = -1;
+
+    ModelParam param;
+    try {
+      param = Synthetic(r.c);
+    } catch (exception & e) {
+      out << " " << r.c.name() << ": " << e.what() << endl;
+      r.status = "invalid";
+      res.push_back(r);
+      continue;
+    }
+    FootprintPlanner planner(param);
+    r.states = planner.States();
+    r.expectations = planner.Expectations();
+    r.estimateMB = planner.Bytes(precision)/1048576;
+
+    vector< vector<double> > runs;
+    for(int rep=0; rep<repeats; rep++){
+      int fd[2];
+      if (pipe(fd)<0) throw runtime_error("Benchmark: cannot create a pipe");
+      out.flush();
+      cout.flush();
+      pid_t pid = fork();
+      if (pid==0) {   // the run
+        close(fd[0]);
+        double rec[REC_SIZE];
+        int status = 0;
+        try {
+          RunOnce(param, policyFile, rec);
+          if (write(fd[1], rec, sizeof(rec))!=(ssize_t)sizeof(rec)) status = 1;
+        } catch (exception & e) {
+          cerr << "Benchmark error: " << e.what() << endl;
+          status = 1;
+        }
+        close(fd[1]);
+        _exit(status);
+      }
+      close(fd[1]);
+      if (pid<0) { close(fd[0]); throw runtime_error("Benchmark: cannot start a run"); }
+      vector<double> rec(REC_SIZE);
+      size_t got = 0;
+      ssize_t n;
+      char * buf = (char *)&rec[0];
+      while ( got<sizeof(double)*REC_SIZE && (n = read(fd[0], buf+got, sizeof(double)*REC_SIZE-got))>0 ) got += n;
+      close(fd[0]);
+      int status = 0;
+      waitpid(pid, &status, 0);
+      if (WIFSIGNALED(status)) {
+        ostringstream s;
+        s << "killed(" << WTERMSIG(status) << ")";
+        r.status = s.str();
+      }
+      else if ( (WEXITSTATUS(status)!=0) || (got<sizeof(double)*REC_SIZE) ) r.status = "error";
+      if (r.status!="ok") break;
+      if ( !runs.empty() && (rec[REC_VALUE]!=runs[0][REC_VALUE]) ) r.status = "unstable";   // the solve must be deterministic
+      runs.push_back(rec);
+    }
+    remove(policyFile.c_str());
+
+    r.repeats = runs.size();
+    if (!runs.empty() && r.status!="unstable") {
+      vector<double> x(runs.size());
+      for(int i=0; i<=REC_WALL; i++){
+        for(size_t j=0; j<runs.size(); j++) x[j] = runs[j][i];
+        if (i<BENCH_PHASES) r.seconds[i] = median(x);
+        else {
+          r.wall = median(x);
+          r.wallMin = *min_element(x.begin(), x.end());
+          r.wallMax = *max_element(x.begin(), x.end());
+        }
+      }
+      r.peakMB = r.modelMB = 0;
+      for(size_t j=0; j<runs.size(); j++){
+        r.peakMB = max(r.peakMB, runs[j][REC_PEAK]);
+        r.modelMB = max(r.modelMB, runs[j][REC_PEAK]-runs[j][REC_START]);
+      }
+      r.exportMB = runs[0][REC_EXPORT];
+      r.value = runs[0][REC_VALUE];
+      r.statesPerSecond = r.seconds[BENCH_SOLVE]>0 ? r.states/r.seconds[BENCH_SOLVE] : 0;
+    }
+    out << " " << r.c.name() << ": " << r.status;
+    if (r.wall>=0) out << ", " << r.wall << " s, peak RSS " << r.peakMB << " MB (estimate " << r.estimateMB << " MB)";
+    out << endl;
+    res.push_back(r);
+  }
+  return(res);
+}
+
+// ===================================================
+
+void ScalingBenchmark::WriteResults(const string & fileName, const vector<BenchResult> & res) const {
+  ofstream f(fileName.c_str());
+  if (!f) throw runtime_error("Cannot write the benchmark results to " + fileName);
+  char host[256] = "unknown";
+  gethostname(host, sizeof(host)-1);
+  time_t now = time(NULL);
+  char date[64];
+  strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", localtime(&now));
+  f << "# mdpTillage scaling benchmark" << endl;
+  f << "# date: " << date << endl;
+  f << "# host: " << host << ", cores: " << thread::hardware_concurrency() << endl;
+#ifdef __VERSION__
+  f << "# compiler: " << __VERSION__;
+#ifdef __OPTIMIZE__
+  f << " (optimized)";
+#endif
+  f << endl;
+#endif
+  f << "# precision: " << precisionName[precision] << ", export: " << (exportCsv ? "csv" : "binary") << endl;
+  f << "case,MW,SW,MP,SP,T,P,tMax,opNum,status,repeats,states,expectations";
+  for(int i=0; i<BENCH_PHASES; i++) f << "," << phaseName[i];
+  f << ",wall,wallMin,wallMax,peakMB,modelMB,estimateMB,statesPerSecond,exportMB,value" << endl;
+  f << setprecision(10);
+  for(size_t k=0; k<res.size(); k++){
+    const BenchResult & r = res[k];
+    f << r.c.name();
+    for(int i=0; i<6; i++) f << "," << r.c.sizes[i];
+    f << "," << r.c.tMax << "," << r.c.opNum << "," << r.status << "," << r.repeats << "," << r.states << "," << r.expectations;
+    for(int i=0; i<BENCH_PHASES; i++) f << "," << r.seconds[i];
+    f << "," << r.wall << "," << r.wallMin << "," << r.wallMax << "," << r.peakMB << "," << r.modelMB << "," << r.estimateMB
+      << "," << r.statesPerSecond << "," << r.exportMB << "," << setprecision(17) << r.value << setprecision(10) << endl;
+  }
+}
+
+// ===================================================
+
+vector<BenchResult> ScalingBenchmark::ReadResults(const string & fileName){
+  ifstream f(fileName.c_str());
+  if (!f) throw runtime_error("Cannot read the benchmark results " + fileName);
+  vector<BenchResult> res;
+  map<string, int> col;   // column of each name
+  string line, token;
+  while (getline(f, line)) {
+    if (line.empty() || line[0]=='#') continue;
+    vector<string> v;
+    istringstream s(line);
+    while (getline(s, token, ',')) v.push_back(token);
+    if (col.empty()) {   // header
+      for(size_t i=0; i<v.size(); i++) col[v[i]] = i;
+      const char * need[] = {"case", "status", "states", "wall", "wallMin", "wallMax", "peakMB", "value"};
+      for(size_t i=0; i<sizeof(need)/sizeof(need[0]); i++)
+        if (col.count(need[i])==0) throw runtime_error("The benchmark results " + fileName + " have no column " + need[i]);
+      continue;
+    }
+    BenchResult r;
+    map<string, double> x;
+    for(map<string, int>::iterator it=col.begin(); it!=col.end(); ++it)
+      x[it->first] = (it->second<(int)v.size()) ? atof(v[it->second].c_str()) : -1;
+    const char * dims[] = {"MW", "SW", "MP", "SP", "T", "P"};
+    for(int i=0; i<6; i++) r.c.sizes.push_back((int)x[dims[i]]);
+    r.c.tMax = (int)x["tMax"];
+    r.c.opNum = (int)x["opNum"];
+    r.status = v[col["status"]];
+    r.repeats = (int)x["repeats"];
+    r.states = x["states"];
+    r.expectations = x["expectations"];
+    for(int i=0; i<BENCH_PHASES; i++) r.seconds[i] = col.count(phaseName[i]) ? x[phaseName[i]] : -1;
+    r.wall = x["wall"]; r.wallMin = x["wallMin"]; r.wallMax = x["wallMax"];
+    r.peakMB = x["peakMB"]; r.modelMB = x["modelMB"]; r.estimateMB = x["estimateMB"];
+    r.statesPerSecond = x["statesPerSecond"]; r.exportMB = x["exportMB"];
+    r.value = x["value"];
+    res.push_back(r);
+  }
+  return(res);
+}
+
+// ===================================================
+
+int ScalingBenchmark::Compare(const vector<BenchResult> & res, const vector<BenchResult> & baseline, double tolerance, ostream & out) const {
+  map<string, const BenchResult *> byName;
+  for(size_t k=0; k<baseline.size(); k++) byName[baseline[k].c.name()] = &baseline[k];
+  int bad = 0;
+  out << "Comparison with the baseline (tolerance " << 100*tolerance << "%):" << endl;
+  out << "  " << left << setw(20) << "case" << right << setw(12) << "wall base" << setw(12) << "wall" << setw(9) << "change"
+      << setw(12) << "peak base" << setw(12) << "peak" << setw(9) << "change" << "  " << "result" << endl;
+  ios::fmtflags flags = out.flags();
+  streamsize prec = out.precision();
+  for(size_t k=0; k<res.size(); k++){
+    const BenchResult & r = res[k];
+    string name = r.c.name();
+    out << "  " << left << setw(20) << name << right;
+    if (byName.count(name)==0) { out << "  (not in the baseline)" << endl; continue; }
+    const BenchResult & b = *byName[name];
+    if (r.status!="ok" || b.status!="ok") {
+      out << "  status " << b.status << " -> " << r.status << endl;
+      if (b.status=="ok") bad++;
+      continue;
+    }
+    double dWall = r.wall/b.wall-1, dPeak = r.peakMB/b.peakMB-1;
+    double spread = max(r.wallMax-r.wallMin, b.wallMax-b.wallMin);
+    string result = "ok";
+    if ( (r.states!=b.states) || (fabs(r.value-b.value)>1e-8*max(1.0, fabs(b.value))) ) result = "MISMATCH (other model or solution)";
+    else if ( (dWall>tolerance) && (r.wall-b.wall>spread) ) result = "SLOWER";
+    else if (dPeak>tolerance) result = "MORE MEMORY";
+    else if ( (dWall<-tolerance) && (b.wall-r.wall>spread) ) result = "faster";
+    if (result!="ok" && result!="faster") bad++;
+    out << fixed << setprecision(3) << setw(12) << b.wall << setw(12) << r.wall << setprecision(1) << setw(8) << 100*dWall << "%"
+        << setw(12) << b.peakMB << setw(12) << r.peakMB << setw(8) << 100*dPeak << "%";
+    out.flags(flags);
+    out.precision(prec);
+    out << "  " << result << endl;
+  }
+  out << "  Regressions and mismatches: " << bad << endl;
+  return(bad);
+}
+
+// ===================================================
+
+void ScalingBenchmark::Print(const vector<BenchResult> & res, ostream & out) const {
+  out << "  " << left << setw(20) << "case" << right << setw(12) << "states";
+  for(int i=0; i<BENCH_PHASES; i++) out << setw(10) << phaseName[i];
+  out << setw(10) << "wall" << setw(10) << "peak MB" << setw(10) << "est. MB" << setw(12) << "states/s" << "  status" << endl;
+  ios::fmtflags flags = out.flags();
+  streamsize prec = out.precision();
+  for(size_t k=0; k<res.size(); k++){
+    const BenchResult & r = res[k];
+    out << "  " << left << setw(20) << r.c.name() << right << setw(12) << (long long)r.states << fixed << setprecision(3);
+    for(int i=0; i<BENCH_PHASES; i++) out << setw(10) << r.seconds[i];
+    out << setw(10) << r.wall << setprecision(1) << setw(10) << r.peakMB << setw(10) << r.estimateMB << setprecision(0)
+        << setw(12) << r.statesPerSecond;
+    out.flags(flags);
+    out.precision(prec);
+    out << "  " << r.status << endl;
+  }
+}
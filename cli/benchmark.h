@@ -0,0 +1,162 @@
+#ifndef BENCHMARK_HPP
+#define BENCHMARK_HPP
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../src/mdp.h"
+#include "../src/param.h"
+
+using namespace std;
+
+// ===================================================
+
+/** A model size of the scaling benchmark: the grid sizes, the horizon and the number of operations. */
+struct BenchCase {
+  vector<int> sizes;   // grid sizes (MW, SW, MP, SP, T, P)
+  int tMax;
+  int opNum;
+
+  /** Name of the case (MWxSWxMPxSPxTxP:tMax:opNum). */
+  string name() const;
+
+  /** Parse a case "MWxSWxMPxSPxTxP[:tMax[:opNum]]". Omitted values are taken from the base parameters.
+   *
+   * Throws std::runtime_error if the case cannot be parsed.
+   */
+  static BenchCase Parse(const string & spec, const ModelParam & base);
+};
+
+// ===================================================
+
+/** Phases of a benchmark run. */
+enum BenchPhase {
+  BENCH_SETUP = 0,      ///< constructor (parameters and table shapes)
+  BENCH_ALLOCATE = 1,   ///< value function and policy
+  BENCH_TABLES = 2,     ///< rewards and trans pr (all table groups, the SW trans pr of a day are calculated when solved)
+  BENCH_SOLVE = 3,      ///< backward induction (SolveMDP, incl. the supports and reduced tables)
+  BENCH_EXPORT = 4,     ///< policy file
+  BENCH_PHASES = 5      ///< number of phases
+};
+
+// ===================================================
+
+/** Result of a case (the median over the repeats). */
+struct BenchResult {
+  BenchCase c;
+  string status;               // ok, error or killed (signal) if a run failed
+  int repeats;                 // runs of the case
+  double states;               // states of the model (t, op, d and grid)
+  double expectations;         // expectations calculated when solving
+  double seconds[BENCH_PHASES];
+  double wall;                 // median time of a run (all phases)
+  double wallMin, wallMax;     // min and max time of a run
+  double peakMB;               // peak resident set size of a run (max over the repeats)
+  double modelMB;              // peak RSS minus the RSS at the start of the run
+  double estimateMB;           // estimate of FootprintPlanner (double precision arrays)
+  double statesPerSecond;      // states divided by the solve time
+  double exportMB;             // size of the policy file
+  double value;                // mean value of the initial states (checks that the solution is the same as in the baseline)
+};
+
+// ===================================================
+
+/**
+* End-to-end scaling benchmark on synthetic model sizes.
+*
+* The parameters of a case are found from base parameters (e.g. the paper configuration): the center points of each
+* grid are interpolated at equally spaced positions of the center points of the base grid (the outer interval limits
+* are kept and the limits are midway between the center points, see RefineGrid). Stress and strength are
+* interpolated with the MW grid. If the base grid has a single point the range [c/2, 2c] is used. If the horizon
+* or the number of operations differ from the base, the operations are laid out back to back as in the paper
+* (opE of an operation is opE plus opD of the one before and opL of an operation is opL minus opD of the next), the
+* days opD are scaled with the horizon per operation and the attributes of the operations are taken cyclically from
+* the base. minOpt and maxOpt are scaled with the horizon.
+*
+* Each run of a case is a forked process, i.e. the heap of a run is fresh and the peak RSS of the run is measured
+* (getrusage). A run calculates all phases (see BenchPhase) in double precision unless another precision is set.
+* A run that fails (e.g. killed when out of memory) is recorded with its status and the benchmark continues.
+* Supported on POSIX systems only.
+*
+* @author Reza Pourmoayed
+*/
+class ScalingBenchmark
+{
+  public:
+
+    /** Constructor.
+    *
+    * @param base The base parameters.
+    * @param out Stream used for the progress.
+    */
+    ScalingBenchmark(const ModelParam & base, ostream & out = cout);
+
+
+    /** Default cases: sweeps of the MW grid, the MP and SP grids, the weather grids, the horizon and the number of
+    * operations around a small grid with the horizon and operations of the base.
+    */
+    vector<BenchCase> DefaultCases() const;
+
+
+    /** The parameters of a case (see the class description). Throws std::runtime_error if the operations do not fit
+    * in the horizon.
+    */
+    ModelParam Synthetic(const BenchCase & c) const;
+
+
+    /** Set the storage precision (see MDPV::setPrecision). */
+    void setPrecision(MDPV::Precision mode) {precision = mode;}
+
+
+    /** Set the format of the exported policy (true = csv as in SolveMDPModel, false = binary as writePolicy). */
+    void setCsv(bool csv) {exportCsv = csv;}
+
+
+    /** Run the cases.
+    *
+    * @param cases The model sizes.
+    * @param repeats Runs of each case (the median time is reported).
+    * @param policyFile Temporary file used by the export phase (removed afterwards).
+    */
+    vector<BenchResult> Run(const vector<BenchCase> & cases, int repeats = 3, const string & policyFile = "benchPolicy.tmp");
+
+
+    /** Write the results to a csv file (one line per case, comment lines with the machine and the build first). */
+    void WriteResults(const string & fileName, const vector<BenchResult> & res) const;
+
+
+    /** Read a results file written by WriteResults. Throws std::runtime_error if the file cannot be read. */
+    static vector<BenchResult> ReadResults(const string & fileName);
+
+
+    /** Compare results with a baseline (matched by the name of the case).
+    *
+    * The wall time and peak RSS of a case are regressions if they exceed the baseline by more than the tolerance
+    * (relative) and the time also exceeds the spread (max minus min) of the runs of both. A case with a different
+    * number of states or mean value of the initial states is reported as a mismatch.
+    *
+    * @return The number of regressions and mismatches.
+    */
+    int Compare(const vector<BenchResult> & res, const vector<BenchResult> & baseline, double tolerance, ostream & out) const;
+
+
+    /** Print the results as a table. */
+    void Print(const vector<BenchResult> & res, ostream & out) const;
+
+
+  private:
+
+    /** Run all phases of a case once in the calling process. */
+    void RunOnce(const ModelParam & param, const string & policyFile, double * rec) const;
+
+    /** Interpolate the center points of a grid (and the values of vals at the same positions) to n points. */
+    static void Regrid(vector<double> & centers, DisMat & dis, int n, vector<double> * vals1 = NULL, vector<double> * vals2 = NULL);
+
+    const ModelParam base;
+    ostream & out;
+    MDPV::Precision precision;
+    bool exportCsv;
+};
+
+
+#endif
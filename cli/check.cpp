@@ -0,0 +1,139 @@
+// Checks of the R independent core (run by make check).
+//
+// Usage: check paramFile
+//
+// The distribution functions are compared with reference values of R (pnorm, pgamma, pbeta and qt), DisMat::find
+// is compared with a linear scan of the intervals and the model given by paramFile is solved serially, by
+// distributed workers and with a forecast window of one day: the policy files of the serial and distributed solves
+// must be identical and the values of the initial states of the forecast solve must equal the serial ones. The
+// number of failed checks is returned.
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <sstream>
+#include "../src/mdp.h"
+#include "../src/distributions.h"
+#include "../src/distSolve.h"
+#include "../src/forecast.h"
+
+using namespace std;
+
+static int failed = 0;
+
+/** Report a check. */
+static void check(bool ok, const string & what) {
+  if (!ok) failed++;
+  cout << (ok ? "ok      " : "FAILED  ") << what << endl;
+}
+
+/** Compare a value with a reference value (relative tolerance). */
+static void checkNear(double x, double ref, double tol, const string & what) {
+  ostringstream s;
+  s.precision(17);
+  s << what << " = " << x << " (reference " << ref << ")";
+  check(fabs(x-ref) <= tol*max(1.0, fabs(ref)), s.str());
+}
+
+/** The contents of a file. */
+static string readFile(const string & fileName) {
+  ifstream in(fileName.c_str(), ios::binary);
+  return(string(istreambuf_iterator<char>(in), istreambuf_iterator<char>()));
+}
+
+// ===================================================
+
+static void checkDistributions() {
+  checkNear(normCdf(1.96, 0, 1), 0.9750021048517795, 1e-12, "normCdf(1.96, 0, 1)");
+  checkNear(normCdf(-1, 2, 3), 0.15865525393145707, 1e-12, "normCdf(-1, 2, 3)");
+  checkNear(normCdf(5, 5, 0.1), 0.5, 1e-12, "normCdf(5, 5, 0.1)");
+  checkNear(gammaCdf(2, 3, 1), 0.3233235838169365, 1e-12, "gammaCdf(2, 3, 1)");
+  checkNear(gammaCdf(0.5, 1, 2), 0.22119921692859512, 1e-12, "gammaCdf(0.5, 1, 2)");
+  checkNear(gammaCdf(3.841458820694124, 0.5, 2), 0.95, 1e-12, "gammaCdf(qchisq(0.95, 1), 0.5, 2)");
+  checkNear(gammaCdf(0, 2, 1), 0, 1e-12, "gammaCdf(0, 2, 1)");
+  checkNear(betaCdf(0.3, 2, 3), 0.3483, 1e-12, "betaCdf(0.3, 2, 3)");
+  checkNear(betaCdf(0.25, 0.5, 0.5), 1.0/3, 1e-12, "betaCdf(0.25, 0.5, 0.5)");
+  checkNear(betaCdf(0.9, 5, 1), 0.59049, 1e-12, "betaCdf(0.9, 5, 1)");
+  checkNear(BetaCdf(2, 3)(0.3), 0.3483, 1e-12, "BetaCdf(2, 3)(0.3)");
+  checkNear(tQuantile(0.975, 10), 2.2281388519649385, 1e-6, "tQuantile(0.975, 10)");
+}
+
+// ===================================================
+
+/** The interval of x found by a linear scan (-1 if none). */
+static int findLinear(const DisMat & dis, double x) {
+  for (int i=0; i<dis.n_rows; i++) if ( (x>=dis(i,1)) && (x<dis(i,2)) ) return(i);
+  return(-1);
+}
+
+static void checkFind() {
+  DisMat dis({2, 0, 4.5, 7, 4.5, 9.5, 12, 9.5, 14.5, 17, 14.5, 19.5, 22, 19.5, 24.5});
+  double nan = numeric_limits<double>::quiet_NaN(), inf = numeric_limits<double>::infinity();
+  vector<double> xs = {-1, 0, 3, 4.5, 9.4999, 9.5, 14.5, 20, 24.4999, 24.5, 30, -inf, inf, nan};
+  bool ok = true;
+  for (size_t i=0; i<xs.size(); i++) ok = ok && (dis.find(xs[i])==findLinear(dis, xs[i]));
+  check(ok, "DisMat::find equals a linear scan (below, boundaries, inside, above, infinite and NaN)");
+  check(dis.find(nan)==-1, "DisMat::find of NaN is -1");
+  check(DisMat().find(1)==-1, "DisMat::find on an empty matrix");
+}
+
+// ===================================================
+
+static void checkSolvers(const string & paramFile) {
+  ostream nullOut(NULL);
+  ModelParam param(readParamFile(paramFile));
+  const string serialFile = "checkSerial.bin", distFile = "checkDist.bin";
+
+  MDPV serial(param, nullOut);
+  serial.SolveMDP();
+  serial.writePolicy(serialFile);
+
+  MDPV dist(param, nullOut);
+  dist.setExport(distFile);
+  DistSolver(dist, nullOut).Solve(param, 2, 2);
+  string a = readFile(serialFile), b = readFile(distFile);
+  check(!a.empty() && (a==b), "distributed solve (2 workers) writes the same policy as the serial solve");
+  remove(serialFile.c_str());
+  remove(distFile.c_str());
+
+  MDPV fc(param, nullOut);
+  ForecastMDP forecast(fc, 1, nullOut);
+  forecast.Solve(1);
+  vector<int> s = serial.gridSizes();   // MW, SW, MP, SP, T, P
+  int t0 = (int)param.opE[0], d0 = (int)param.opD[0];
+  double maxDiff = 0;
+  for (int iMW=0; iMW<s[0]; iMW++)
+    for (int iSW=0; iSW<s[1]; iSW++)
+      for (int iMP=0; iMP<s[2]; iMP++)
+        for (int iSP=0; iSP<s[3]; iSP++)
+          for (int iT=0; iT<s[4]; iT++)
+            for (int iP=0; iP<s[5]; iP++){
+              double v = serial.getValue(t0, 0, d0, iMW, iSW, iMP, iSP, iT, iP);
+              double f = forecast.InitialValue(iMW, iSW, iMP, iSP, vector<int>(1, iT), vector<int>(1, iP));
+              maxDiff = max(maxDiff, fabs(v-f)/max(1.0, fabs(v)));
+            }
+  ostringstream msg;
+  msg << "forecast window of one day equals the serial solve (max relative difference " << maxDiff << ")";
+  check(maxDiff<1e-9, msg.str());
+}
+
+// ===================================================
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    cerr << "Usage: check paramFile" << endl;
+    return(1);
+  }
+  try {
+    checkDistributions();
+    checkFind();
+    checkSolvers(argv[1]);
+  } catch (exception & e) {
+    cerr << "Error: " << e.what() << endl;
+    return(1);
+  }
+  cout << failed << " checks failed" << endl;
+  return(failed);
+}
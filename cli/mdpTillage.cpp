@@ -0,0 +1,530 @@
+// Command line solver for the tillage MDP (no R needed).
+//
+// Usage: mdpTillage paramFile [-o policy.bin] [-csv policy.csv] [-tree policy.tree] [-checkpoint file [-resume]]
+//                   [-precision double|float|q16 [-compare]] [-truncate eps]
+//        mdpTillage paramFile -state t,op,d,iMW,iSW,iMP,iSP,iT,iP [-prune minPr] [-truncate eps]
+//        mdpTillage paramFile -validate [-threads n]
+//        mdpTillage paramFile -evaluate policyList [-threads n]
+//        mdpTillage paramFile -forward iMW,iSW,iMP,iSP,iT,iP
+//        mdpTillage paramFile -distributed workers [-local n] [-port p -token secret] [-o policy.bin] [-csv policy.csv]
+//                   [-truncate eps]
+//        mdpTillage paramFile -worker host:port -token secret
+//        mdpTillage paramFile -forecast days [-threads n]
+//        mdpTillage paramFile -saa samples [-replications r] [-seed s] [-o policy.bin] [-compare]
+//        mdpTillage paramFile -ingest data.csv [-columns time,moisture,temperature,rain]
+//        mdpTillage paramFile -plan [-memory MB] [-threads n] [-probe rows]
+//        mdpTillage paramFile -bench [-cases MWxSWxMPxSPxTxP:tMax:opNum,...] [-repeat r] [-results bench.csv]
+//                   [-baseline base.csv [-tolerance x]] [-precision p] [-format csv|bin]
+//        mdpTillage paramFile -adaptive levels [-refine MW,MP,SP] [-valueTol x] [-o policy.bin] [-csv policy.csv]
+//        mdpTillage -ensemble listFile [-threads n] [-memory MB]
+//        mdpTillage -fields listFile [-threads n]
+//        All modes accept -trace file.json
+//
+// With -state only the optimal action of the given state is found (op is one-based as in the policy files). With
+// -prune the successors with a trans pr below minPr are skipped (approximate value).
+// With -validate the rewards and trans pr are checked once (row sums, NaN, -Inf) and the model is not solved.
+// With -evaluate the expected value of the policies in policyList is found exactly in one backward pass. Each line
+// of policyList holds a policy: "calendar day1 day2 ..." (first day of each operation), "threshold w1 w2 ..."
+// (operation done if the mean soil water content is at most w), "table policy.bin" or "optimal".
+// With -forward the model is solved and the exact distribution of the states under the optimal policy is found
+// starting from the given state at day opE of the first operation (distribution of the completion day, action
+// probabilities per day and soil water distribution of each operation).
+// With -distributed the model is solved by worker processes each owning a block of the mean soil water content
+// intervals. n workers (default all) are started locally, the rest must be started using -worker with the host
+// and port of the coordinator, the same paramFile and the same token (e.g. on the nodes of a cluster). If all
+// workers are local the coordinator only accepts connections from this host. The other solve options
+// (-checkpoint, -precision, -tree, -compare, -saa, ...) are not supported and rejected.
+// With -forecast the weather state is a window of the given number of forecast days (shift register, only the new
+// last day is random) and the mean value of the initial states is reported.
+// With -saa the expectations are estimated from the given number of successors drawn for each state (the same for
+// both actions) and the model is solved r times (default 10) with different seeds. The mean value of the initial
+// states with a 95% confidence interval and the standard errors are reported and the policy of the last solve is
+// written. With -compare the model is also solved exactly (small grids only).
+// With -ingest a sensor or weather file is read in chunks and the daily mean soil water content, temperature and
+// precipitation, the Gaussian SSM filter estimates and the state indexes are printed. The columns are found by name
+// (prefix); the default is Timestamp,EC5,SLHT5-Air,RainMeter. Several temperature columns are separated by + (their
+// mean is used) and an empty moisture column means weather data only (e.g. Day_num,,high+low,precip).
+// With -plan the number of states and expectations, the bytes of each table under each storage precision and the
+// estimated solve time are reported without allocating the value function, and a precision and number of local
+// workers within the memory budget (-memory, default none) using at most n cores are recommended. The time is
+// calibrated by timing the kernel on a sample of rows (-probe, 0 = no timing).
+// With -bench the model is solved for a matrix of synthetic sizes derived from paramFile (grids interpolated, the
+// operations laid out in the horizon, default a sweep of each dimension around a small grid). Each case is run r
+// times (default 3) in a fresh process and the median time of each phase (setup, allocate, tables, solve, export),
+// the peak RSS, the footprint estimate and the states per second are written to the results file. With -baseline
+// the results are compared with a saved results file and the exit status is 3 if a case is slower or uses more
+// memory than the tolerance (default 0.1) allows, or if its model or solution differs.
+// With -precision the trans pr and value function used in the expectations are stored as float or 16 bit
+// integers (q16). With -compare the model is also solved in double precision and the max deviation is reported.
+// With -truncate at most eps of the probability mass is removed from each row of the kernel and a bound on the
+// resulting value function error is reported.
+// With -adaptive the model is first solved on the grids in paramFile and the grids of the variables given by -refine
+// (default MW) are then refined where the optimal action (or value, see -valueTol) changes and the model re-solved.
+// With -ensemble the models given by the parameter files listed in listFile (one per line) are solved in
+// parallel and the policy of paramFile is written to paramFile with extension .bin. With -fields the parameter
+// files are fields in the same weather cell (same grids and weather statistics) solved as a batch.
+// With -trace a timeline of the preprocessing, stages, expectation kernels, threads and I/O is written to a file in
+// the Chrome trace format (open it in chrome://tracing or ui.perfetto.dev).
+// The parameter file can be created in R using writeParamFile(setParam(), "param.txt").
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include "../src/mdp.h"
+#include "../src/ensemble.h"
+#include "../src/fieldBatch.h"
+#include "../src/refine.h"
+#include "../src/policyEval.h"
+#include "../src/forwardDist.h"
+#include "../src/distSolve.h"
+#include "../src/fieldData.h"
+#include "../src/forecast.h"
+#include "../src/saa.h"
+#include "../src/footprint.h"
+#include "benchmark.h"
+#include "../src/trace.h"
+
+using namespace std;
+
+static void usage() {
+  cerr << "Usage: mdpTillage paramFile [-o policy.bin] [-csv policy.csv] [-tree policy.tree] [-checkpoint file [-resume]]" << endl;
+  cerr << "                  [-precision double|float|q16 [-compare]] [-truncate eps]" << endl;
+  cerr << "       mdpTillage paramFile -state t,op,d,iMW,iSW,iMP,iSP,iT,iP [-prune minPr] [-truncate eps]" << endl;
+  cerr << "       mdpTillage paramFile -validate [-threads n]" << endl;
+  cerr << "       mdpTillage paramFile -evaluate policyList [-threads n]" << endl;
+  cerr << "       mdpTillage paramFile -forward iMW,iSW,iMP,iSP,iT,iP" << endl;
+  cerr << "       mdpTillage paramFile -distributed workers [-local n] [-port p -token secret] [-o policy.bin] [-csv policy.csv]" << endl;
+  cerr << "                  [-truncate eps]" << endl;
+  cerr << "       mdpTillage paramFile -worker host:port -token secret" << endl;
+  cerr << "       mdpTillage paramFile -forecast days [-threads n]" << endl;
+  cerr << "       mdpTillage paramFile -saa samples [-replications r] [-seed s] [-o policy.bin] [-compare]" << endl;
+  cerr << "       mdpTillage paramFile -ingest data.csv [-columns time,moisture,temperature,rain]" << endl;
+  cerr << "       mdpTillage paramFile -plan [-memory MB] [-threads n] [-probe rows]" << endl;
+  cerr << "       mdpTillage paramFile -bench [-cases MWxSWxMPxSPxTxP:tMax:opNum,...] [-repeat r] [-results bench.csv]" << endl;
+  cerr << "                  [-baseline base.csv [-tolerance x]] [-precision p] [-format csv|bin]" << endl;
+  cerr << "       mdpTillage paramFile -adaptive levels [-refine MW,MP,SP] [-valueTol x] [-o policy.bin] [-csv policy.csv]" << endl;
+  cerr << "       mdpTillage -ensemble listFile [-threads n] [-memory MB]" << endl;
+  cerr << "       mdpTillage -fields listFile [-threads n]" << endl;
+  cerr << "       All modes accept -trace file.json" << endl;
+}
+
+static vector<string> policyFiles;   // policy file of each model in the ensemble
+
+static void writeEnsemblePolicy(int i, MDPV & model) {
+  model.writePolicy(policyFiles[i]);
+}
+
+/** Read the parameter files listed in a file and set the policy file names. */
+static vector<ModelParam> readParamList(const string & listFile) {
+  ifstream list(listFile.c_str());
+  if (!list) throw runtime_error("Cannot open file " + listFile);
+  vector<ModelParam> params;
+  string file;
+  while (list >> file) {
+    params.push_back(ModelParam(readParamFile(file)));
+    policyFiles.push_back(file.substr(0, file.find_last_of('.')) + ".bin");
+  }
+  return(params);
+}
+
+/** Evaluate the policies listed in a file (see -evaluate). */
+static void evaluatePolicies(MDPV & model, const string & listFile, int threads) {
+  ifstream list(listFile.c_str());
+  if (!list) throw runtime_error("Cannot open file " + listFile);
+  PolicyEval eval(model, cout);
+  string line;
+  while (getline(list, line)) {
+    istringstream s(line);
+    string type;
+    if (!(s >> type)) continue;
+    vector<double> x;
+    double v;
+    if (type=="calendar" || type=="threshold") {
+      while (s >> v) x.push_back(v);
+      if (type=="calendar") eval.AddCalendar(x); else eval.AddThreshold(x);
+    }
+    else if (type=="table") {
+      string file;
+      s >> file;
+      eval.AddTable(file);
+    }
+    else if (type=="optimal") {
+      model.SolveMDP();
+      eval.AddOptimal();
+    }
+    else throw runtime_error("Unknown policy type " + type);
+  }
+  vector<double> mean = eval.Evaluate(threads);
+  cout << "Mean value at the initial states:" << endl;
+  for (int k=0; k<eval.Size(); k++) cout << "  " << eval.Name(k) << ": " << mean[k] << endl;
+}
+
+static int solveEnsemble(int argc, char* argv[]) {
+  bool fields = strcmp(argv[1],"-fields")==0;
+  int threads = 0;
+  double memory = 0;
+  for (int i=3; i<argc; i++) {
+    if (strcmp(argv[i],"-threads")==0 && i+1<argc) threads = atoi(argv[++i]);
+    else if (!fields && strcmp(argv[i],"-memory")==0 && i+1<argc) memory = atof(argv[++i])*1024*1024;
+    else { usage(); return(1); }
+  }
+
+  try {
+    vector<ModelParam> params = readParamList(argv[2]);
+    vector<double> rew;
+    if (fields) {
+      FieldBatch batch(params, cout);
+      rew = batch.Solve(threads);
+      for (int i=0; i<batch.Size(); i++) batch.Field(i).writePolicy(policyFiles[i]);
+    } else {
+      Ensemble ensemble(params, cout);
+      rew = ensemble.Solve(threads, memory, writeEnsemblePolicy);
+    }
+    for (size_t i=0; i<rew.size(); i++) cout << policyFiles[i] << " total reward: " << rew[i] << endl;
+  } catch (exception & e) {
+    cerr << "Error: " << e.what() << endl;
+    return(1);
+  }
+  return(0);
+}
+
+/** Propagate a point mass from the given grid state under the optimal policy and print the marginals. */
+static void forwardDistribution(MDPV & model, const vector<int> & x) {
+  vector<int> sizes = model.gridSizes();
+  int g = 0;
+  for (int k=0; k<6; k++) {
+    if (x[k]<0 || x[k]>=sizes[k]) throw runtime_error("Initial state outside the grid");
+    g = g*sizes[k]+x[k];
+  }
+  ForwardDist fd(model);
+  fd.Propagate(vector<int>(1, g), vector<double>(1, 1.0));
+  const vector<double> & comp = fd.Completion();
+  const vector< vector<double> > & act = fd.ActionPr();
+  double total = 0, mean = 0;
+  cout << "day,prFinished,pos,do,doF" << endl;
+  for (size_t t=1; t<comp.size(); t++) {
+    if (act[t][0]+act[t][1]+act[t][2]==0) continue;
+    cout << t << "," << comp[t] << "," << act[t][0] << "," << act[t][1] << "," << act[t][2] << endl;
+    total += comp[t];
+    mean += t*comp[t];
+  }
+  cout << "Pr(finished): " << total << " mean day: " << (total>0 ? mean/total : 0) << " not finished: " << fd.Remaining()
+       << " max states: " << fd.MaxStates() << endl;
+  const vector< vector<double> > & sw = fd.SoilWater();
+  for (size_t op=0; op<sw.size(); op++) {
+    cout << "Soil water op " << op+1 << ":";
+    for (size_t i=0; i<sw[op].size(); i++) cout << " " << sw[op][i];
+    cout << endl;
+  }
+}
+
+/** Read a sensor/weather file and print the daily observations (NA if not observed), filter estimates and state
+*  indexes (-1 if outside the grid or not observed). */
+static void ingestData(const ModelParam & param, const string & dataFile, const string & columns) {
+  vector<string> col;
+  istringstream s(columns);
+  string token;
+  while (getline(s, token, ',')) col.push_back(token);
+  if (col.size()!=4) throw runtime_error("-columns must be time,moisture,temperature,rain");
+  vector<string> temp;
+  istringstream st(col[2]);
+  while (getline(st, token, '+')) temp.push_back(token);
+  FieldIngest ingest(param);
+  long long rows = ingest.Read(dataFile, col[0], col[1], temp, col[3]);
+  const vector<FieldDay> & days = ingest.Days();
+  cout << "day,n,moisture,temperature,rain,meanPos,sdPos,iMW,iSW,iMP,iSP,iT,iP" << endl;
+  for (size_t k=0; k<days.size(); k++) {
+    const FieldDay & d = days[k];
+    cout << d.day << "," << d.n << ",";
+    if (std::isnan(d.moisture)) cout << "NA"; else cout << d.moisture;
+    cout << ",";
+    if (std::isnan(d.temperature)) cout << "NA"; else cout << d.temperature;
+    cout << "," << d.rain << "," << d.meanPos << "," << d.sdPos;
+    for (int v=0; v<StateEncoder::VARS; v++) cout << "," << d.idx[v];
+    cout << endl;
+  }
+  cout << "Rows: " << rows << " days: " << days.size() << endl;
+}
+
+/** Write the trace file when main returns. */
+struct TraceFile {
+  string fileName;
+  ~TraceFile() {
+    if (fileName.empty()) return;
+    Tracer::Disable();
+    try {
+      int n = Tracer::WriteChrome(fileName);
+      cout << "Trace: " << n << " events written to " << fileName << " (" << Tracer::Dropped() << " dropped)" << endl;
+    } catch (exception & e) {
+      cerr << "Error: " << e.what() << endl;
+    }
+  }
+};
+
+int main(int argc, char* argv[]) {
+  TraceFile trace;
+  for (int i=1; i+1<argc; i++) {   // -trace is removed from the arguments
+    if (strcmp(argv[i],"-trace")!=0) continue;
+    trace.fileName = argv[i+1];
+    for (int j=i; j+2<=argc; j++) argv[j] = argv[j+2];
+    argc -= 2;
+    Tracer::Enable();
+    break;
+  }
+  if (argc < 2) { usage(); return(1); }
+  if (strcmp(argv[1],"-ensemble")==0 || strcmp(argv[1],"-fields")==0) {
+    if (argc < 3) { usage(); return(1); }
+    return(solveEnsemble(argc, argv));
+  }
+  string paramFile = argv[1];
+  string binFile = "policyMDP.bin";
+  string csvFile = "";
+  string ckpFile = "";
+  string treeFile = "";
+  string precision = "double";
+  bool resume = false;
+  bool compare = false;
+  bool validate = false;
+  string evalFile = "";
+  int threads = 1;
+  double truncate = 0;
+  double prune = 0;
+  int levels = 0;
+  double valueTol = 0;
+  vector<int> refineVars;
+  vector<int> state;
+  vector<int> start;
+  int workers = 0;
+  int local = -1;
+  int port = 0;
+  string coordinator = "";
+  string token = "";
+  string dataFile = "";
+  int forecastDays = 0;
+  int samples = 0;
+  int replications = 10;
+  unsigned long long seed = 1;
+  bool plan = false;
+  double memoryMB = 0;
+  int probeRows = 1000;
+  bool bench = false;
+  string benchCases = "";
+  int repeat = 3;
+  string resultsFile = "bench.csv";
+  string baselineFile = "";
+  double tolerance = 0.1;
+  string format = "csv";
+  string columns = "Timestamp,EC5,SLHT5-Air,RainMeter";
+  for (int i=2; i<argc; i++) {
+    if (strcmp(argv[i],"-o")==0 && i+1<argc) binFile = argv[++i];
+    else if (strcmp(argv[i],"-csv")==0 && i+1<argc) csvFile = argv[++i];
+    else if (strcmp(argv[i],"-tree")==0 && i+1<argc) treeFile = argv[++i];
+    else if (strcmp(argv[i],"-checkpoint")==0 && i+1<argc) ckpFile = argv[++i];
+    else if (strcmp(argv[i],"-resume")==0) resume = true;
+    else if (strcmp(argv[i],"-precision")==0 && i+1<argc) precision = argv[++i];
+    else if (strcmp(argv[i],"-compare")==0) compare = true;
+    else if (strcmp(argv[i],"-truncate")==0 && i+1<argc) truncate = atof(argv[++i]);
+    else if (strcmp(argv[i],"-prune")==0 && i+1<argc) prune = atof(argv[++i]);
+    else if (strcmp(argv[i],"-validate")==0) validate = true;
+    else if (strcmp(argv[i],"-evaluate")==0 && i+1<argc) evalFile = argv[++i];
+    else if (strcmp(argv[i],"-threads")==0 && i+1<argc) threads = atoi(argv[++i]);
+    else if (strcmp(argv[i],"-adaptive")==0 && i+1<argc) levels = atoi(argv[++i]);
+    else if (strcmp(argv[i],"-valueTol")==0 && i+1<argc) valueTol = atof(argv[++i]);
+    else if (strcmp(argv[i],"-refine")==0 && i+1<argc) {
+      istringstream s(argv[++i]);
+      string token;
+      while (getline(s, token, ',')) {
+        if (token=="MW") refineVars.push_back(0);
+        else if (token=="MP") refineVars.push_back(2);
+        else if (token=="SP") refineVars.push_back(3);
+        else { usage(); return(1); }
+      }
+    }
+    else if (strcmp(argv[i],"-state")==0 && i+1<argc) {
+      istringstream s(argv[++i]);
+      string token;
+      while (getline(s, token, ',')) state.push_back(atoi(token.c_str()));
+      if (state.size()!=9) { usage(); return(1); }
+    }
+    else if (strcmp(argv[i],"-distributed")==0 && i+1<argc) workers = atoi(argv[++i]);
+    else if (strcmp(argv[i],"-local")==0 && i+1<argc) local = atoi(argv[++i]);
+    else if (strcmp(argv[i],"-port")==0 && i+1<argc) port = atoi(argv[++i]);
+    else if (strcmp(argv[i],"-worker")==0 && i+1<argc) coordinator = argv[++i];
+    else if (strcmp(argv[i],"-token")==0 && i+1<argc) token = argv[++i];
+    else if (strcmp(argv[i],"-ingest")==0 && i+1<argc) dataFile = argv[++i];
+    else if (strcmp(argv[i],"-forecast")==0 && i+1<argc) forecastDays = atoi(argv[++i]);
+    else if (strcmp(argv[i],"-saa")==0 && i+1<argc) samples = atoi(argv[++i]);
+    else if (strcmp(argv[i],"-replications")==0 && i+1<argc) replications = atoi(argv[++i]);
+    else if (strcmp(argv[i],"-seed")==0 && i+1<argc) seed = strtoull(argv[++i], NULL, 10);
+    else if (strcmp(argv[i],"-plan")==0) plan = true;
+    else if (strcmp(argv[i],"-memory")==0 && i+1<argc) memoryMB = atof(argv[++i]);
+    else if (strcmp(argv[i],"-probe")==0 && i+1<argc) probeRows = atoi(argv[++i]);
+    else if (strcmp(argv[i],"-bench")==0) bench = true;
+    else if (strcmp(argv[i],"-cases")==0 && i+1<argc) benchCases = argv[++i];
+    else if (strcmp(argv[i],"-repeat")==0 && i+1<argc) repeat = atoi(argv[++i]);
+    else if (strcmp(argv[i],"-results")==0 && i+1<argc) resultsFile = argv[++i];
+    else if (strcmp(argv[i],"-baseline")==0 && i+1<argc) baselineFile = argv[++i];
+    else if (strcmp(argv[i],"-tolerance")==0 && i+1<argc) tolerance = atof(argv[++i]);
+    else if (strcmp(argv[i],"-format")==0 && i+1<argc) format = argv[++i];
+    else if (strcmp(argv[i],"-columns")==0 && i+1<argc) columns = argv[++i];
+    else if (strcmp(argv[i],"-forward")==0 && i+1<argc) {
+      istringstream s(argv[++i]);
+      string token;
+      while (getline(s, token, ',')) start.push_back(atoi(token.c_str()));
+      if (start.size()!=6) { usage(); return(1); }
+    }
+    else { usage(); return(1); }
+  }
+  if (workers>0 || !coordinator.empty()) {   // the distributed solve only writes the policy
+    string other = "";
+    if (!ckpFile.empty() || resume) other += " -checkpoint";
+    if (precision!="double") other += " -precision";
+    if (!treeFile.empty()) other += " -tree";
+    if (compare) other += " -compare";
+    if (samples>0) other += " -saa";
+    if (forecastDays>0) other += " -forecast";
+    if (!start.empty()) other += " -forward";
+    if (!state.empty()) other += " -state";
+    if (!evalFile.empty()) other += " -evaluate";
+    if (validate) other += " -validate";
+    if (levels>0) other += " -adaptive";
+    if (plan || bench || !dataFile.empty()) other += " -plan/-bench/-ingest";
+    if (workers>0 && !coordinator.empty()) other += " -worker";
+    if (!other.empty()) {
+      cerr << "Options not supported by a distributed solve:" << other << endl;
+      return(1);
+    }
+  }
+
+  try {
+    ModelParam param(readParamFile(paramFile));
+    if (!dataFile.empty()) {
+      ingestData(param, dataFile, columns);
+      return(0);
+    }
+    if (plan) {
+      FootprintPlanner planner(param);
+      if (probeRows>0) {
+        ostream nullOut(NULL);
+        MDPV probeModel(param, nullOut);
+        planner.Probe(probeModel, probeRows);
+      }
+      planner.Plan(memoryMB*1024*1024, threads).print(cout);
+      return(0);
+    }
+    if (bench) {
+      ScalingBenchmark suite(param, cout);
+      suite.setPrecision(MDPV::parsePrecision(precision));
+      suite.setCsv(format=="csv");
+      vector<BenchCase> cases;
+      if (benchCases.empty()) cases = suite.DefaultCases();
+      istringstream s(benchCases);
+      string token;
+      while (getline(s, token, ',')) cases.push_back(BenchCase::Parse(token, param));
+      vector<BenchResult> res = suite.Run(cases, repeat, resultsFile + ".policy");
+      suite.Print(res, cout);
+      suite.WriteResults(resultsFile, res);
+      cout << "Results written to " << resultsFile << endl;
+      if (!baselineFile.empty() && suite.Compare(res, ScalingBenchmark::ReadResults(baselineFile), tolerance, cout)>0) return(3);
+      return(0);
+    }
+    MDPV Model(param, cout);
+    if (validate) {
+      ValidationReport rep = Model.Validate(threads);
+      rep.print(cout);
+      return(rep.ok() ? 0 : 2);
+    }
+    if (!evalFile.empty()) {
+      Model.setPrecision(MDPV::parsePrecision(precision));
+      Model.setTruncation(truncate);
+      evaluatePolicies(Model, evalFile, threads);
+      return(0);
+    }
+    if (!state.empty()) {
+      string action;
+      Model.setTruncation(truncate);
+      Model.setLazyPruning(prune);
+      double w = Model.SolveState(state[0], state[1]-1, state[2], state[3], state[4], state[5], state[6], state[7], state[8], action);
+      cout << "Optimal action: " << action << " weight: " << w << endl;
+      return(0);
+    }
+    if (!coordinator.empty()) {
+      size_t c = coordinator.find_last_of(':');
+      if (c==string::npos) { usage(); return(1); }
+      DistSolver::Worker(param, coordinator.substr(0, c), atoi(coordinator.substr(c+1).c_str()), token, cout);
+      return(0);
+    }
+    if (workers>0) {
+      Model.setTruncation(truncate);
+      Model.setExport(binFile, csvFile);   // written while solving
+      DistSolver dist(Model, cout);
+      double totalRew = dist.Solve(param, workers, local<0 ? workers : local, port, token);
+      cout << "Total reward: " << totalRew << endl;
+      return(0);
+    }
+    if (forecastDays>0) {
+      Model.setTruncation(truncate);
+      ForecastMDP forecast(Model, forecastDays, cout);
+      double mean = forecast.Solve(threads);
+      cout << "Mean value of the initial states (forecast window " << forecastDays << " days): " << mean << endl;
+      return(0);
+    }
+    if (samples>0) {
+      Model.setTruncation(truncate);
+      SaaReport rep = SolveSAA(Model, samples, replications, seed);
+      Model.writePolicy(binFile);
+      rep.print(cout);
+      if (compare) {
+        MDPV Ref(param, cout);
+        Ref.setTruncation(truncate);
+        Ref.SolveMDP();
+        double maxDiff;
+        int actionDiff;
+        int n = Model.compareSolution(Ref, maxDiff, actionDiff);
+        cout << "Exact mean value of the initial states: " << Ref.initialValue() << endl;
+        cout << "Last replication compared to the exact solve: max deviation in value function " << maxDiff
+             << ", states with a different action " << actionDiff << " of " << n << endl;
+      }
+      return(0);
+    }
+    if (!start.empty()) {
+      Model.setTruncation(truncate);
+      Model.SolveMDP();
+      forwardDistribution(Model, start);
+      return(0);
+    }
+    if (levels>0) {
+      if (refineVars.empty()) refineVars.push_back(0);
+      MDPV * fine = SolveAdaptive(param, refineVars, levels, valueTol, cout);
+      fine->writePolicy(binFile);
+      if (!csvFile.empty()) fine->printPolicy(csvFile);
+      delete fine;
+      return(0);
+    }
+    Model.setCheckpoint(ckpFile, resume);
+    Model.setPrecision(MDPV::parsePrecision(precision));
+    Model.setTruncation(truncate);
+    Model.setExport(binFile, csvFile);   // written while solving
+    cout << "Total number of states: " << Model.countStatesMDP() << endl;
+    double totalRew = Model.SolveMDP();
+    if (!treeFile.empty()) Model.compressPolicy().Write(treeFile);
+    cout << "Total reward: " << totalRew << endl;
+    if (truncate>0) cout << "Value function error bound (day 1): " << Model.valueErrorBound(1) << endl;
+    if (compare) {
+      MDPV Ref(param, cout);
+      Ref.SolveMDP();
+      double maxDiff;
+      int actionDiff;
+      int n = Model.compareSolution(Ref, maxDiff, actionDiff);
+      cout << "Precision " << precision << " compared to double: max deviation in value function " << maxDiff
+           << ", states with a different action " << actionDiff << " of " << n << endl;
+    }
+  } catch (exception & e) {
+    cerr << "Error: " << e.what() << endl;
+    return(1);
+  }
+  return(0);
+}
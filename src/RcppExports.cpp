@@ -1,19 +1,296 @@
 // Generated by using Rcpp::compileAttributes() -> do not edit by hand
 // Generator token: 10BE3573-1514-4C36-9D1C-5A225CD40393
 
-#include <RcppArmadillo.h>
 #include <Rcpp.h>
 
 using namespace Rcpp;
 
 // SolveMDPModel
-SEXP SolveMDPModel(const List paramModel);
-RcppExport SEXP mdpTillage_SolveMDPModel(SEXP paramModelSEXP) {
+SEXP SolveMDPModel(const List paramModel, std::string checkpointFile, bool resume, std::string precision, double truncate);
+RcppExport SEXP mdpTillage_SolveMDPModel(SEXP paramModelSEXP, SEXP checkpointFileSEXP, SEXP resumeSEXP, SEXP precisionSEXP, SEXP truncateSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< const List >::type paramModel(paramModelSEXP);
-    rcpp_result_gen = Rcpp::wrap(SolveMDPModel(paramModel));
+    Rcpp::traits::input_parameter< std::string >::type checkpointFile(checkpointFileSEXP);
+    Rcpp::traits::input_parameter< bool >::type resume(resumeSEXP);
+    Rcpp::traits::input_parameter< std::string >::type precision(precisionSEXP);
+    Rcpp::traits::input_parameter< double >::type truncate(truncateSEXP);
+    rcpp_result_gen = Rcpp::wrap(SolveMDPModel(paramModel, checkpointFile, resume, precision, truncate));
+    return rcpp_result_gen;
+END_RCPP
+}
+// SolveMDPState
+SEXP SolveMDPState(const List paramModel, int day, int op, int d, int iMW, int iSW, int iMP, int iSP, int iT, int iP, double prune);
+RcppExport SEXP mdpTillage_SolveMDPState(SEXP paramModelSEXP, SEXP daySEXP, SEXP opSEXP, SEXP dSEXP, SEXP iMWSEXP, SEXP iSWSEXP, SEXP iMPSEXP, SEXP iSPSEXP, SEXP iTSEXP, SEXP iPSEXP, SEXP pruneSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const List >::type paramModel(paramModelSEXP);
+    Rcpp::traits::input_parameter< int >::type day(daySEXP);
+    Rcpp::traits::input_parameter< int >::type op(opSEXP);
+    Rcpp::traits::input_parameter< int >::type d(dSEXP);
+    Rcpp::traits::input_parameter< int >::type iMW(iMWSEXP);
+    Rcpp::traits::input_parameter< int >::type iSW(iSWSEXP);
+    Rcpp::traits::input_parameter< int >::type iMP(iMPSEXP);
+    Rcpp::traits::input_parameter< int >::type iSP(iSPSEXP);
+    Rcpp::traits::input_parameter< int >::type iT(iTSEXP);
+    Rcpp::traits::input_parameter< int >::type iP(iPSEXP);
+    Rcpp::traits::input_parameter< double >::type prune(pruneSEXP);
+    rcpp_result_gen = Rcpp::wrap(SolveMDPState(paramModel, day, op, d, iMW, iSW, iMP, iSP, iT, iP, prune));
+    return rcpp_result_gen;
+END_RCPP
+}
+// SolveMDPEnsemble
+SEXP SolveMDPEnsemble(const List paramModels, int threads, double memoryMB, std::string filePrefix);
+RcppExport SEXP mdpTillage_SolveMDPEnsemble(SEXP paramModelsSEXP, SEXP threadsSEXP, SEXP memoryMBSEXP, SEXP filePrefixSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const List >::type paramModels(paramModelsSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< double >::type memoryMB(memoryMBSEXP);
+    Rcpp::traits::input_parameter< std::string >::type filePrefix(filePrefixSEXP);
+    rcpp_result_gen = Rcpp::wrap(SolveMDPEnsemble(paramModels, threads, memoryMB, filePrefix));
+    return rcpp_result_gen;
+END_RCPP
+}
+// SolveMDPFields
+SEXP SolveMDPFields(const List paramModels, int threads, std::string filePrefix);
+RcppExport SEXP mdpTillage_SolveMDPFields(SEXP paramModelsSEXP, SEXP threadsSEXP, SEXP filePrefixSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const List >::type paramModels(paramModelsSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< std::string >::type filePrefix(filePrefixSEXP);
+    rcpp_result_gen = Rcpp::wrap(SolveMDPFields(paramModels, threads, filePrefix));
+    return rcpp_result_gen;
+END_RCPP
+}
+// EncoderCreate
+SEXP EncoderCreate(const List paramModel);
+RcppExport SEXP mdpTillage_EncoderCreate(SEXP paramModelSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const List >::type paramModel(paramModelSEXP);
+    rcpp_result_gen = Rcpp::wrap(EncoderCreate(paramModel));
+    return rcpp_result_gen;
+END_RCPP
+}
+// EncodeStates
+IntegerMatrix EncodeStates(SEXP encoder, const NumericMatrix obs);
+RcppExport SEXP mdpTillage_EncodeStates(SEXP encoderSEXP, SEXP obsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type encoder(encoderSEXP);
+    Rcpp::traits::input_parameter< const NumericMatrix >::type obs(obsSEXP);
+    rcpp_result_gen = Rcpp::wrap(EncodeStates(encoder, obs));
+    return rcpp_result_gen;
+END_RCPP
+}
+// ValidateModel
+DataFrame ValidateModel(const List paramModel, int threads, double tol);
+RcppExport SEXP mdpTillage_ValidateModel(SEXP paramModelSEXP, SEXP threadsSEXP, SEXP tolSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const List >::type paramModel(paramModelSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< double >::type tol(tolSEXP);
+    rcpp_result_gen = Rcpp::wrap(ValidateModel(paramModel, threads, tol));
+    return rcpp_result_gen;
+END_RCPP
+}
+// MDPCreate
+SEXP MDPCreate(const List paramModel, std::string precision, double truncate);
+RcppExport SEXP mdpTillage_MDPCreate(SEXP paramModelSEXP, SEXP precisionSEXP, SEXP truncateSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const List >::type paramModel(paramModelSEXP);
+    Rcpp::traits::input_parameter< std::string >::type precision(precisionSEXP);
+    Rcpp::traits::input_parameter< double >::type truncate(truncateSEXP);
+    rcpp_result_gen = Rcpp::wrap(MDPCreate(paramModel, precision, truncate));
+    return rcpp_result_gen;
+END_RCPP
+}
+// MDPSetParam
+void MDPSetParam(SEXP model, const List paramModel);
+RcppExport SEXP mdpTillage_MDPSetParam(SEXP modelSEXP, SEXP paramModelSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type model(modelSEXP);
+    Rcpp::traits::input_parameter< const List >::type paramModel(paramModelSEXP);
+    MDPSetParam(model, paramModel);
+    return R_NilValue;
+END_RCPP
+}
+// MDPSetPrecision
+void MDPSetPrecision(SEXP model, std::string precision, double truncate);
+RcppExport SEXP mdpTillage_MDPSetPrecision(SEXP modelSEXP, SEXP precisionSEXP, SEXP truncateSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type model(modelSEXP);
+    Rcpp::traits::input_parameter< std::string >::type precision(precisionSEXP);
+    Rcpp::traits::input_parameter< double >::type truncate(truncateSEXP);
+    MDPSetPrecision(model, precision, truncate);
+    return R_NilValue;
+END_RCPP
+}
+// MDPSolve
+SEXP MDPSolve(SEXP model, int tStart);
+RcppExport SEXP mdpTillage_MDPSolve(SEXP modelSEXP, SEXP tStartSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type model(modelSEXP);
+    Rcpp::traits::input_parameter< int >::type tStart(tStartSEXP);
+    rcpp_result_gen = Rcpp::wrap(MDPSolve(model, tStart));
+    return rcpp_result_gen;
+END_RCPP
+}
+// MDPGetValues
+DataFrame MDPGetValues(SEXP model, const IntegerMatrix states);
+RcppExport SEXP mdpTillage_MDPGetValues(SEXP modelSEXP, SEXP statesSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type model(modelSEXP);
+    Rcpp::traits::input_parameter< const IntegerMatrix >::type states(statesSEXP);
+    rcpp_result_gen = Rcpp::wrap(MDPGetValues(model, states));
+    return rcpp_result_gen;
+END_RCPP
+}
+// MDPWritePolicy
+void MDPWritePolicy(SEXP model, std::string fileName);
+RcppExport SEXP mdpTillage_MDPWritePolicy(SEXP modelSEXP, SEXP fileNameSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type model(modelSEXP);
+    Rcpp::traits::input_parameter< std::string >::type fileName(fileNameSEXP);
+    MDPWritePolicy(model, fileName);
+    return R_NilValue;
+END_RCPP
+}
+// MDPRelease
+void MDPRelease(SEXP model);
+RcppExport SEXP mdpTillage_MDPRelease(SEXP modelSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type model(modelSEXP);
+    MDPRelease(model);
+    return R_NilValue;
+END_RCPP
+}
+// EvaluatePolicies
+DataFrame EvaluatePolicies(const List paramModel, SEXP calendar, SEXP threshold, CharacterVector tables, bool optimal, int threads);
+RcppExport SEXP mdpTillage_EvaluatePolicies(SEXP paramModelSEXP, SEXP calendarSEXP, SEXP thresholdSEXP, SEXP tablesSEXP, SEXP optimalSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const List >::type paramModel(paramModelSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type calendar(calendarSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type threshold(thresholdSEXP);
+    Rcpp::traits::input_parameter< CharacterVector >::type tables(tablesSEXP);
+    Rcpp::traits::input_parameter< bool >::type optimal(optimalSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(EvaluatePolicies(paramModel, calendar, threshold, tables, optimal, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// ForwardDistribution
+List ForwardDistribution(const List paramModel, IntegerMatrix initial, NumericVector prob);
+RcppExport SEXP mdpTillage_ForwardDistribution(SEXP paramModelSEXP, SEXP initialSEXP, SEXP probSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const List >::type paramModel(paramModelSEXP);
+    Rcpp::traits::input_parameter< IntegerMatrix >::type initial(initialSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type prob(probSEXP);
+    rcpp_result_gen = Rcpp::wrap(ForwardDistribution(paramModel, initial, prob));
+    return rcpp_result_gen;
+END_RCPP
+}
+// TraceStart
+void TraceStart(int events);
+RcppExport SEXP mdpTillage_TraceStart(SEXP eventsSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< int >::type events(eventsSEXP);
+    TraceStart(events);
+    return R_NilValue;
+END_RCPP
+}
+// TraceStop
+int TraceStop(std::string fileName);
+RcppExport SEXP mdpTillage_TraceStop(SEXP fileNameSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type fileName(fileNameSEXP);
+    rcpp_result_gen = Rcpp::wrap(TraceStop(fileName));
+    return rcpp_result_gen;
+END_RCPP
+}
+// IngestSensorData
+DataFrame IngestSensorData(const List paramModel, std::string fileName, std::string time, std::string moisture, CharacterVector temperature, std::string rain, int chunkRows);
+RcppExport SEXP mdpTillage_IngestSensorData(SEXP paramModelSEXP, SEXP fileNameSEXP, SEXP timeSEXP, SEXP moistureSEXP, SEXP temperatureSEXP, SEXP rainSEXP, SEXP chunkRowsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const List >::type paramModel(paramModelSEXP);
+    Rcpp::traits::input_parameter< std::string >::type fileName(fileNameSEXP);
+    Rcpp::traits::input_parameter< std::string >::type time(timeSEXP);
+    Rcpp::traits::input_parameter< std::string >::type moisture(moistureSEXP);
+    Rcpp::traits::input_parameter< CharacterVector >::type temperature(temperatureSEXP);
+    Rcpp::traits::input_parameter< std::string >::type rain(rainSEXP);
+    Rcpp::traits::input_parameter< int >::type chunkRows(chunkRowsSEXP);
+    rcpp_result_gen = Rcpp::wrap(IngestSensorData(paramModel, fileName, time, moisture, temperature, rain, chunkRows));
+    return rcpp_result_gen;
+END_RCPP
+}
+// SolveMDPForecast
+List SolveMDPForecast(const List paramModel, int days, int threads);
+RcppExport SEXP mdpTillage_SolveMDPForecast(SEXP paramModelSEXP, SEXP daysSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const List >::type paramModel(paramModelSEXP);
+    Rcpp::traits::input_parameter< int >::type days(daysSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(SolveMDPForecast(paramModel, days, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// SolveMDPSampled
+List SolveMDPSampled(const List paramModel, int samples, int replications, int seed, double level);
+RcppExport SEXP mdpTillage_SolveMDPSampled(SEXP paramModelSEXP, SEXP samplesSEXP, SEXP replicationsSEXP, SEXP seedSEXP, SEXP levelSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const List >::type paramModel(paramModelSEXP);
+    Rcpp::traits::input_parameter< int >::type samples(samplesSEXP);
+    Rcpp::traits::input_parameter< int >::type replications(replicationsSEXP);
+    Rcpp::traits::input_parameter< int >::type seed(seedSEXP);
+    Rcpp::traits::input_parameter< double >::type level(levelSEXP);
+    rcpp_result_gen = Rcpp::wrap(SolveMDPSampled(paramModel, samples, replications, seed, level));
+    return rcpp_result_gen;
+END_RCPP
+}
+// PlanModel
+List PlanModel(const List paramModel, double memory, int cores, int probe);
+RcppExport SEXP mdpTillage_PlanModel(SEXP paramModelSEXP, SEXP memorySEXP, SEXP coresSEXP, SEXP probeSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const List >::type paramModel(paramModelSEXP);
+    Rcpp::traits::input_parameter< double >::type memory(memorySEXP);
+    Rcpp::traits::input_parameter< int >::type cores(coresSEXP);
+    Rcpp::traits::input_parameter< int >::type probe(probeSEXP);
+    rcpp_result_gen = Rcpp::wrap(PlanModel(paramModel, memory, cores, probe));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -0,0 +1,446 @@
+#include "distSolve.h"
+#include "policyWriter.h"
+#include "trace.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+static const int DIST_MAGIC = 0x4d445044;   // "MDPD"
+static const int TOKEN_TIMEOUT = 10;        // seconds a connection may take to send the token
+static const int POLL_INTERVAL = 1000;      // ms between the checks of the local workers while waiting for connections
+
+// ===================================================
+
+DistSolver::DistSolver(MDPV & model, ostream & out) : m(model), out(out), bytesSent(0) {}
+
+// ===================================================
+
+void DistSolver::PackSlice(MDPV & m, int t, int iMWLo, int iMWHi, vector<double> & vals, vector<char> * acts){
+  int op, d, iMW, iSW, iMP, iSP, iT, iP;
+
+  vals.clear();
+  if (acts!=NULL) acts->clear();
+  for(op=0; op<m.opNum; op++){
+    for(d=1; d<=m.opD[op]; d++){
+      if(!m.ValidState(t,op,d)) continue;
+      for(iMW=iMWLo; iMW<iMWHi; iMW++)
+        for(iSW=0; iSW<m.sizeSSW; iSW++)
+          for(iMP=0; iMP<m.sizeSMP; iMP++)
+            for(iSP=0; iSP<m.sizeSSP; iSP++)
+              for(iT=0; iT<m.sizeST; iT++)
+                for(iP=0; iP<m.sizeSP; iP++){
+                  vals.push_back(m.valueFun[t][op][d][iMW][iSW][iMP][iSP][iT][iP]);
+                  if (acts!=NULL) acts->push_back(MDPV::actionCode(m.optAction[t][op][d][iMW][iSW][iMP][iSP][iT][iP]));
+                }
+    }
+  }
+}
+
+// ===================================================
+
+void DistSolver::UnpackSlice(MDPV & m, int t, int iMWLo, int iMWHi, const vector<double> & vals, const vector<char> * acts){
+  int op, d, iMW, iSW, iMP, iSP, iT, iP;
+  size_t i = 0;
+
+  for(op=0; op<m.opNum; op++){
+    for(d=1; d<=m.opD[op]; d++){
+      if(!m.ValidState(t,op,d)) continue;
+      for(iMW=iMWLo; iMW<iMWHi; iMW++)
+        for(iSW=0; iSW<m.sizeSSW; iSW++)
+          for(iMP=0; iMP<m.sizeSMP; iMP++)
+            for(iSP=0; iSP<m.sizeSSP; iSP++)
+              for(iT=0; iT<m.sizeST; iT++)
+                for(iP=0; iP<m.sizeSP; iP++){
+                  m.valueFun[t][op][d][iMW][iSW][iMP][iSP][iT][iP] = vals[i];
+                  if (acts!=NULL) m.optAction[t][op][d][iMW][iSW][iMP][iSP][iT][iP] = MDPV::actionLabel((*acts)[i]);
+                  i++;
+                }
+    }
+  }
+}
+
+// ===================================================
+
+void DistSolver::AllocStage(MDPV & m, int t, int iMWLo, int iMWHi){
+  for(int op=0; op<m.opNum; op++)
+    for(int d=0; d<=m.opDMax; d++)
+      for(int iMW=iMWLo; iMW<iMWHi; iMW++){
+        m.valueFun[t][op][d][iMW] = vector< vector< vector< vector< vector<double> > > > >(m.sizeSSW,
+                                    vector< vector< vector< vector<double> > > >(m.sizeSMP,
+                                    vector< vector< vector<double> > >(m.sizeSSP,
+                                    vector< vector<double> >(m.sizeST,
+                                    vector <double>(m.sizeSP) ) ) ) );
+        m.optAction[t][op][d][iMW] = vector< vector< vector< vector< vector<string> > > > >(m.sizeSSW,
+                                     vector< vector< vector< vector<string> > > >(m.sizeSMP,
+                                     vector< vector< vector<string> > >(m.sizeSSP,
+                                     vector< vector<string> >(m.sizeST,
+                                     vector <string>(m.sizeSP) ) ) ) );
+      }
+}
+
+// ===================================================
+
+void DistSolver::FreeStage(MDPV & m, int t){
+  for(int op=0; op<m.opNum; op++)
+    for(int d=0; d<=m.opDMax; d++)
+      for(int iMW=0; iMW<m.sizeSMW; iMW++){
+        vector< vector< vector< vector< vector<double> > > > >().swap(m.valueFun[t][op][d][iMW]);
+        vector< vector< vector< vector< vector<string> > > > >().swap(m.optAction[t][op][d][iMW]);
+      }
+}
+
+#ifndef _WIN32
+
+// ===================================================
+
+/** Number of values in a slice of stage t with iMW in [iMWLo, iMWHi). */
+static size_t sliceSize(const MDPV & m, int t, int iMWLo, int iMWHi){
+  vector<int> s = m.gridSizes();
+  size_t n = 0;
+  for(int op=0; op<m.operations(); op++)
+    for(int d=1; d<=m.opDays(op); d++)
+      if(m.ValidState(t,op,d)) n += (size_t)(iMWHi-iMWLo)*s[1]*s[2]*s[3]*s[4]*s[5];
+  return(n);
+}
+
+// ===================================================
+
+static void sendAll(int sock, const void * buf, size_t n){
+  const char * p = (const char *)buf;
+  while (n>0) {
+    ssize_t k = send(sock, p, n, MSG_NOSIGNAL);
+    if (k<=0) throw runtime_error("Distributed solve: connection lost while sending");
+    p += k;
+    n -= k;
+  }
+}
+
+// ===================================================
+
+static void recvAll(int sock, void * buf, size_t n){
+  char * p = (char *)buf;
+  while (n>0) {
+    ssize_t k = recv(sock, p, n, 0);
+    if (k<=0) throw runtime_error("Distributed solve: connection lost while receiving");
+    p += k;
+    n -= k;
+  }
+}
+
+// ===================================================
+
+/** Receive the token of a new connection (with a timeout). Returns true if it matches. */
+static bool checkToken(int sock, const string & token){
+  struct timeval tv;
+  tv.tv_sec = TOKEN_TIMEOUT;
+  tv.tv_usec = 0;
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  int n = -1;
+  string buf;
+  try {
+    recvAll(sock, &n, sizeof(n));
+    if (n!=(int)token.size()) return(false);
+    buf.resize(n);
+    if (n>0) recvAll(sock, &buf[0], n);
+  } catch (runtime_error & e) {
+    return(false);
+  }
+  tv.tv_sec = 0;   // no timeout while solving (a stage may take long)
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  return(buf==token);
+}
+
+// ===================================================
+
+double DistSolver::Solve(const ModelParam & param, int workers, int local, int port, const string & token){
+  if (m.precision!=MDPV::PREC_DOUBLE) throw runtime_error("Distributed solve only supports double precision");
+  if ( (workers<1) || (workers>m.sizeSMW) ) throw runtime_error("The number of workers must be between 1 and the number of MW intervals");
+  if ( (local<0) || (local>workers) ) throw runtime_error("The number of local workers must be between 0 and the number of workers");
+  if ( (port==0) && (local<workers) ) throw runtime_error("A port must be given if remote workers are used");
+  if ( token.empty() && (local<workers) ) throw runtime_error("A token must be given if remote workers are used");
+
+  int lsock = socket(AF_INET, SOCK_STREAM, 0);
+  if (lsock<0) throw runtime_error("Distributed solve: cannot create socket");
+  int on = 1;
+  setsockopt(lsock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(local==workers ? INADDR_LOOPBACK : INADDR_ANY);   // only reachable from this host if all workers are local
+  addr.sin_port = htons(port);
+  socklen_t len = sizeof(addr);
+  if ( bind(lsock, (struct sockaddr *)&addr, sizeof(addr))<0 || listen(lsock, workers)<0 ||
+       getsockname(lsock, (struct sockaddr *)&addr, &len)<0 ) {
+    close(lsock);
+    throw runtime_error("Distributed solve: cannot listen on the port");
+  }
+  port = ntohs(addr.sin_port);
+  out << "Distributed solve using " << workers << " workers (" << local << " local). Listening on port " << port << "." << endl;
+
+  // start the local workers (they connect like remote workers)
+  vector<pid_t> pids;
+  for(int i=0; i<local; i++){
+    pid_t pid = fork();
+    if (pid==0) {
+      close(lsock);
+      ostream nullOut(NULL);
+      int status = 0;
+      try {
+        Worker(param, "127.0.0.1", port, token, nullOut);
+      } catch (exception & e) {
+        cerr << "Worker error: " << e.what() << endl;
+        status = 1;
+      }
+      _exit(status);
+    }
+    if (pid>0) pids.push_back(pid);
+  }
+
+  vector<int> sock;
+  double totalRew = 0;
+  try {
+    if ((int)pids.size()<local) throw runtime_error("Distributed solve: cannot start the local workers");
+    while ((int)sock.size()<workers) {
+      struct pollfd pfd;
+      pfd.fd = lsock;
+      pfd.events = POLLIN;
+      int ready = poll(&pfd, 1, POLL_INTERVAL);
+      if ( ready<0 && errno!=EINTR ) throw runtime_error("Distributed solve: poll failed");
+      for(size_t i=0; i<pids.size(); i++){   // fail if a local worker exited (e.g. instead of waiting for it forever)
+        if (waitpid(pids[i], NULL, WNOHANG)!=pids[i]) continue;
+        pids.erase(pids.begin()+i);
+        throw runtime_error("Distributed solve: a local worker exited");
+      }
+      if (ready<=0) continue;
+      int s = accept(lsock, NULL, NULL);
+      if (s<0) throw runtime_error("Distributed solve: accept failed");
+      if (!checkToken(s, token)) {
+        close(s);
+        out << "Rejected a connection without a valid token." << endl;
+        continue;
+      }
+      sock.push_back(s);
+    }
+    totalRew = Coordinate(sock, param.hash());
+  } catch (...) {
+    for(size_t i=0; i<sock.size(); i++) close(sock[i]);
+    close(lsock);
+    for(size_t i=0; i<pids.size(); i++) { kill(pids[i], SIGTERM); waitpid(pids[i], NULL, 0); }
+    throw;
+  }
+  for(size_t i=0; i<sock.size(); i++) close(sock[i]);
+  close(lsock);
+  for(size_t i=0; i<pids.size(); i++) waitpid(pids[i], NULL, 0);
+  return(totalRew);
+}
+
+// ===================================================
+
+double DistSolver::Coordinate(const vector<int> & sock, unsigned long long hash){
+  int n = sock.size(), w, t;
+  vector<int> from(n), to(n), lo(n), hi(n);
+  vector<int> sizes = m.gridSizes();
+
+  // check the workers and assign the iMW blocks
+  for(w=0; w<n; w++){
+    int header[9];
+    unsigned long long h;
+    recvAll(sock[w], header, sizeof(header));
+    recvAll(sock[w], &h, sizeof(h));
+    if ( header[0]!=DIST_MAGIC || header[1]!=m.tMax || header[2]!=m.opNum || !equal(sizes.begin(), sizes.end(), header+3) || h!=hash )
+      throw runtime_error("Distributed solve: the parameters of a worker differ from the coordinator");
+    from[w] = (long long)m.sizeSMW*w/n;
+    to[w] = (long long)m.sizeSMW*(w+1)/n;
+    int assign[4] = {w, from[w], to[w], (int)m.elimination};
+    sendAll(sock[w], assign, sizeof(assign));
+    sendAll(sock[w], &m.truncEps, sizeof(double));
+  }
+
+  m.AllocateValues(0, 0);   // a stage is allocated when received and freed when written
+  m.Preprocess();
+  m.InitFinalValues();
+  for(w=0; w<n; w++){
+    int range[2];
+    recvAll(sock[w], range, sizeof(range));   // the iMW slices referenced by the worker
+    lo[w] = range[0];
+    hi[w] = range[1];
+  }
+
+  bytesSent = 0;
+  vector<double> vals, maxValue(m.tMax+1, 0);
+  vector<char> acts;
+  PolicyWriter writer(m, m.exportBin, m.exportCsv);
+  for(t=m.tMax-1; t>=1; --t){
+    out<<" day: "<<t<<endl;
+    TRACE_SPAN_ARG("stage", t);
+    AllocStage(m, t, 0, m.sizeSMW);
+    for(w=0; w<n; w++){
+      TRACE_SPAN_ARG("recvBlock", w);   // includes the wait for the worker
+      vals.resize(sliceSize(m, t, from[w], to[w]));
+      acts.resize(vals.size());
+      if (vals.empty()) continue;   // no valid states at day t
+      recvAll(sock[w], &vals[0], vals.size()*sizeof(double));
+      recvAll(sock[w], &acts[0], acts.size());
+      UnpackSlice(m, t, from[w], to[w], vals, &acts);
+      for(size_t i=0; i<vals.size(); i++) maxValue[t] = max(maxValue[t], fabs(vals[i]));
+    }
+    if (t>1) {
+      for(w=0; w<n; w++){   // only the slices referenced at stage t-1 not owned by the worker
+        int part[2][2] = {{lo[w], from[w]}, {to[w], hi[w]}};
+        for(int k=0; k<2; k++){
+          if (part[k][0]>=part[k][1]) continue;
+          PackSlice(m, t, part[k][0], part[k][1], vals, NULL);
+          if (vals.empty()) continue;
+          sendAll(sock[w], &vals[0], vals.size()*sizeof(double));
+          bytesSent += vals.size()*sizeof(double);
+        }
+      }
+    }
+    if(writer.Active()){
+      m.getStage(t, vals, acts);
+      writer.Push(t, vals, acts);
+    }
+    if(m.stageCallback!=NULL) m.stageCallback(t);
+    FreeStage(m, t);
+  }
+  writer.Finish();
+
+  long long counter = 0;
+  m.eliminated = 0;
+  for(w=0; w<n; w++){
+    long long c[2];
+    recvAll(sock[w], c, sizeof(c));
+    counter += c[0];
+    m.eliminated += c[1];
+  }
+  out<<" Number of actions: "<< counter << endl;
+  if(m.elimination) out<<" Actions eliminated by bounds: "<< m.eliminated << endl;
+  out<<" Values sent to workers: "<< bytesSent/1024/1024 << " MB" << endl;
+  m.CalcErrorBound(&maxValue);
+  if(m.truncEps>0) out << " Bound on the value function error at day 1: " << m.errBound[1] << endl;
+  m.totalRew = m.weightIni();
+  return(m.totalRew);
+}
+
+// ===================================================
+
+void DistSolver::Worker(const ModelParam & param, const string & host, int port, const string & token, ostream & out){
+  struct addrinfo hints, * res;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  ostringstream portStr;
+  portStr << port;
+  if (getaddrinfo(host.c_str(), portStr.str().c_str(), &hints, &res)!=0) throw runtime_error("Worker: cannot resolve host " + host);
+  int sock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+  if ( sock<0 || connect(sock, res->ai_addr, res->ai_addrlen)<0 ) {
+    freeaddrinfo(res);
+    if (sock>=0) close(sock);
+    throw runtime_error("Worker: cannot connect to " + host);
+  }
+  freeaddrinfo(res);
+
+  try {
+    int n = token.size();   // sent first, the coordinator closes connections that are slow to send it
+    sendAll(sock, &n, sizeof(n));
+    if (n>0) sendAll(sock, token.data(), n);
+    MDPV m(param, out);
+    vector<int> sizes = m.gridSizes();
+    int header[9] = {DIST_MAGIC, m.tMax, m.opNum};
+    copy(sizes.begin(), sizes.end(), header+3);
+    unsigned long long h = param.hash();
+    sendAll(sock, header, sizeof(header));
+    sendAll(sock, &h, sizeof(h));
+    int assign[4];
+    double eps;
+    recvAll(sock, assign, sizeof(assign));
+    recvAll(sock, &eps, sizeof(eps));
+    m.iMWFrom = assign[1];
+    m.iMWTo = assign[2];
+    m.setActionElimination(assign[3]!=0);
+    m.setTruncation(eps);
+    out << "Worker " << assign[0] << ": iMW in [" << m.iMWFrom << "," << m.iMWTo << ")" << endl;
+
+    // the iMW slices referenced by the block (union of the supports of the MW kernel rows)
+    m.Preprocess();
+    m.InitFinalValues();
+    int rows = m.sizeSMP*m.sizeSSP*m.sizeST*m.sizeSP;
+    int lo = m.iMWFrom, hi = m.iMWTo;
+    for(int row=m.iMWFrom*rows; row<m.iMWTo*rows; row++){
+      if (m.supMW[2*row]>=m.supMW[2*row+1]) continue;
+      lo = min(lo, m.supMW[2*row]);
+      hi = max(hi, m.supMW[2*row+1]);
+    }
+    int range[2] = {lo, hi};
+    sendAll(sock, range, sizeof(range));
+    m.AllocateValues(lo, lo);   // the stages are allocated when needed
+    AllocStage(m, m.tMax, lo, hi);
+
+    long long counter = 0;
+    vector<double> vals;
+    vector<char> acts;
+    for(int t=m.tMax-1; t>=1; --t){
+      TRACE_SPAN_ARG("stage", t);
+      AllocStage(m, t, lo, hi);
+      counter += m.SolveStage(t);
+      PackSlice(m, t, m.iMWFrom, m.iMWTo, vals, &acts);
+      if (!vals.empty()) {
+        sendAll(sock, &vals[0], vals.size()*sizeof(double));
+        sendAll(sock, &acts[0], acts.size());
+      }
+      FreeStage(m, t+1);
+      if (t>1) {
+        TRACE_SPAN_ARG("recvSlices", t);   // includes the wait for the other workers
+        int part[2][2] = {{lo, m.iMWFrom}, {m.iMWTo, hi}};
+        for(int k=0; k<2; k++){
+          if (part[k][0]>=part[k][1]) continue;
+          vals.resize(sliceSize(m, t, part[k][0], part[k][1]));
+          if (vals.empty()) continue;
+          recvAll(sock, &vals[0], vals.size()*sizeof(double));
+          UnpackSlice(m, t, part[k][0], part[k][1], vals, NULL);
+        }
+      }
+    }
+    long long c[2] = {counter, m.eliminated};
+    sendAll(sock, c, sizeof(c));
+  } catch (...) {
+    close(sock);
+    throw;
+  }
+  close(sock);
+}
+
+#else
+
+// ===================================================
+
+double DistSolver::Solve(const ModelParam & param, int workers, int local, int port, const string & token){
+  throw runtime_error("Distributed solve is not supported on Windows");
+}
+
+// ===================================================
+
+double DistSolver::Coordinate(const vector<int> & sock, unsigned long long hash){
+  throw runtime_error("Distributed solve is not supported on Windows");
+}
+
+// ===================================================
+
+void DistSolver::Worker(const ModelParam & param, const string & host, int port, const string & token, ostream & out){
+  throw runtime_error("Distributed solve is not supported on Windows");
+}
+
+#endif
@@ -0,0 +1,102 @@
+#ifndef DISTSOLVE_HPP
+#define DISTSOLVE_HPP
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "mdp.h"
+#include "param.h"
+
+using namespace std;
+
+// ===================================================
+
+/**
+* Distributed solve of a model using worker processes (multi-process backward induction).
+*
+* The state space of each stage is partitioned into blocks of the mean soil water content (iMW) and each worker
+* process owns the value function of one block. A worker only stores two stages of the iMW slices its transitions
+* reference (the union of the supports of the MW kernel rows of its block), i.e. its memory use shrinks with the
+* number of workers. After each stage the workers send their block to the coordinator, which sends each worker only
+* the slices of the new stage that it references and then writes the stage to the policy files set by
+* MDPV::setExport (see PolicyWriter). The coordinator only holds the stage it relays, i.e. the value function is
+* not kept in the model after the solve.
+*
+* The coordinator and the workers communicate using TCP sockets. Local workers are started using fork, remote
+* workers (e.g. on the nodes of a cluster) are started using Worker with the host and port of the coordinator,
+* the same parameters and the shared token. If all workers are local the coordinator only listens on the loopback
+* interface, otherwise connections that do not send the token are closed. The traffic is not encrypted, i.e. use
+* a trusted network. All processes must run on machines with the same byte order and floating point format.
+* Supported on POSIX systems only.
+*
+* @author Reza Pourmoayed
+*/
+class DistSolver
+{
+  public:
+
+    /** Constructor.
+    *
+    * @param model The model solved (the coordinator). Only double precision is supported.
+    * @param out Stream used for log output.
+    */
+    DistSolver(MDPV & model, ostream & out = cout);
+
+
+    /** Solve the model using worker processes. The policy is written to the files set by MDPV::setExport.
+    *
+    * @param param The parameters of the model (used by the local workers).
+    * @param workers Total number of workers (at most the number of MW intervals).
+    * @param local Number of workers started as local processes (the rest must connect using Worker).
+    * @param port TCP port the coordinator listens on (0 = any free port, only if all workers are local).
+    * @param token Shared secret the workers must send when connecting (required if remote workers are used).
+    *
+    * @return The total reward. Throws std::runtime_error if a local worker exits before the solve is finished.
+    */
+    double Solve(const ModelParam & param, int workers, int local, int port = 0, const string & token = "");
+
+
+    /** Run a worker. Returns when the model is solved. Throws std::runtime_error if the connection fails or the
+    * parameters differ from the ones of the coordinator.
+    *
+    * @param param The parameters of the model (same as the coordinator).
+    * @param host Host name or address of the coordinator.
+    * @param port TCP port of the coordinator.
+    * @param token The token given to the coordinator.
+    * @param out Stream used for log output.
+    */
+    static void Worker(const ModelParam & param, const string & host, int port, const string & token, ostream & out = cout);
+
+
+    /** Number of bytes of the value function sent to the workers in the last solve. */
+    double BytesSent() const {return(bytesSent);}
+
+
+  private:
+
+    /** Pack the value function (and actions) of stage t for iMW in [iMWLo, iMWHi) in the order of getStage. */
+    static void PackSlice(MDPV & m, int t, int iMWLo, int iMWHi, vector<double> & vals, vector<char> * acts);
+
+    /** Store a slice packed using PackSlice. */
+    static void UnpackSlice(MDPV & m, int t, int iMWLo, int iMWHi, const vector<double> & vals, const vector<char> * acts);
+
+    /** Allocate stage t of a worker for iMW in [iMWLo, iMWHi). */
+    static void AllocStage(MDPV & m, int t, int iMWLo, int iMWHi);
+
+    /** Free the memory of stage t of a worker. */
+    static void FreeStage(MDPV & m, int t);
+
+    /** Coordinator part of Solve using the sockets of the connected workers.
+    *
+    * @param sock The socket of each worker (in rank order).
+    * @param hash Hash of the parameters (see ModelParam::hash) the workers must match.
+    */
+    double Coordinate(const vector<int> & sock, unsigned long long hash);
+
+    MDPV & m;
+    ostream & out;
+    double bytesSent;
+};
+
+
+#endif
@@ -0,0 +1,115 @@
+#include "distributions.h"
+#include <cmath>
+
+// ===================================================
+
+static const int MAXIT = 300;        // max number of iterations in series and continued fractions
+static const double EPS = 1e-15;     // relative accuracy
+static const double FPMIN = 1e-300;  // number near the smallest representable double
+
+// ===================================================
+
+double normCdf(double x, double mean, double sd){
+  if (sd <= 0) return(x < mean ? 0 : 1);
+  return( 0.5*std::erfc( -(x-mean)/(sd*std::sqrt(2.0)) ) );
+}
+
+// ===================================================
+
+/** Regularized lower incomplete gamma function evaluated by its series representation (x < a+1). */
+static double gammaSeries(double a, double x){
+  double ap = a, sum = 1.0/a, del = sum;
+  for (int n=0; n<MAXIT; n++) {
+    ap += 1;
+    del *= x/ap;
+    sum += del;
+    if (std::fabs(del) < std::fabs(sum)*EPS) break;
+  }
+  return( sum*std::exp(-x + a*std::log(x) - std::lgamma(a)) );
+}
+
+/** Regularized upper incomplete gamma function evaluated by its continued fraction (x >= a+1). */
+static double gammaContFrac(double a, double x){
+  double b = x+1-a, c = 1/FPMIN, d = 1/b, h = d, an, del;
+  for (int i=1; i<=MAXIT; i++) {
+    an = -i*(i-a);
+    b += 2;
+    d = an*d+b; if (std::fabs(d) < FPMIN) d = FPMIN;
+    c = b+an/c; if (std::fabs(c) < FPMIN) c = FPMIN;
+    d = 1/d;
+    del = d*c;
+    h *= del;
+    if (std::fabs(del-1) < EPS) break;
+  }
+  return( std::exp(-x + a*std::log(x) - std::lgamma(a))*h );
+}
+
+double gammaCdf(double x, double shape, double scale){
+  if (x <= 0) return(0);
+  if (std::isinf(x)) return(1);
+  double z = x/scale;
+  if (z < shape+1) return( gammaSeries(shape, z) );
+  return( 1 - gammaContFrac(shape, z) );
+}
+
+// ===================================================
+
+/** Continued fraction for the incomplete beta function (modified Lentz's method). */
+static double betaContFrac(double a, double b, double x){
+  double qab = a+b, qap = a+1, qam = a-1, c = 1, d = 1-qab*x/qap, m2, aa, del, h;
+  if (std::fabs(d) < FPMIN) d = FPMIN;
+  d = 1/d;
+  h = d;
+  for (int m=1; m<=MAXIT; m++) {
+    m2 = 2*m;
+    aa = m*(b-m)*x/((qam+m2)*(a+m2));
+    d = 1+aa*d; if (std::fabs(d) < FPMIN) d = FPMIN;
+    c = 1+aa/c; if (std::fabs(c) < FPMIN) c = FPMIN;
+    d = 1/d;
+    h *= d*c;
+    aa = -(a+m)*(qab+m)*x/((a+m2)*(qap+m2));
+    d = 1+aa*d; if (std::fabs(d) < FPMIN) d = FPMIN;
+    c = 1+aa/c; if (std::fabs(c) < FPMIN) c = FPMIN;
+    d = 1/d;
+    del = d*c;
+    h *= del;
+    if (std::fabs(del-1) < EPS) break;
+  }
+  return(h);
+}
+
+double betaCdf(double x, double a, double b){
+  return( BetaCdf(a,b)(x) );
+}
+
+// ===================================================
+
+BetaCdf::BetaCdf(double a, double b) : a(a), b(b) {
+  logC = std::lgamma(a+b) - std::lgamma(a) - std::lgamma(b);
+}
+
+// ===================================================
+
+double BetaCdf::operator()(double x) const {
+  if (x <= 0) return(0);
+  if (x >= 1) return(1);
+  double bt = std::exp( logC + a*std::log(x) + b*std::log(1-x) );
+  if (x < (a+1)/(a+b+2)) return( bt*betaContFrac(a,b,x)/a );
+  return( 1 - bt*betaContFrac(b,a,1-x)/b );
+}
+
+// ===================================================
+
+double tQuantile(double p, double df){
+  if (p==0.5) return(0);
+  if (p<0.5) return( -tQuantile(1-p, df) );
+  BetaCdf beta(df/2, 0.5);
+  // P(T <= x) = 1 - I_{df/(df+x^2)}(df/2, 1/2)/2 for x > 0
+  double lo = 0, hi = 1;
+  while (1-beta(df/(df+hi*hi))/2 < p) hi *= 2;
+  for(int i=0; i<200 && hi-lo>1e-12*hi; i++){
+    double x = (lo+hi)/2;
+    if (1-beta(df/(df+x*x))/2 < p) lo = x; else hi = x;
+  }
+  return( (lo+hi)/2 );
+}
@@ -0,0 +1,73 @@
+#ifndef DISTRIBUTIONS_HPP
+#define DISTRIBUTIONS_HPP
+
+// Distribution functions used when calculating the transition probabilities. They replace
+// R::pnorm, R::pgamma and R::pbeta (lower tail, no log) so the model can be solved without R.
+//-----------------------------------------------------------------------------
+
+/** Cumulative distribution function of the normal distribution.
+ *
+ * @param x Quantile.
+ * @param mean Mean.
+ * @param sd Standard deviation.
+ *
+ * @return P(X <= x).
+ */
+double normCdf(double x, double mean, double sd);
+
+
+/** Cumulative distribution function of the gamma distribution.
+ *
+ * @param x Quantile.
+ * @param shape Shape parameter.
+ * @param scale Scale parameter.
+ *
+ * @return P(X <= x), i.e. the regularized lower incomplete gamma function P(shape, x/scale).
+ */
+double gammaCdf(double x, double shape, double scale);
+
+
+/** Cumulative distribution function of the beta distribution.
+ *
+ * @param x Quantile.
+ * @param a Shape parameter 1.
+ * @param b Shape parameter 2.
+ *
+ * @return P(X <= x), i.e. the regularized incomplete beta function I_x(a,b).
+ */
+double betaCdf(double x, double a, double b);
+
+
+/** Quantile function of Student's t distribution (found by bisection on the cdf).
+ *
+ * @param p Probability (in (0,1)).
+ * @param df Degrees of freedom.
+ *
+ * @return x with P(T <= x) = p.
+ */
+double tQuantile(double p, double df);
+
+// ===================================================
+
+/**
+* Cumulative distribution function of a beta distribution with fixed shape parameters. The normalizing constant
+* (three lgamma calls) is calculated once, i.e. evaluating many quantiles (e.g. the interval limits of a row of trans
+* pr) only costs the continued fraction.
+*/
+class BetaCdf
+{
+  public:
+
+    BetaCdf(double a, double b);
+
+    /** P(X <= x). */
+    double operator()(double x) const;
+
+  private:
+
+    double a, b;
+    double logC;   // log(Gamma(a+b)/(Gamma(a)*Gamma(b)))
+};
+
+
+#endif
@@ -0,0 +1,172 @@
+#include "ensemble.h"
+#include "trace.h"
+#include "footprint.h"
+#include "parallel.h"
+#include <map>
+#include <thread>
+
+// ===================================================
+
+Ensemble::Ensemble(const vector<ModelParam> & params, ostream & out) : params(params), out(out) {
+  next = 0;
+  running = 0;
+  memUsed = 0;
+  budget = 0;
+  solvedCallback = NULL;
+}
+
+// ===================================================
+
+vector<double> Ensemble::Solve(int threads, double memBudget, void (*solved)(int i, MDPV & model)){
+  int i, g, n = params.size();
+  ostream nullOut(NULL);   // log output of the models is discarded
+
+  if (threads<=0) threads = thread::hardware_concurrency();
+  if (threads<=0) threads = 1;
+  if (threads>n) threads = n;
+
+  // find the parameter set calculating the tables of each group (the first set with a given hash)
+  out << "Ensemble of " << n << " parameter sets. Distinct tables (soil, SW, weather, reward):";
+  for(g=0; g<TAB_GROUPS; g++){
+    map<unsigned long long, int> first;
+    donor[g].assign(n, -1);
+    for(i=0; i<n; i++){
+      unsigned long long key = params[i].hashTables((TableGroup)g);
+      if (first.count(key)==0) first[key] = i;
+      donor[g][i] = first[key];
+    }
+    out << " " << first.size();
+  }
+  out << endl;
+
+  // calculate the tables of the donors in parallel
+  tables.assign(n, (MDPV*)NULL);
+  mem.assign(n, 0);
+  memTables.assign(n, 0);
+  users.assign(n, 0);
+  stopped = false;
+  vector< pair<int,int> > jobs;   // (parameter set, table group)
+  for(i=0; i<n; i++){
+    for(g=0; g<TAB_GROUPS; g++){
+      users[donor[g][i]]++;
+      if (donor[g][i]!=i) continue;
+      if (tables[i]==NULL) tables[i] = new MDPV(params[i], nullOut);
+      jobs.push_back(make_pair(i,g));
+    }
+  }
+  next = 0;
+  try {
+    RunThreads(threads, [this, &jobs](int) {
+      try {
+        while (true) {
+          int j;
+          {
+            lock_guard<mutex> lk(queueLock);
+            if (next>=(int)jobs.size()) return;
+            j = next++;
+          }
+          TRACE_SPAN_ARG("ensembleTables", jobs[j].first);
+          tables[jobs[j].first]->calcTables((TableGroup)jobs[j].second);
+        }
+      } catch (...) {
+        Stop();
+        throw;
+      }
+    });
+    out << " Calculated " << jobs.size() << " table groups." << endl;
+
+    // estimated memory of each model and donor (the donors are held until their tables have been copied)
+    memUsed = 0;
+    for(i=0; i<n; i++){
+      if (tables[i]!=NULL) {
+        mem[i] = tables[i]->memoryUse();
+        memTables[i] = FootprintPlanner(*tables[i]).TableBytes(MDPV::PREC_DOUBLE);
+        memUsed += memTables[i];
+      }
+      else mem[i] = FootprintPlanner(params[i]).Bytes(MDPV::PREC_DOUBLE);
+    }
+
+    // solve the models
+    rew.assign(n, 0);
+    next = 0;
+    running = 0;
+    budget = memBudget;
+    solvedCallback = solved;
+    RunThreads(threads, [this](int) { Worker(); });
+  } catch (...) {   // the first exception of the workers
+    for(i=0; i<n; i++) delete tables[i];
+    tables.clear();
+    throw;
+  }
+
+  for(i=0; i<n; i++) delete tables[i];   // already released by the workers
+  tables.clear();
+  out << " Solved " << n << " models using " << threads << " threads." << endl;
+  return(rew);
+}
+
+// ===================================================
+
+void Ensemble::Stop(){
+  {
+    lock_guard<mutex> lk(queueLock);
+    stopped = true;
+    next = params.size()*TAB_GROUPS;   // stops both queues (at most TAB_GROUPS table jobs per set)
+  }
+  memFreed.notify_all();
+}
+
+// ===================================================
+
+void Ensemble::ReleaseDonors(int i){
+  for(int g=0; g<TAB_GROUPS; g++){
+    int d = donor[g][i];
+    if (--users[d]>0) continue;
+    delete tables[d];
+    tables[d] = NULL;
+    memUsed -= memTables[d];
+  }
+}
+
+// ===================================================
+
+void Ensemble::Worker(){
+  int i, g, n = params.size();
+  ostream nullOut(NULL);
+
+  while (true) {
+    {
+      unique_lock<mutex> lk(queueLock);
+      if (next>=n) return;
+      i = next++;
+      while ( !stopped && (budget>0) && (running>0) && (memUsed+mem[i]>budget) ) memFreed.wait(lk);
+      if (stopped) return;
+      memUsed += mem[i];
+      running++;
+    }
+    try {
+      TRACE_SPAN_ARG("ensembleModel", i);
+      MDPV model(params[i], nullOut);
+      for(g=0; g<TAB_GROUPS; g++) model.copyTables(*tables[donor[g][i]], (TableGroup)g);
+      {
+        lock_guard<mutex> lk(queueLock);
+        ReleaseDonors(i);
+      }
+      memFreed.notify_all();
+      rew[i] = model.SolveMDP();
+      if (solvedCallback!=NULL) {
+        lock_guard<mutex> lk(callbackLock);
+        solvedCallback(i, model);
+      }
+    } catch (...) {
+      Stop();
+      throw;
+    }
+    {
+      lock_guard<mutex> lk(queueLock);
+      memUsed -= mem[i];
+      running--;
+    }
+    memFreed.notify_all();
+  }
+}
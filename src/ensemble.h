@@ -0,0 +1,87 @@
+#ifndef ENSEMBLE_HPP
+#define ENSEMBLE_HPP
+
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <vector>
+#include "mdp.h"
+
+using namespace std;
+
+// ===================================================
+
+/**
+* Solve the MDP for many parameter sets (e.g. different soil profiles or weather statistics).
+*
+* The parameter sets are grouped by the preprocessing tables they share (see ModelParam::hashTables). Each
+* distinct table group is calculated once and copied into the models that need it, e.g. parameter sets only
+* differing in the weather statistics reuse prMW, prMP and prSP. The models are solved in parallel by a pool of
+* threads such that the estimated memory of the models solved at the same time and the donors (the models holding
+* tables not yet copied by all their users) is below a memory budget. A donor is released when the last model using
+* its tables has copied them.
+*
+* @author Reza Pourmoayed
+*/
+class Ensemble
+{
+  public:
+
+    /** Constructor.
+    *
+    * @param params The parameter sets.
+    * @param out Stream used for log output (the models solved do not write log output).
+    */
+    Ensemble(const vector<ModelParam> & params, ostream & out = cout);
+
+
+    /** Solve all models.
+    *
+    * @param threads Max number of models solved in parallel (0 = number of cores).
+    * @param memBudget Max number of bytes used by the models solved in parallel and the donors (0 = no limit). A
+    *   model is always solved if no other model is being solved.
+    * @param solved Function called with the index of the parameter set and the solved model before the model
+    *   is released (e.g. to write the policy). It is called from the worker threads, one call at a time.
+    *
+    * @return The total reward of each model.
+    *
+    * An exception thrown when calculating the tables, solving a model or by solved stops the remaining work and
+    * is rethrown in the calling thread.
+    */
+    vector<double> Solve(int threads, double memBudget, void (*solved)(int i, MDPV & model) = NULL);
+
+
+  private:
+
+    /** Solve the models in the queue (run by each worker thread). */
+    void Worker();
+
+    /** Stop the queues (a worker has thrown an exception). */
+    void Stop();
+
+    /** Release the donors whose tables have been copied by all users (call with queueLock held). */
+    void ReleaseDonors(int i);
+
+    const vector<ModelParam> & params;
+    ostream & out;
+
+    vector<int> donor[TAB_GROUPS];   // donor[g][i] = index of the parameter set holding the tables in group g of set i
+    vector<MDPV*> tables;            // models holding the preprocessing tables (NULL if the set is not a donor)
+    vector<double> mem;              // estimated memory of each model
+    vector<double> memTables;        // estimated memory of each donor
+    vector<int> users;               // number of (set, group) copies of the tables of each donor left
+    vector<double> rew;              // total reward of each model
+
+    int next;                        // next parameter set to solve
+    int running;                     // number of models being solved
+    double memUsed;                  // estimated memory of the models being solved and the donors
+    double budget;                   // memory budget (0 = no limit)
+    mutex queueLock;                 // protects next, running, memUsed, the donors and stopped
+    condition_variable memFreed;     // signalled when a model has been released
+    mutex callbackLock;              // calls of solvedCallback are serialized
+    void (*solvedCallback)(int i, MDPV & model);
+    bool stopped;                    // true if a worker has thrown an exception
+};
+
+
+#endif
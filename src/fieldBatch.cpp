@@ -0,0 +1,124 @@
+#include "fieldBatch.h"
+#include "parallel.h"
+#include "trace.h"
+#include <cmath>
+#include <stdexcept>
+#include <thread>
+
+// ===================================================
+
+FieldBatch::FieldBatch(const vector<ModelParam> & fields, ostream & out) : nThreads(1), nullOut(NULL), out(out) {
+  for(size_t i=0; i<fields.size(); i++){
+    const ModelParam & p = fields[i];
+    const ModelParam & p0 = fields[0];
+    if( (p.tMax!=p0.tMax) || (p.opNum!=p0.opNum) || (p.opE!=p0.opE) || (p.opL!=p0.opL) || (p.opD!=p0.opD) ||
+        (p.centerPointsAvgWat!=p0.centerPointsAvgWat) || (p.centerPointsSdWat!=p0.centerPointsSdWat) ||
+        (p.centerPointsMeanPos!=p0.centerPointsMeanPos) || (p.centerPointsSdPos!=p0.centerPointsSdPos) ||
+        (p.hashTables(TAB_WEATHER)!=p0.hashTables(TAB_WEATHER)) )
+      throw runtime_error("The fields in a batch must have the same structure and weather statistics");
+  }
+  for(size_t i=0; i<fields.size(); i++) models.push_back(new MDPV(fields[i], nullOut));
+}
+
+// ===================================================
+
+FieldBatch::~FieldBatch(){
+  for(size_t i=0; i<models.size(); i++) delete models[i];
+}
+
+// ===================================================
+
+template<typename F>
+void FieldBatch::ForFields(F f){
+  int n = models.size();
+  RunThreads(nThreads, [&f, n, this](int k) {
+    for(int i=k; i<n; i+=nThreads) f(i);
+  });
+}
+
+// ===================================================
+
+vector<double> FieldBatch::Solve(int threads){
+  int t, n = models.size();
+  int counter=0;
+  vector<double> rew(n);
+
+  nThreads = threads;
+  if (nThreads<=0) nThreads = thread::hardware_concurrency();
+  if (nThreads>n) nThreads = n;
+  if (nThreads<=0) nThreads = 1;
+
+  out << "Solve " << n << " fields using " << nThreads << " threads." << endl;
+  if (n==0) return(rew);
+  MDPV & m = *models[0];
+  ForFields([this](int i) {
+    MDPV & f = *models[i];
+    if(f.valueFun.empty()) f.AllocateValues();
+    f.Preprocess();
+    f.InitFinalValues();
+    f.weatherSlab.assign(f.opNum*(f.opDMax+1)*f.sizeST*f.sizeSP*f.sizeSMW*f.sizeSSW*f.sizeSMP*f.sizeSSP, 0);
+  });
+
+  // weather trans pr from (iTt,iPt) to (iT,iP) (the same for all fields)
+  int iTt, iPt, iT, iP, k=0;
+  weights.resize(m.sizeST*m.sizeSP*m.sizeST*m.sizeSP);
+  for(iTt=0; iTt<m.sizeST; iTt++)
+    for(iPt=0; iPt<m.sizeSP; iPt++)
+      for(iT=0; iT<m.sizeST; iT++)
+        for(iP=0; iP<m.sizeSP; iP++) weights[k++] = exp(m.prT[iTt][iPt][iT] + m.prP[iPt][iP]);
+
+  for(t=m.tMax-1; t>=1; --t){
+    ContractWeather(t+1);
+    vector<int> cnt(n);
+    TRACE_SPAN_ARG("stage", t);
+    ForFields([this, t, &cnt](int i) { cnt[i] = models[i]->SolveStage(t); });
+    for(int i=0; i<n; i++) counter += cnt[i];
+  }
+  for(int i=0; i<n; i++){
+    models[i]->tFirstSolved = 1;
+    models[i]->solvedSettings = models[i]->settingsTag();
+    models[i]->weatherStage = -1;
+    models[i]->totalRew = models[i]->weightIni();
+    rew[i] = models[i]->totalRew;
+  }
+  out << " Number of actions: " << counter << endl;
+  return(rew);
+}
+
+// ===================================================
+
+void FieldBatch::ContractWeather(int t){
+  TRACE_SPAN_ARG("contractWeather", t);
+  MDPV & m = *models[0];   // the weather trans pr are the same for all fields
+  int sizeW = m.sizeST*m.sizeSP;
+
+  ForFields([this, t, sizeW](int i) {
+    MDPV & f = *models[i];
+    int op, d, iTt, iPt, iMW, iSW, iMP, iSP, iT, iP;
+    double* c = &f.weatherSlab[0];
+    for(op=0; op<f.opNum; op++){
+      for(d=0; d<=f.opDMax; d++){
+        for(iTt=0; iTt<f.sizeST; iTt++){
+          for(iPt=0; iPt<f.sizeSP; iPt++){
+            const double* w0 = &weights[(iTt*f.sizeSP+iPt)*sizeW];
+            for(iMW=0; iMW<f.sizeSMW; iMW++){
+              for(iSW=0; iSW<f.sizeSSW; iSW++){
+                for(iMP=0; iMP<f.sizeSMP; iMP++){
+                  for(iSP=0; iSP<f.sizeSSP; iSP++){
+                    const vector< vector<double> > & v = f.valueFun[t][op][d][iMW][iSW][iMP][iSP];
+                    const double* w = w0;
+                    double sum=0;
+                    for(iT=0; iT<f.sizeST; iT++)
+                      for(iP=0; iP<f.sizeSP; iP++) sum += (*w++)*v[iT][iP];
+                    *c++ = sum;
+                  }
+                }
+              }
+            }
+          }
+        }
+      }
+    }
+    f.weatherStage = t;
+  });
+}
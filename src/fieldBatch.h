@@ -0,0 +1,75 @@
+#ifndef FIELDBATCH_HPP
+#define FIELDBATCH_HPP
+
+#include <iostream>
+#include <vector>
+#include "mdp.h"
+
+using namespace std;
+
+// ===================================================
+
+/**
+* Solve the MDP for many fields in the same weather cell.
+*
+* The fields share the weather statistics (prT and prP) and the grids but may have different soil and
+* field parameters (hydro parameters, fieldArea, machCap, ...). The weather trans pr from (iTt, iPt) to (iT, iP)
+* are calculated once and shared by the fields (only this weight array is shared). At each stage the value function
+* of the next stage of each field is contracted over the weather variables, i.e. for each weather state (iTt, iPt)
+* the expectation over the weather of the next day is calculated once per soil state of the field (ContractWeather
+* runs once per field, the fields in parallel). The expectation of each state is then a sum over the soil variables
+* only. An exception thrown when solving a field is rethrown in the calling thread.
+*
+* The value function equals the one found using MDPV::SolveMDP up to rounding (the sums are done in another order).
+*
+* @author Reza Pourmoayed
+*/
+class FieldBatch
+{
+  public:
+
+    /** Constructor.
+    *
+    * @param fields The parameters of each field. Throws std::runtime_error if the fields do not have the
+    *   same structure (tMax, operations and grids) and weather statistics.
+    * @param out Stream used for log output (the fields do not write log output).
+    */
+    FieldBatch(const vector<ModelParam> & fields, ostream & out = cout);
+
+    ~FieldBatch();
+
+
+    /** Solve all fields.
+    *
+    * @param threads Number of threads used (0 = number of cores).
+    *
+    * @return The total reward of each field.
+    */
+    vector<double> Solve(int threads = 1);
+
+
+    /** The model of field i (e.g. to write the policy after Solve). */
+    MDPV & Field(int i) {return(*models[i]);}
+
+    /** Number of fields. */
+    int Size() const {return(models.size());}
+
+
+  private:
+
+    /** Store the value function of stage t of all fields contracted over the weather variables in weatherSlab. */
+    void ContractWeather(int t);
+
+    /** Run f(i) for all fields i using the threads (see RunThreads). */
+    template<typename F>
+    void ForFields(F f);
+
+    vector<MDPV*> models;
+    vector<double> weights;   // weather trans pr [iTt][iPt][iT][iP]
+    int nThreads;
+    ostream nullOut;   // log output of the fields is discarded
+    ostream & out;
+};
+
+
+#endif
@@ -0,0 +1,289 @@
+#include "fieldData.h"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+static const double NA = numeric_limits<double>::quiet_NaN();
+
+// ===================================================
+
+/** Days since 1970-01-01 of a date in the Gregorian calendar. */
+static long long daysFromCivil(long long y, int m, int d){
+  y -= m<=2;
+  long long era = (y>=0 ? y : y-399)/400;
+  long long yoe = y-era*400;
+  long long doy = (153*(m+(m>2 ? -3 : 9))+2)/5+d-1;
+  long long doe = yoe*365+yoe/4-yoe/100+doy;
+  return(era*146097+doe-719468);
+}
+
+// ===================================================
+
+/** Parse the digits in [s,e) (at most n). Returns the number of digits read. */
+static int parseDigits(const char * & s, const char * e, int n, int & x){
+  int k = 0;
+  x = 0;
+  while (s<e && k<n && *s>='0' && *s<='9') { x = x*10+(*s-'0'); s++; k++; }
+  return(k);
+}
+
+// ===================================================
+
+CsvReader::CsvReader(const string & fileName, char sep, size_t blockSize) : sep(sep), pos(0), end(0), eof(false), rows(0) {
+  pFile = fopen(fileName.c_str(), "rb");
+  if (pFile==NULL) throw runtime_error("Cannot open " + fileName);
+  buf.resize(blockSize<16 ? 16 : blockSize);
+  buf[0] = 0;
+  const char *b, *e;
+  if (!NextLine(b, e)) return;
+  if (this->sep==0) {   // the most frequent separator of the header
+    int n[3] = {0,0,0};
+    const char cand[3] = {',', ';', '\t'};
+    for(const char * p=b; p<e; p++) for(int k=0; k<3; k++) n[k] += (*p==cand[k]);
+    this->sep = ',';
+    if (n[1]>n[0]) this->sep = ';';
+    if (n[2]>n[0] && n[2]>n[1]) this->sep = '\t';
+  }
+  while (b<=e) {
+    const char * f = b;
+    while (f<e && *f!=this->sep) f++;
+    const char *s = b, *t = f;
+    while (s<t && isspace((unsigned char)*s)) s++;
+    while (t>s && isspace((unsigned char)t[-1])) t--;
+    names.push_back(string(s, t));
+    b = f+1;
+  }
+  if (!names.empty() && names.back().empty()) names.pop_back();   // separator at the end of the lines
+  types.assign(names.size(), COL_SKIP);
+  values.assign(names.size(), vector<double>());
+}
+
+// ===================================================
+
+CsvReader::~CsvReader(){
+  if (pFile!=NULL) fclose(pFile);
+}
+
+// ===================================================
+
+int CsvReader::Find(const string & name) const {
+  for(size_t i=0; i<names.size(); i++) if (names[i]==name) return(i);
+  for(size_t i=0; i<names.size(); i++) if (names[i].compare(0, name.size(), name)==0) return(i);
+  return(-1);
+}
+
+// ===================================================
+
+void CsvReader::Select(int col, ColType type){
+  if ( (col<0) || (col>=(int)names.size()) ) throw runtime_error("Column index outside the file");
+  types[col] = type;
+}
+
+// ===================================================
+
+bool CsvReader::NextLine(const char * & b, const char * & e){
+  while (true) {
+    // skip empty lines (e.g. the LF of CR+LF)
+    while (pos<end && (buf[pos]=='\n' || buf[pos]=='\r')) pos++;
+    size_t k = pos;
+    while (k<end && buf[k]!='\n' && buf[k]!='\r') k++;
+    if (k<end || (eof && k>pos)) {
+      b = &buf[pos];
+      e = &buf[k];
+      pos = (k<end) ? k+1 : k;
+      return(true);
+    }
+    if (eof) return(false);
+    // move the incomplete line to the front and read the next block
+    memmove(&buf[0], &buf[pos], end-pos);
+    end -= pos;
+    pos = 0;
+    if (end+1>=buf.size()) buf.resize(2*buf.size());   // line longer than the buffer
+    size_t n = fread(&buf[end], 1, buf.size()-end-1, pFile);
+    end += n;
+    buf[end] = 0;
+    if (n==0) eof = true;
+  }
+}
+
+// ===================================================
+
+int CsvReader::Next(int maxRows){
+  int n = 0, col, cols = names.size();
+  const char *b, *e;
+
+  for(col=0; col<cols; col++) values[col].clear();
+  while (n<maxRows && NextLine(b, e)) {
+    const char * p = b;
+    for(col=0; col<cols; col++){
+      const char * f = p;
+      while (f<e && *f!=sep) f++;
+      if (types[col]==COL_DOUBLE) {
+        char * stop;
+        double x = strtod(p, &stop);
+        while (stop<f && isspace((unsigned char)*stop)) stop++;
+        values[col].push_back( (stop==p || stop!=f) ? NA : x );
+      } else if (types[col]==COL_TIME) {
+        values[col].push_back(ParseTime(p, f));
+      }
+      p = (f<e) ? f+1 : e;
+    }
+    n++;
+  }
+  rows += n;
+  return(n);
+}
+
+// ===================================================
+
+double CsvReader::ParseTime(const char * s, const char * e){
+  while (s<e && isspace((unsigned char)*s)) s++;
+  while (e>s && isspace((unsigned char)e[-1])) e--;
+  if (s<e && *s=='"') { s++; if (e>s && e[-1]=='"') e--; }
+  const char * p = s;
+  int y, mo, d, h = 0, mi = 0, sec = 0;
+  if ( parseDigits(p, e, 4, y)==4 && p<e && *p=='-' ) {
+    p++;
+    if ( parseDigits(p, e, 2, mo)==0 || p>=e || *p!='-' ) return(NA);
+    p++;
+    if ( parseDigits(p, e, 2, d)==0 ) return(NA);
+    if ( p<e && (*p==' ' || *p=='T') ) {
+      p++;
+      if ( parseDigits(p, e, 2, h)>0 && p<e && *p==':' ) {
+        p++;
+        parseDigits(p, e, 2, mi);
+        if (p<e && *p==':') { p++; parseDigits(p, e, 2, sec); }
+      }
+    }
+    return( (double)daysFromCivil(y, mo, d)*86400 + h*3600 + mi*60 + sec );
+  }
+  char * stop;
+  string t(s, e);
+  double x = strtod(t.c_str(), &stop);
+  if (stop==t.c_str() || *stop!=0) return(NA);
+  return(x*86400);
+}
+
+// ===================================================
+
+FieldIngest::FieldIngest(const ModelParam & param) : param(param), enc(param), encoded(0), prevD(NA), prevT(NA) {
+  cur.day = -1;
+}
+
+// ===================================================
+
+long long FieldIngest::Read(const string & fileName, const string & timeCol, const string & moistCol,
+                            const vector<string> & tempCols, const string & rainCol, int chunkRows){
+  CsvReader csv(fileName);
+  int cTime = csv.Find(timeCol), cMoist = -1, cRain = csv.Find(rainCol);
+  vector<int> cTemp;
+  if (cTime<0) throw runtime_error("Column " + timeCol + " not found in " + fileName);
+  if (cRain<0) throw runtime_error("Column " + rainCol + " not found in " + fileName);
+  if (!moistCol.empty()) {
+    cMoist = csv.Find(moistCol);
+    if (cMoist<0) throw runtime_error("Column " + moistCol + " not found in " + fileName);
+  }
+  for(size_t i=0; i<tempCols.size(); i++){
+    cTemp.push_back(csv.Find(tempCols[i]));
+    if (cTemp.back()<0) throw runtime_error("Column " + tempCols[i] + " not found in " + fileName);
+  }
+  csv.Select(cTime, CsvReader::COL_TIME);
+  csv.Select(cRain, CsvReader::COL_DOUBLE);
+  if (cMoist>=0) csv.Select(cMoist, CsvReader::COL_DOUBLE);
+  for(size_t i=0; i<cTemp.size(); i++) csv.Select(cTemp[i], CsvReader::COL_DOUBLE);
+
+  int n;
+  while ( (n=csv.Next(chunkRows))>0 ) {
+    const vector<double> & time = csv.Values(cTime);
+    const vector<double> & rain = csv.Values(cRain);
+    for(int r=0; r<n; r++){
+      if (std::isnan(time[r])) continue;
+      int day = (int)floor(time[r]/86400);
+      if (day!=cur.day) {
+        if (cur.day>=0 && day<cur.day) throw runtime_error("The rows of " + fileName + " are not sorted by time");
+        if (cur.day>=0) EndDay();
+        cur.day = day;
+        cur.n = 0;
+        cur.rain = 0;
+        sumMoist = sumTemp = 0;
+        nMoist = nTemp = 0;
+      }
+      cur.n++;
+      if (!std::isnan(rain[r])) cur.rain += rain[r];
+      if (cMoist>=0 && !std::isnan(csv.Values(cMoist)[r])) { sumMoist += csv.Values(cMoist)[r]; nMoist++; }
+      double t = 0;
+      size_t k;
+      for(k=0; k<cTemp.size() && !std::isnan(csv.Values(cTemp[k])[r]); k++) t += csv.Values(cTemp[k])[r];
+      if (k==cTemp.size() && k>0) { sumTemp += t/k; nTemp++; }
+    }
+    EncodeDays();   // the days finished in the chunk
+  }
+  if (cur.day>=0) {
+    EndDay();
+    cur.day = -1;
+  }
+  EncodeDays();
+  return(csv.Rows());
+}
+
+// ===================================================
+
+void FieldIngest::EndDay(){
+  cur.moisture = nMoist>0 ? sumMoist/nMoist : NA;
+  cur.temperature = nTemp>0 ? sumTemp/nTemp : NA;
+
+  // Gaussian SSM filter (GG = 1)
+  double at, Rt, FF;
+  if (days.empty()) {
+    at = param.gSSMm0;
+    Rt = param.gSSMc0 + param.gSSMW;
+    FF = param.hydro(cur.moisture, cur.temperature, cur.rain);
+  } else {
+    at = L1;
+    Rt = L2 + param.gSSMW;
+    FF = param.hydro(prevD, prevT, prevP);
+  }
+  double ft = FF*at;
+  double Qt = FF*Rt*FF + param.gSSMV;
+  double At = Rt*FF/Qt;
+  double et = cur.moisture-ft;
+  double ct = Rt - At*Qt*At;
+  if (std::isnan(et)) {   // no update if the soil water content (or the hydro prediction) is missing
+    At = 0;
+    et = 0;
+    ct = Rt;
+  }
+  cur.meanPos = at;
+  cur.sdPos = sqrt(ct);
+  L1 = at + At*et;
+  L2 = ct;
+  if (!std::isnan(cur.moisture)) prevD = cur.moisture;   // carried forward over days without readings
+  if (!std::isnan(cur.temperature)) prevT = cur.temperature;
+  prevP = cur.rain;
+  days.push_back(cur);
+}
+
+// ===================================================
+
+void FieldIngest::EncodeDays(){
+  int n = days.size()-encoded;
+  if (n<=0) return;
+  vector<double> x[StateEncoder::VARS];
+  for(size_t k=encoded; k<days.size(); k++){
+    x[0].push_back(days[k].moisture);
+    x[1].push_back(param.disSdWat(0,0));   // the sd of the soil water content is not observed (index 0 as in optimalSearch)
+    x[2].push_back(days[k].meanPos);
+    x[3].push_back(days[k].sdPos);
+    x[4].push_back(days[k].temperature);
+    x[5].push_back(days[k].rain);
+  }
+  const double* px[StateEncoder::VARS];
+  for(int v=0; v<StateEncoder::VARS; v++) px[v] = &x[v][0];
+  vector<int> idx(n*StateEncoder::VARS);
+  enc.Encode(n, px, &idx[0]);
+  for(int k=0; k<n; k++)
+    for(int v=0; v<StateEncoder::VARS; v++) days[encoded+k].idx[v] = idx[k*StateEncoder::VARS+v];
+  encoded = days.size();
+}
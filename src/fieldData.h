@@ -0,0 +1,178 @@
+#ifndef FIELDDATA_HPP
+#define FIELDDATA_HPP
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "param.h"
+#include "stateEncoder.h"
+
+using namespace std;
+
+// ===================================================
+
+/**
+* Streaming reader of delimited text files (sensor and weather data).
+*
+* The file is read in blocks and parsed in chunks of rows, i.e. the memory used does not depend on the size of the
+* file. Only the selected columns are converted (numbers to double, time stamps to seconds since 1970-01-01). The
+* separator (',', ';' or tab) is found from the header if not given. Lines may end with LF, CR+LF or CR, white space
+* around the values is ignored and empty or non-numeric values are read as NaN.
+*
+* @author Reza Pourmoayed
+*/
+class CsvReader
+{
+  public:
+
+    /** Column types. */
+    enum ColType {COL_SKIP = 0, COL_DOUBLE = 1, COL_TIME = 2};
+
+    /** Constructor. Open the file and read the header. Throws std::runtime_error if the file cannot be opened.
+    *
+    * @param fileName Name of the file.
+    * @param sep Separator (0 = found from the header).
+    * @param blockSize Number of bytes read from the file at a time.
+    */
+    CsvReader(const string & fileName, char sep = 0, size_t blockSize = 1<<20);
+
+    ~CsvReader();
+
+
+    /** The column names of the header. */
+    const vector<string> & Names() const {return(names);}
+
+
+    /** The index of a column. A column with the exact name is preferred, otherwise the first column whose name
+    * starts with name is used.
+    *
+    * @return The index or -1 if not found.
+    */
+    int Find(const string & name) const;
+
+
+    /** Set the type of column col (columns are skipped by default). */
+    void Select(int col, ColType type);
+
+
+    /** Parse the next chunk of rows.
+    *
+    * @param maxRows Max number of rows parsed.
+    *
+    * @return The number of rows parsed (0 at the end of the file).
+    */
+    int Next(int maxRows);
+
+
+    /** The values of column col in the current chunk (seconds since 1970-01-01 for COL_TIME columns). */
+    const vector<double> & Values(int col) const {return(values[col]);}
+
+
+    /** Number of rows parsed. */
+    long long Rows() const {return(rows);}
+
+
+    /** Parse a time stamp (YYYY-MM-DD[ hh:mm[:ss]]) or a day number to seconds since 1970-01-01 (day numbers are
+    * multiplied by 86400). Returns NaN if the text is neither.
+    */
+    static double ParseTime(const char * s, const char * e);
+
+
+  private:
+
+    /** Find the next line in the buffer (refilled as needed). Returns false at the end of the file. */
+    bool NextLine(const char * & b, const char * & e);
+
+    FILE * pFile;
+    char sep;
+    vector<char> buf;          // data read from the file (buf[end] is a zero sentinel)
+    size_t pos, end;           // the unparsed data is buf[pos..end)
+    bool eof;
+    vector<string> names;
+    vector<ColType> types;
+    vector< vector<double> > values;
+    long long rows;
+};
+
+// ===================================================
+
+/** The daily state of a field found by FieldIngest. A variable without readings on the day is NaN and its state
+*  index is -1.
+*/
+struct FieldDay {
+  int day;               // days since 1970-01-01 (or the day number of the file)
+  int n;                 // number of readings
+  double moisture;       // mean soil water content (NaN if not observed)
+  double temperature;    // mean temperature (NaN if not observed)
+  double rain;           // sum of precipitation
+  double meanPos;        // mean of the latent soil water content (prior, as DLMfilter in R)
+  double sdPos;          // sd of the latent soil water content (posterior)
+  int idx[StateEncoder::VARS];   // the state indexes (iMW, iSW, iMP, iSP, iT, iP), -1 if outside the grid or not observed
+};
+
+// ===================================================
+
+/**
+* Ingest sensor and weather data of a field: readings -> daily means -> Gaussian SSM filter -> state indexes.
+*
+* The file is parsed in chunks using CsvReader. The readings of a day are aggregated (mean soil water content and
+* temperature, sum of precipitation) and each finished day is passed to the Gaussian SSM filter (same recursions
+* as DLMfilter in R). The days finished in a chunk are encoded in one call of StateEncoder::Encode. The rows must
+* be sorted by time. Readings with a missing value are ignored for that value
+* and days without soil water content only have the prediction step of the filter. The hydro model of a day uses
+* the last observed soil water content and temperature, i.e. a day without them does not skip the update of the
+* next day.
+*
+* @author Reza Pourmoayed
+*/
+class FieldIngest
+{
+  public:
+
+    /** Constructor.
+    *
+    * @param param Model parameters (hydro model, Gaussian SSM and discretization matrices).
+    */
+    FieldIngest(const ModelParam & param);
+
+
+    /** Read a file (the days are added to the days already read).
+    *
+    * @param fileName Name of the file.
+    * @param timeCol Name of the time column (time stamps or day numbers).
+    * @param moistCol Name of the soil water content column ("" = none, e.g. weather data).
+    * @param tempCols Names of the temperature columns (the mean of the columns is used, e.g. high and low temperature).
+    * @param rainCol Name of the precipitation column.
+    * @param chunkRows Number of rows parsed at a time.
+    *
+    * @return The number of rows read. Throws std::runtime_error if a column is not found or the rows are not sorted.
+    */
+    long long Read(const string & fileName, const string & timeCol, const string & moistCol,
+                   const vector<string> & tempCols, const string & rainCol, int chunkRows = 65536);
+
+
+    /** The days read. */
+    const vector<FieldDay> & Days() const {return(days);}
+
+
+  private:
+
+    /** Finish the current day and run the filter. */
+    void EndDay();
+
+    /** Encode the days not encoded yet. */
+    void EncodeDays();
+
+    ModelParam param;
+    StateEncoder enc;
+    vector<FieldDay> days;
+    size_t encoded;                      // number of days encoded
+    FieldDay cur;                        // the day being aggregated
+    double sumMoist, sumTemp;
+    int nMoist, nTemp;
+    double L1, L2;                       // posterior mean and variance of the last day
+    double prevD, prevT, prevP;          // last observed soil water content and temperature and the last rain
+};
+
+
+#endif
@@ -0,0 +1,424 @@
+#include "footprint.h"
+#include "trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <stdexcept>
+
+static const char * precisionName[3] = {"double", "float", "q16"};
+
+// ===================================================
+
+/** Bytes of a heap block of n bytes (glibc malloc on 64 bit systems). */
+static double heapBytes(double n){
+  if (n<=0) return(0);
+  if (n>=128*1024) return( ceil((n+16)/4096)*4096 );   // mmap
+  return( max(32.0, floor((n+8+15)/16)*16) );
+}
+
+// ===================================================
+
+/** Bytes of a flat vector of n elements of elem bytes (the capacity is rounded up to a power of two if grown
+ * using push_back).
+ */
+static double flatBytes(double n, double elem, bool pushed = false){
+  if (pushed && n>0) n = pow(2, ceil(log2(n)));
+  return( sizeof(vector<int>) + heapBytes(n*elem) );
+}
+
+// ===================================================
+
+/** Bytes of nested vectors with the given dimensions and element size (including the outer vector object). */
+static double nestedBytes(const vector<double> & dims, double elem){
+  double bytes = sizeof(vector<int>), count = 1;
+  for(size_t i=0; i<dims.size(); i++){
+    bytes += count*heapBytes( dims[i]*(i+1<dims.size() ? sizeof(vector<int>) : elem) );
+    count *= dims[i];
+  }
+  return(bytes);
+}
+
+// ===================================================
+
+/** Same as MDPV::ValidState. */
+static bool validState(const vector<double> & opE, const vector<double> & opL, const vector<double> & opD, int t, int op, int d){
+  if( (opE[op]>t) || (opL[op]<=t) ) return(false);
+  if( (d<1) || (d>opD[op]) ) return(false);
+  if( (opD[op]-t+opE[op]>d) || (opL[op]-t<d) ) return(false);
+  return(true);
+}
+
+// ===================================================
+
+FootprintPlanner::FootprintPlanner(const ModelParam & param) : tMax(param.tMax), opNum(param.opNum), opE(param.opE),
+  opL(param.opL), opD(param.opD), probed(false) {
+  sizeSMW = param.centerPointsAvgWat.size();
+  sizeSSW = param.centerPointsSdWat.size();
+  sizeSMP = param.centerPointsMeanPos.size();
+  sizeSSP = param.centerPointsSdPos.size();
+  sizeST = param.centerPointsTem.size();
+  sizeSP = param.centerPointsPre.size();
+  opDMax = 0;
+  for(int op=0; op<opNum; op++) opDMax = max(opDMax, (int)opD[op]);
+  slicesExp = 0;
+  for(int t=1; t<tMax; t++)
+    for(int op=0; op<opNum; op++)
+      for(int d=1; d<=opD[op]; d++)
+        if (validState(opE, opL, opD, t, op, d)) slicesExp += (d<opL[op]-t) + ((d>1) || (op<opNum-1));
+}
+
+// ===================================================
+
+FootprintPlanner::FootprintPlanner(const MDPV & m) : tMax(m.tMax), opNum(m.opNum), opDMax(m.opDMax), opE(m.opE),
+  opL(m.opL), opD(m.opD), sizeSMW(m.sizeSMW), sizeSSW(m.sizeSSW), sizeSMP(m.sizeSMP), sizeSSP(m.sizeSSP),
+  sizeST(m.sizeST), sizeSP(m.sizeSP), probed(false) {
+  slicesExp = 0;
+  for(int t=1; t<tMax; t++)
+    for(int op=0; op<opNum; op++)
+      for(int d=1; d<=opD[op]; d++)
+        if (m.ValidState(t, op, d)) slicesExp += (d<opL[op]-t) + ((d>1) || (op<opNum-1));
+}
+
+// ===================================================
+
+double FootprintPlanner::States() const {
+  double n = 0;
+  for(int t=1; t<tMax; t++)
+    for(int op=0; op<opNum; op++)
+      for(int d=1; d<=opD[op]; d++) n += validState(opE, opL, opD, t, op, d);
+  return( n*sizeSMW*sizeSSW*sizeSMP*sizeSSP*sizeST*sizeSP );
+}
+
+// ===================================================
+
+double FootprintPlanner::Expectations() const {
+  return( slicesExp*sizeSMW*sizeSSW*sizeSMP*sizeSSP*sizeST*sizeSP );
+}
+
+// ===================================================
+
+vector<FootprintReport::Table> FootprintPlanner::Tables() const {
+  double G = (double)sizeSMW*sizeSSW*sizeSMP*sizeSSP*sizeST*sizeSP;
+  double rowsMW = (double)sizeSMW*sizeSMP*sizeSSP*sizeST*sizeSP, rowsSP = (double)sizeSMW*sizeSSP*sizeST*sizeSP;
+  double S = sizeof(string), D = sizeof(double), I = sizeof(int), F = sizeof(float), Q = sizeof(unsigned short);
+  vector<FootprintReport::Table> tab;
+  FootprintReport::Table x;
+
+  // the same in all precisions
+  x.name = "valueFun";
+  x.entries = (tMax+1)*opNum*(opDMax+1)*G;
+  x.bytes[0] = nestedBytes({(double)tMax+1, (double)opNum, (double)opDMax+1, (double)sizeSMW, (double)sizeSSW,
+                            (double)sizeSMP, (double)sizeSSP, (double)sizeST, (double)sizeSP}, D);
+  tab.push_back(x);
+  x.name = "optAction";
+  x.bytes[0] = nestedBytes({(double)tMax+1, (double)opNum, (double)opDMax+1, (double)sizeSMW, (double)sizeSSW,
+                            (double)sizeSMP, (double)sizeSSP, (double)sizeST, (double)sizeSP}, S);
+  tab.push_back(x);
+  x.name = "mapL1Vector";
+  x.entries = opNum*(opDMax+1)*G;
+  x.bytes[0] = nestedBytes({(double)opNum, (double)opDMax+1, (double)sizeSMW, (double)sizeSSW, (double)sizeSMP,
+                            (double)sizeSSP, (double)sizeST, (double)sizeSP}, I);
+  tab.push_back(x);
+  x.name = "prMW";
+  x.entries = rowsMW*sizeSMW;
+  x.bytes[0] = nestedBytes({(double)sizeSMW, (double)sizeSMP, (double)sizeSSP, (double)sizeST, (double)sizeSP, (double)sizeSMW}, D);
+  tab.push_back(x);
+  x.name = "prMP";
+  x.entries = rowsMW*sizeSMP;
+  x.bytes[0] = nestedBytes({(double)sizeSMW, (double)sizeSMP, (double)sizeSSP, (double)sizeST, (double)sizeSP, (double)sizeSMP}, D);
+  tab.push_back(x);
+  x.name = "prSP";
+  x.entries = rowsSP*sizeSSP;
+  x.bytes[0] = nestedBytes({(double)sizeSMW, (double)sizeSSP, (double)sizeST, (double)sizeSP, (double)sizeSSP}, D);
+  tab.push_back(x);
+  x.name = "prSW";
+  x.entries = (double)(tMax+1)*sizeSSW*sizeSSW;
+  x.bytes[0] = nestedBytes({(double)tMax+1, (double)sizeSSW, (double)sizeSSW}, D);
+  tab.push_back(x);
+  x.name = "prT, prP";
+  x.entries = (double)sizeST*sizeSP*sizeST + sizeSP*sizeSP;
+  x.bytes[0] = nestedBytes({(double)sizeST, (double)sizeSP, (double)sizeST}, D) + nestedBytes({(double)sizeSP, (double)sizeSP}, D);
+  tab.push_back(x);
+  x.name = "rewDo";
+  x.entries = (double)opNum*sizeSMW*sizeSSW;
+  x.bytes[0] = nestedBytes({(double)opNum, (double)sizeSMW, (double)sizeSSW}, D) + flatBytes(tMax+1, D);   // and valFunDummy
+  tab.push_back(x);
+  x.name = "supports";   // row sums, supports and removed mass of the factors (see CalcSupport)
+  x.entries = 2*rowsMW + rowsSP + sizeST*sizeSP + sizeSP + (tMax+1)*sizeSSW;
+  x.bytes[0] = 2*flatBytes(rowsMW, D) + flatBytes(rowsSP, D) + flatBytes(sizeST*sizeSP, D) + flatBytes(sizeSP, D) +
+               2*flatBytes(2*rowsMW, I) + flatBytes(2*rowsSP, I) + flatBytes(2*sizeST*sizeSP, I) + flatBytes(2*sizeSP, I) +
+               2*flatBytes(rowsMW, D, true) + flatBytes(rowsSP, D, true) + flatBytes(sizeST*sizeSP, D, true) + flatBytes(sizeSP, D, true) +
+               flatBytes((tMax+1)*sizeSSW, D) + flatBytes(tMax+1, 1) + flatBytes(tMax+1, D);
+  tab.push_back(x);
+  x.name = "bounds";   // vMin and vMax (action elimination)
+  x.entries = 2.0*opNum*(opDMax+1)*sizeSMW;
+  x.bytes[0] = 2*flatBytes(opNum*(opDMax+1)*sizeSMW, D);
+  tab.push_back(x);
+  for(size_t i=0; i<tab.size(); i++) tab[i].bytes[1] = tab[i].bytes[2] = tab[i].bytes[0];
+  tab[3].bytes[1] = tab[3].bytes[2] = tab[4].bytes[1] = tab[4].bytes[2] = 0;   // prMW and prMP are released (see MDPV::setPrecision)
+
+  // only used with reduced precision
+  x.name = "reduced tables";
+  x.entries = rowsMW*sizeSMW + rowsMW*sizeSMP + rowsSP*sizeSSP + (tMax+1)*sizeSSW*sizeSSW + sizeST*sizeSP*sizeST + sizeSP*sizeSP;
+  x.bytes[0] = 0;
+  x.bytes[1] = flatBytes(rowsMW*sizeSMW, F) + flatBytes(rowsMW*sizeSMP, F) + flatBytes(rowsSP*sizeSSP, F) +
+               flatBytes((tMax+1)*sizeSSW*sizeSSW, F) + flatBytes(sizeST*sizeSP*sizeST, F) + flatBytes(sizeSP*sizeSP, F);
+  x.bytes[2] = flatBytes(rowsMW*sizeSMW, Q) + flatBytes(rowsMW*sizeSMP, Q) + flatBytes(rowsSP*sizeSSP, Q) +
+               flatBytes((tMax+1)*sizeSSW*sizeSSW, Q) + flatBytes(sizeST*sizeSP*sizeST, Q) + flatBytes(sizeSP*sizeSP, Q);
+  tab.push_back(x);
+  return(tab);
+}
+
+// ===================================================
+
+double FootprintPlanner::Bytes(MDPV::Precision mode) const {
+  vector<FootprintReport::Table> tab = Tables();
+  double bytes = 0;
+  for(size_t i=0; i<tab.size(); i++) bytes += tab[i].bytes[mode];
+  return(bytes);
+}
+
+// ===================================================
+
+double FootprintPlanner::TableBytes(MDPV::Precision mode) const {
+  vector<FootprintReport::Table> tab = Tables();
+  double bytes = 0;
+  for(size_t i=3; i<tab.size(); i++) bytes += tab[i].bytes[mode];   // all but valueFun, optAction and mapL1Vector
+  return(bytes);
+}
+
+// ===================================================
+
+double FootprintPlanner::WorkerBytes(int workers) const {
+  vector<FootprintReport::Table> tab = Tables();
+  double fixed = 0;   // everything except the value function and the optimal actions
+  for(size_t i=2; i<tab.size(); i++) fixed += tab[i].bytes[MDPV::PREC_DOUBLE];
+  vector<double> outer = {(double)tMax+1, (double)opNum, (double)opDMax+1, (double)sizeSMW};
+  vector<double> inner = {(double)sizeSSW, (double)sizeSMP, (double)sizeSSP, (double)sizeST, (double)sizeSP};
+  double slice = nestedBytes(inner, sizeof(double)) + nestedBytes(inner, sizeof(string)) - 2*sizeof(vector<int>);
+  double G = (double)sizeSSW*sizeSMP*sizeSSP*sizeST*sizeSP;   // states of an iMW slice
+  int slicesMax = StageSlices();
+
+  double bytes = 0;
+  for(int w=0; w<workers; w++){
+    int from = (long long)sizeSMW*w/workers, to = (long long)sizeSMW*(w+1)/workers;
+    int lo = 0, hi = sizeSMW;
+    if (probed) {
+      lo = from;
+      hi = to;
+      for(int iMW=from; iMW<to; iMW++){
+        if (refLo[iMW]>=refHi[iMW]) continue;
+        lo = min(lo, refLo[iMW]);
+        hi = max(hi, refHi[iMW]);
+      }
+    }
+    double b = fixed + nestedBytes(outer, sizeof(vector<int>)) + nestedBytes(outer, sizeof(vector<int>)) +
+      2.0*opNum*(opDMax+1)*(hi-lo)*slice +                     // two stages of the referenced slices
+      flatBytes(slicesMax*(hi-lo)*G, sizeof(double)+1);        // the packed values and actions sent and received
+    bytes = max(bytes, b);
+  }
+  return(bytes);
+}
+
+// ===================================================
+
+double FootprintPlanner::CoordinatorBytes() const {
+  vector<FootprintReport::Table> tab = Tables();
+  double fixed = 0;   // everything except the value function and the optimal actions
+  for(size_t i=2; i<tab.size(); i++) fixed += tab[i].bytes[MDPV::PREC_DOUBLE];
+  vector<double> outer = {(double)tMax+1, (double)opNum, (double)opDMax+1, (double)sizeSMW};
+  vector<double> inner = {(double)sizeSSW, (double)sizeSMP, (double)sizeSSP, (double)sizeST, (double)sizeSP};
+  double slice = nestedBytes(inner, sizeof(double)) + nestedBytes(inner, sizeof(string)) - 2*sizeof(vector<int>);
+  double G = (double)sizeSSW*sizeSMP*sizeSSP*sizeST*sizeSP;   // states of an iMW slice
+  return(fixed + nestedBytes(outer, sizeof(vector<int>)) + nestedBytes(outer, sizeof(vector<int>)) +
+    1.0*opNum*(opDMax+1)*sizeSMW*slice +                        // the stage being relayed
+    4*flatBytes(StageSlices()*sizeSMW*G, sizeof(double)+1));    // packed stages: relayed, queued (2) and written
+}
+
+// ===================================================
+
+int FootprintPlanner::StageSlices() const {
+  int slicesMax = 0;
+  for(int t=1; t<tMax; t++){
+    int n = 0;
+    for(int op=0; op<opNum; op++)
+      for(int d=1; d<=opD[op]; d++) n += validState(opE, opL, opD, t, op, d);
+    slicesMax = max(slicesMax, n);
+  }
+  return(slicesMax);
+}
+
+// ===================================================
+
+void FootprintPlanner::Probe(MDPV & m, int rows){
+  TRACE_SPAN("footprintProbe");
+  int t, iMW, iSW, i;
+
+  if (!m.valueFun.empty()) throw runtime_error("The probe needs a model without a value function");
+  if (m.precision!=MDPV::PREC_DOUBLE) throw runtime_error("The probe needs a model in double precision");
+  // the tables (all days of prSW)
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  if (!m.preprocessed) m.Preprocess();
+  for(t=1; t<m.tMax; t++) m.CalcTransPrSW(t);
+  m.InitFinalValues();
+  preprocess = chrono::duration<double>(chrono::steady_clock::now()-start).count();
+
+  // the kernel updates of a solve found from the supports
+  int rowsMW = sizeSMW*sizeSMP*sizeSSP*sizeST*sizeSP;
+  vector<double> units(rowsMW);   // successors of ExpectSW of each row
+  visited = 0;
+  refLo.assign(sizeSMW, sizeSMW);
+  refHi.assign(sizeSMW, 0);
+  for(int row=0; row<rowsMW; row++){
+    int iPt = row % sizeSP, iTt = (row/sizeSP) % sizeST, iSPt = (row/(sizeSP*sizeST)) % sizeSSP;
+    int iMPt = (row/(sizeSP*sizeST*sizeSSP)) % sizeSMP, iMWt = row/(sizeSP*sizeST*sizeSSP*sizeSMP);
+    MDPV::KernelRow r = m.Row(iMWt, iMPt, iSPt, iTt, iPt);
+    const int* s[5] = {r.sMW, r.sMP, r.sSP, r.sT, r.sP};
+    double n = 1;
+    for(i=0; i<5; i++) n *= max(0, s[i][1]-s[i][0]);
+    units[row] = n;
+    visited += n*sizeSSW*sizeSSW;   // the parents (iSWt) and successors (iSW) of the row
+    if (s[0][0]<s[0][1]) {
+      refLo[iMWt] = min(refLo[iMWt], s[0][0]);
+      refHi[iMWt] = max(refHi[iMWt], s[0][1]);
+    }
+  }
+  double sumUnits = 0;
+  for(int row=0; row<rowsMW; row++) sumUnits += units[row];
+  updates = slicesExp*sumUnits*sizeSSW + Expectations()*sizeSSW;   // ExpectSW once per (t,op,d,row) and Expect per state
+
+  // one slice of the value function (op 0 at day opE with opD days left) and a sample of parent states
+  typedef vector< vector< vector< vector< vector<double> > > > > Slice;
+  int t0 = (int)m.opE[0], d0 = (int)m.opD[0];
+  m.valueFun.assign(m.tMax+1, vector< vector< vector<Slice> > >(m.opNum, vector< vector<Slice> >(m.opDMax+1, vector<Slice>(m.sizeSMW))));
+  for(iMW=0; iMW<sizeSMW; iMW++)
+    m.valueFun[t0+1][0][d0][iMW] = Slice(sizeSSW, vector< vector< vector< vector<double> > > >(sizeSMP,
+                                   vector< vector< vector<double> > >(sizeSSP, vector< vector<double> >(sizeST, vector<double>(sizeSP, 1.0)))));
+  vector<int> sample(rows), sampleSW(rows);
+  unsigned long long r = 88172645463325252ULL;
+  for(i=0; i<rows; i++){
+    r ^= r << 13; r ^= r >> 7; r ^= r << 17;
+    sample[i] = r % rowsMW;
+    sampleSW[i] = (r >> 32) % sizeSSW;
+  }
+  volatile double sink = 0;
+  for(int k=0; k<3; k++){   // Expect uses the reduced precision tables (ExpectReduced) if calculated
+    if (k==MDPV::PREC_FLOAT) m.CalcReduced(m.redF);
+    if (k==MDPV::PREC_Q16) m.CalcReduced(m.redQ);
+    m.precision = (MDPV::Precision)k;
+    double n = 0, elapsed = 0;
+    start = chrono::steady_clock::now();
+    while (elapsed<0.05 && n<1e12) {   // repeat the sample for at least 50 ms
+      for(i=0; i<rows; i++){
+        int row = sample[i];
+        int iPt = row % sizeSP, iTt = (row/sizeSP) % sizeST, iSPt = (row/(sizeSP*sizeST)) % sizeSSP;
+        int iMPt = (row/(sizeSP*sizeST*sizeSSP)) % sizeSMP, iMWt = row/(sizeSP*sizeST*sizeSSP*sizeSMP);
+        iSW = sampleSW[i];
+        m.keySW[0] = m.keySW[1] = -1;
+        sink = sink + m.Expect(t0, 0, d0, iMWt, iSW, iMPt, iSPt, iTt, iPt);
+        n += units[row]*sizeSSW + sizeSSW;
+      }
+      elapsed = chrono::duration<double>(chrono::steady_clock::now()-start).count();
+    }
+    ns[k] = (n>0) ? 1e9*elapsed/n : 0;
+  }
+  m.precision = MDPV::PREC_DOUBLE;
+  m.redF = RedTables<float>();
+  m.redQ = RedTables<unsigned short>();
+  m.valueFun.clear();   // allocated when solved
+  probed = true;
+}
+
+// ===================================================
+
+double FootprintPlanner::Seconds(MDPV::Precision mode, int workers) const {
+  if (!probed) return(-1);
+  return( preprocess + 1e-9*ns[mode]*updates/workers );   // the reduced precision kernels visit the same successors
+}
+
+// ===================================================
+
+FootprintReport FootprintPlanner::Plan(double budget, int cores) const {
+  FootprintReport rep;
+  int s[6] = {sizeSMW, sizeSSW, sizeSMP, sizeSSP, sizeST, sizeSP};
+  rep.sizes.assign(s, s+6);
+  rep.states = States();
+  rep.expectations = Expectations();
+  rep.transitions = rep.expectations*sizeSMW*sizeSSW*sizeSMP*sizeSSP*sizeST*sizeSP;
+  rep.visited = probed ? slicesExp*visited : -1;
+  rep.tables = Tables();
+  for(int k=0; k<3; k++){
+    rep.total[k] = 0;
+    for(size_t i=0; i<rep.tables.size(); i++) rep.total[k] += rep.tables[i].bytes[k];
+    rep.seconds[k] = Seconds((MDPV::Precision)k);
+  }
+  for(int k=0; k<3; k++) rep.nsPerUpdate[k] = probed ? ns[k] : -1;
+  rep.preprocessSeconds = probed ? preprocess : -1;
+  rep.budget = budget;
+
+  // the candidates: a single process in each precision or a distributed solve with local workers
+  bool found = false;
+  for(int w=0; w<=min(cores, sizeSMW); w++){
+    if (w==1) continue;
+    for(int k=0; k<3; k++){
+      if ( (w>0) && (k!=MDPV::PREC_DOUBLE) ) continue;   // distributed solves use double precision
+      double workerBytes = (w>0) ? WorkerBytes(w) : 0;
+      double bytes = (w>0) ? CoordinatorBytes() + w*workerBytes : rep.total[k];
+      double time = Seconds((MDPV::Precision)k, max(w, 1));
+      bool fits = (budget<=0) || (bytes<=budget);
+      bool better;
+      if (!found) better = true;
+      else if (fits!=rep.fits) better = fits;
+      else if (fits && probed) better = (time<rep.time) || ( (time==rep.time) && (bytes<rep.bytes) );
+      else better = (bytes<rep.bytes);
+      if (!better) continue;
+      found = true;
+      rep.precision = (MDPV::Precision)k;
+      rep.workers = w;
+      rep.workerBytes = workerBytes;
+      rep.bytes = bytes;
+      rep.time = time;
+      rep.fits = fits;
+    }
+  }
+  return(rep);
+}
+
+// ===================================================
+
+void FootprintReport::print(ostream & out) const {
+  const double MB = 1048576;
+  out << "Footprint of the model (grid " << sizes[0];
+  for(size_t i=1; i<sizes.size(); i++) out << "x" << sizes[i];
+  out << "):" << endl;
+  out << "  States: " << states << ", expectations: " << expectations << ", transitions (dense kernel): " << transitions << endl;
+  if (visited>=0) out << "  Transitions in the support of the kernel: " << visited << endl;
+  out << "  Memory (MB)           double       float         q16" << endl;
+  ios::fmtflags flags = out.flags();
+  streamsize prec = out.precision();
+  out << fixed << setprecision(2);
+  for(size_t i=0; i<tables.size(); i++){
+    out << "  " << left << setw(16) << tables[i].name << right;
+    for(int k=0; k<3; k++) out << setw(12) << tables[i].bytes[k]/MB;
+    out << endl;
+  }
+  out << "  " << left << setw(16) << "total" << right;
+  for(int k=0; k<3; k++) out << setw(12) << total[k]/MB;
+  out << endl;
+  out.flags(flags);
+  out.precision(prec);
+  if (nsPerUpdate[0]>=0) {
+    out << "  Probe: tables " << preprocessSeconds << " s, kernel update double " << nsPerUpdate[0] << " ns, float "
+        << nsPerUpdate[1] << " ns, q16 " << nsPerUpdate[2] << " ns" << endl;
+    out << "  Estimated solve time (no action elimination): double " << seconds[0] << " s, float " << seconds[1]
+        << " s, q16 " << seconds[2] << " s" << endl;
+  }
+  out << "  Recommended: " << precisionName[precision] << " precision, ";
+  if (workers>0) out << "distributed with " << workers << " local workers (" << workerBytes/MB << " MB each), ";
+  else out << "single process, ";
+  out << bytes/MB << " MB";
+  if (time>=0) out << ", " << time << " s";
+  if (budget>0) out << (fits ? " (fits the budget of " : " (does not fit the budget of ") << budget/MB << " MB)";
+  out << endl;
+}
@@ -0,0 +1,155 @@
+#ifndef FOOTPRINT_HPP
+#define FOOTPRINT_HPP
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "mdp.h"
+#include "param.h"
+
+using namespace std;
+
+// ===================================================
+
+/** Result of FootprintPlanner::Plan. */
+struct FootprintReport {
+
+  /** Bytes of a table (or group of small arrays) under each storage precision. */
+  struct Table {
+    string name;
+    double entries;     // number of values
+    double bytes[3];    // PREC_DOUBLE, PREC_FLOAT, PREC_Q16
+  };
+
+  vector<int> sizes;           // grid sizes (iMW, iSW, iMP, iSP, iT, iP)
+  double states;               // states of the model (t, op, d and grid)
+  double expectations;         // expectations calculated when solving (pos. and do.)
+  double transitions;          // successors of the expectations (dense kernel)
+  double visited;              // successors visited by the double precision kernel (support, -1 if not probed)
+  vector<Table> tables;
+  double total[3];             // total bytes under each precision
+  double workerBytes;          // max bytes of a worker of a distributed solve with the recommended workers
+  double nsPerUpdate[3];       // time of a kernel update under each precision (-1 if not probed)
+  double preprocessSeconds;    // time of the tables (-1 if not probed)
+  double seconds[3];           // estimated solve time under each precision (-1 if not probed)
+
+  double budget;               // memory budget (0 = none)
+  MDPV::Precision precision;   // recommended precision
+  int workers;                 // recommended number of local workers (0 = a single process)
+  double bytes;                // bytes of the recommendation (all processes)
+  double time;                 // estimated time of the recommendation (-1 if not probed)
+  bool fits;                   // true if the recommendation fits the budget
+
+  /** Print the report. */
+  void print(ostream & out) const;
+};
+
+// ===================================================
+
+/**
+* Plan the memory and time of a solve before the model is allocated.
+*
+* The number of states, expectations and transitions are found in closed form from the horizon, the operation
+* windows and the grid sizes. The bytes of each array of MDPV are found from its shape: nested vectors hold a
+* vector object for each element of the outer levels and each vector is a separate heap block (glibc malloc: 8 byte
+* header, 16 byte alignment, min 32 bytes and whole pages above 128 kB). Strings of the optimal actions fit in the
+* string object (no heap block).
+*
+* The solve time is found by a probe: the trans pr tables of the model are calculated (timed) and the kernel of
+* each precision (Expect and ExpectReduced) is run on a sample of parent states of one slice of the value function.
+* The time of a kernel update (a successor of ExpectSW) is then multiplied by the number of updates of a solve,
+* found from the supports of the kernel rows (the same for all precisions). Action elimination is ignored, i.e. the
+* estimate is an upper bound.
+*
+* @author Reza Pourmoayed
+*/
+class FootprintPlanner
+{
+  public:
+
+    /** Constructor (no tables are calculated).
+    *
+    * @param param Model parameters (see \code{setParam} in R).
+    */
+    FootprintPlanner(const ModelParam & param);
+
+
+    /** Constructor using the horizon, operations and grids of a model. */
+    FootprintPlanner(const MDPV & model);
+
+
+    /** Number of states (t, op, d and grid) of the model. */
+    double States() const;
+
+
+    /** Number of expectations calculated when solving the model (one per action with successors). */
+    double Expectations() const;
+
+
+    /** Bytes of the arrays of a single process solve using a storage precision. */
+    double Bytes(MDPV::Precision mode) const;
+
+
+    /** Bytes of the trans pr and reward tables (a model without a value function, e.g. the donor of Ensemble). */
+    double TableBytes(MDPV::Precision mode) const;
+
+
+    /** Max bytes of a worker of a distributed solve (see DistSolver). The iMW slices referenced by a worker are
+    * found from the supports of the MW kernel rows if probed, otherwise all slices are assumed.
+    */
+    double WorkerBytes(int workers) const;
+
+
+    /** Bytes of the coordinator of a distributed solve (see DistSolver). It holds the tables, the stage being
+    * relayed and the packed stages queued for the policy files (see PolicyWriter).
+    */
+    double CoordinatorBytes() const;
+
+
+    /** Calculate the tables of the model and time the kernel (see the class description).
+    *
+    * @param model A model with the same parameters (its tables are calculated, the value function is not allocated).
+    * @param rows Number of parent states in the sample.
+    */
+    void Probe(MDPV & model, int rows = 1000);
+
+
+    /** Find the counts, the bytes of each table and recommend a storage precision and number of workers.
+    *
+    * The candidates are a single process in each precision and a distributed solve with 2 to cores local workers
+    * (coordinator plus workers on the node, double precision, the kernel time divided by the workers). The
+    * coordinator only holds a single stage of the value function (see CoordinatorBytes). The
+    * fastest candidate within the budget is recommended (the smallest if not probed). If no candidate fits the
+    * smallest is recommended and fits is false.
+    *
+    * @param budget Memory budget in bytes (0 = no limit).
+    * @param cores Number of cores of the node.
+    */
+    FootprintReport Plan(double budget = 0, int cores = 1) const;
+
+
+  private:
+
+    /** The tables of a single process solve. */
+    vector<FootprintReport::Table> Tables() const;
+
+    /** Estimated solve time (-1 if not probed). */
+    double Seconds(MDPV::Precision mode, int workers = 1) const;
+
+    /** Max number of (op,d) slices of a stage. */
+    int StageSlices() const;
+
+    int tMax, opNum, opDMax;
+    vector<double> opE, opL, opD;
+    int sizeSMW, sizeSSW, sizeSMP, sizeSSP, sizeST, sizeSP;
+    double slicesExp;                  // expectations per grid state summed over the (t,op,d) slices
+    bool probed;
+    double ns[3];                      // time of a kernel update under each precision (ns)
+    double preprocess;                 // time of the tables (s)
+    double updates;                    // kernel updates of a double precision solve
+    double visited;                    // successors in the support of the kernel summed over the parent states
+    vector<int> refLo, refHi;          // first and last+1 iMW successor of the rows of each iMW parent
+};
+
+
+#endif
@@ -0,0 +1,186 @@
+#include "forecast.h"
+#include "parallel.h"
+#include "trace.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <thread>
+
+// ===================================================
+
+ForecastMDP::ForecastMDP(MDPV & model, int days, ostream & out) : m(model), out(out), k(days), threads(1), act(NULL) {
+  if (k<1) throw runtime_error("The forecast window must have at least one day");
+  sizeW = m.sizeST*m.sizeSP;
+  sizeS = (long long)m.sizeSMW*m.sizeSSW*m.sizeSMP*m.sizeSSP;
+  slabs = m.opNum*(m.opDMax+1);
+  sizeF = 1;
+  for(int i=0; i<k; i++){
+    sizeF *= sizeW;
+    if ((double)sizeF*sizeS*slabs>1e10) throw runtime_error("The forecast window is too long for the grid");
+  }
+  sizeG = sizeS*sizeF;
+}
+
+// ===================================================
+
+double ForecastMDP::Solve(int nThreads, bool keepPolicy){
+  int t, op, d, iTt, iPt, iT, iP;
+
+  threads = nThreads;
+  if (threads<=0) threads = thread::hardware_concurrency();
+  if (threads<=0) threads = 1;
+  if (!m.preprocessed) m.Preprocess();
+  m.RestoreTables();   // released in reduced precision
+  m.InitFinalValues();
+  out << "Solve with a forecast window of " << k << " days: " << States() << " states per stage, "
+      << MemoryUse() << " MB, " << threads << " threads." << endl;
+
+  // the chain of a day
+  prW.resize(sizeW*sizeW);
+  for(iTt=0; iTt<m.sizeST; iTt++)
+    for(iPt=0; iPt<m.sizeSP; iPt++)
+      for(iT=0; iT<m.sizeST; iT++)
+        for(iP=0; iP<m.sizeSP; iP++)
+          prW[(iTt*m.sizeSP+iPt)*sizeW+iT*m.sizeSP+iP] = exp(m.prT[iTt][iPt][iT] + m.prP[iPt][iP]);
+
+  cur.assign(slabs*sizeG, 0);
+  next.assign(slabs*sizeG, 0);   // the value at stage tMax is zero
+  con.assign(slabs*sizeG, 0);
+  policy.assign(keepPolicy ? m.tMax : 0, vector<char>());
+  int t0 = (int)m.opE[0], d0 = (int)m.opD[0];
+  for(t=m.tMax-1; t>=t0; --t){
+    TRACE_SPAN_ARG("forecastStage", t);
+    fill(cur.begin(), cur.end(), 0.0);   // states not valid at stage t have value zero
+    m.CalcTransPrSW(t);   // before the threads read the rows
+    {
+      TRACE_SPAN_ARG("forecastContract", t+1);
+      ParallelFor(threads, slabs*sizeS*(sizeF/sizeW), [this, t](long long from, long long to) { Contract(t+1, from, to); });
+    }
+    act = NULL;
+    if (keepPolicy) {
+      policy[t].assign(slabs*sizeG, -1);
+      act = &policy[t];
+    }
+    for(op=0; op<m.opNum; op++){
+      for(d=1; d<=m.opD[op]; d++){
+        if(!m.ValidState(t,op,d)) continue;
+        ParallelFor(threads, sizeG, [this, t, op, d](long long from, long long to) { SolveStates(t, op, d, from, to); });
+      }
+    }
+    swap(cur, next);
+  }
+  const double* v = &next[d0*sizeG];   // op = 0
+  initial.assign(v, v+sizeG);
+  double mean = 0;
+  for(long long g=0; g<sizeG; g++) mean += v[g]/sizeG;
+  cur.clear();
+  next.clear();
+  con.clear();
+  return(mean);
+}
+
+// ===================================================
+
+void ForecastMDP::Contract(int t, long long rFrom, long long rTo){
+  long long r, sizeRow = sizeF/sizeW;   // rows are (op, d, s, w_2..w_k)
+  int w, wN;
+
+  for(r=rFrom; r<rTo; r++){
+    int slab = r/(sizeS*sizeRow);
+    double* c = &con[r*sizeW];
+    if (!m.ValidState(t, slab/(m.opDMax+1), slab%(m.opDMax+1))) {
+      for(w=0; w<sizeW; w++) c[w] = 0;
+      continue;
+    }
+    const double* v = &next[r*sizeW];   // the values of the new last day w'
+    for(w=0; w<sizeW; w++){
+      const double* p = &prW[w*sizeW];
+      double sum = 0;
+      for(wN=0; wN<sizeW; wN++) sum += p[wN]*v[wN];
+      c[w] = sum;
+    }
+  }
+}
+
+// ===================================================
+
+void ForecastMDP::SolveStates(int t, int op, int d, long long gFrom, long long gTo){
+  TRACE_SPAN_ARG("forecastStates", t);
+  int iMWt, iSWt, iMPt, iSPt, iTt, iPt;
+  int slabPos = op*(m.opDMax+1)+d, slabDo = -1;
+  if (d>1) slabDo = op*(m.opDMax+1)+d-1;
+  else if (op<m.opNum-1) slabDo = (op+1)*(m.opDMax+1)+(int)m.opD[op+1];
+  bool forced = (d==m.opL[op]-t);
+  long long sizeRow = sizeF/sizeW;
+
+  for(long long g=gFrom; g<gTo; g++){
+    long long s = g/sizeF, f = g%sizeF;
+    int w1 = f/sizeRow, wk = f%sizeW;
+    long long tail = f%sizeRow;   // w_2..w_k
+    iTt = w1/m.sizeSP;
+    iPt = w1%m.sizeSP;
+    iSPt = s % m.sizeSSP;
+    iMPt = (s/m.sizeSSP) % m.sizeSMP;
+    iSWt = (s/(m.sizeSSP*m.sizeSMP)) % m.sizeSSW;
+    iMWt = s/(m.sizeSSP*m.sizeSMP*m.sizeSSW);
+
+    // the expectation over the soil successors of the contracted values of slab (op, d) (the window is shifted)
+    MDPV::KernelRow row = m.Row(iMWt, iMPt, iSPt, iTt, iPt);
+    auto expect = [&](int slab) {
+      const double* c = &con[slab*sizeG+tail*sizeW+wk];
+      double sum = 0;
+      m.ForSoilSuccessors(row, t, iSWt, [&](int iMW, int iSW, int iMP, int iSP, double pr) {
+        long long sN = ((iMW*m.sizeSSW+iSW)*m.sizeSMP+iMP)*m.sizeSSP+iSP;
+        sum += pr*c[sN*sizeF];
+      });
+      return(sum);
+    };
+
+    double valueDo;
+    if (slabDo>=0) valueDo = m.rewDo[op][iMWt][iSWt] + expect(slabDo);
+    else {
+      int opt = op, dt = d;
+      valueDo = m.WeightDo(opt, dt, iMWt, iSWt, iMPt, iSPt, iTt, iPt, t);   // last operation finished
+    }
+    char a = 2;
+    double value = valueDo;
+    if (!forced) {
+      double valuePos = m.RewardPos() + expect(slabPos);
+      a = (valueDo>valuePos) ? 1 : 0;
+      value = max(valueDo, valuePos);
+    }
+    cur[slabPos*sizeG+g] = value;
+    if (act!=NULL) (*act)[slabPos*sizeG+g] = a;
+  }
+}
+
+// ===================================================
+
+long long ForecastMDP::Index(int iMW, int iSW, int iMP, int iSP, const vector<int> & iT, const vector<int> & iP) const {
+  if ( ((int)iT.size()!=k) || ((int)iP.size()!=k) ) return(-1);
+  if ( (iMW<0) || (iMW>=m.sizeSMW) || (iSW<0) || (iSW>=m.sizeSSW) || (iMP<0) || (iMP>=m.sizeSMP) ||
+       (iSP<0) || (iSP>=m.sizeSSP) ) return(-1);
+  long long g = ((iMW*m.sizeSSW+iSW)*m.sizeSMP+iMP)*m.sizeSSP+iSP;
+  for(int i=0; i<k; i++){
+    if ( (iT[i]<0) || (iT[i]>=m.sizeST) || (iP[i]<0) || (iP[i]>=m.sizeSP) ) return(-1);
+    g = g*sizeW + iT[i]*m.sizeSP+iP[i];
+  }
+  return(g);
+}
+
+// ===================================================
+
+double ForecastMDP::InitialValue(int iMW, int iSW, int iMP, int iSP, const vector<int> & iT, const vector<int> & iP) const {
+  long long g = Index(iMW, iSW, iMP, iSP, iT, iP);
+  if ( (g<0) || initial.empty() ) throw runtime_error("Not an initial state of a solved model");
+  return(initial[g]);
+}
+
+// ===================================================
+
+int ForecastMDP::Action(int t, int op, int d, int iMW, int iSW, int iMP, int iSP, const vector<int> & iT, const vector<int> & iP) const {
+  long long g = Index(iMW, iSW, iMP, iSP, iT, iP);
+  if ( (g<0) || (t<0) || (t>=(int)policy.size()) || (op<0) || (op>=m.opNum) || (d<0) || (d>m.opDMax) ) return(-1);
+  if (policy[t].empty()) return(-1);
+  return(policy[t][(op*(m.opDMax+1)+d)*sizeG+g]);
+}
@@ -0,0 +1,106 @@
+#ifndef FORECAST_HPP
+#define FORECAST_HPP
+
+#include <iostream>
+#include <vector>
+#include "mdp.h"
+
+using namespace std;
+
+// ===================================================
+
+/**
+* Solve a model where the weather state is a forecast window of k days (shift register).
+*
+* The weather state of the model, (iT,iP) of the day, is replaced by the window (w_1,...,w_k) of the discretized
+* temperature and precipitation of the day and the next k-1 days (w = iT*sizeSP+iP). The soil water factors of the
+* kernel depend on w_1 as in the model. At the next day the window is shifted, (w_2,...,w_k,w'), and only the new last
+* day w' is random with the trans pr prT and prP of the model given w_k, i.e. the transitions are stored as the chain
+* of one day (sizeST*sizeSP x sizeST*sizeSP) for any k. With k = 1 the model is solved.
+*
+* The expectation exploits the shift: at each stage the value function is contracted over w' once for each (soil
+* state, w_2..w_k, w_k), after which the expectation of a state only sums over the soil successors. The cost of a
+* stage is the number of states times the soil support plus the number of states times sizeST*sizeSP for the
+* contraction; the tables do not grow with k. The number of states grows with (sizeST*sizeSP)^k since each day of the
+* window is a state variable.
+*
+* The value function of two stages is stored in flat arrays [op][d][iMW][iSW][iMP][iSP][w_1]...[w_k].
+*
+* @author Reza Pourmoayed
+*/
+class ForecastMDP
+{
+  public:
+
+    /** Constructor.
+    *
+    * @param model The model (rewards, trans pr and grids). The rewards and trans pr are calculated if needed.
+    * @param days Number of days in the forecast window (k >= 1).
+    * @param out Stream used for log output.
+    */
+    ForecastMDP(MDPV & model, int days, ostream & out = cout);
+
+
+    /** Solve the model using backward induction.
+    *
+    * @param threads Number of threads used (0 = number of cores).
+    * @param keepPolicy Store the optimal actions of all stages (one byte per state, see Action).
+    *
+    * @return The mean value of the initial states, i.e. the states at day opE of the first operation with opD days
+    *   left (see InitialValue).
+    */
+    double Solve(int threads = 1, bool keepPolicy = false);
+
+
+    /** The value of an initial state.
+    *
+    * @param iT, iP The temperature and precipitation indexes of the k days in the window.
+    */
+    double InitialValue(int iMW, int iSW, int iMP, int iSP, const vector<int> & iT, const vector<int> & iP) const;
+
+
+    /** The optimal action (0 = pos., 1 = do., 2 = doF.) of a state at day t with operation op and d remaining days
+    * (Solve must be called with keepPolicy). Returns -1 if the state is not a state of the model.
+    */
+    int Action(int t, int op, int d, int iMW, int iSW, int iMP, int iSP, const vector<int> & iT, const vector<int> & iP) const;
+
+
+    /** Number of states at a stage. */
+    double States() const {return((double)slabs*sizeG);}
+
+
+    /** Memory used by the value function and the contracted values (MB). */
+    double MemoryUse() const {return(3.0*slabs*sizeG*sizeof(double)/1048576);}
+
+
+  private:
+
+    /** Index of (iMW, iSW, iMP, iSP, window) in a slab (-1 if outside the grid). */
+    long long Index(int iMW, int iSW, int iMP, int iSP, const vector<int> & iT, const vector<int> & iP) const;
+
+    /** Contract the values of stage t (next) over the new last day of the window for the rows in [rFrom, rTo). */
+    void Contract(int t, long long rFrom, long long rTo);
+
+    /** Find the optimal action and value of the states with index in [gFrom, gTo) for operation op and d remaining days at day t. */
+    void SolveStates(int t, int op, int d, long long gFrom, long long gTo);
+
+    MDPV & m;
+    ostream & out;
+    int k;                             // days in the window
+    int sizeW;                         // weather states of a day (sizeST*sizeSP)
+    long long sizeS;                   // soil states (iMW, iSW, iMP, iSP)
+    long long sizeF;                   // windows (sizeW^k)
+    long long sizeG;                   // states of a slab (sizeS*sizeF)
+    int slabs;                         // number of (op, d)
+    int threads;
+    vector<double> prW;                // trans pr of the weather of a day [w][w']
+    vector<double> cur;                // value at the current stage [op][d][s][window]
+    vector<double> next;               // value at the next stage
+    vector<double> con;                // next contracted over its last day w' given the day before [op][d][s][w_1..w_k-1][w]
+    vector<double> initial;            // value of the initial states [s][window]
+    vector< vector<char> > policy;     // optimal actions [t][op][d][s][window] (if kept)
+    vector<char> * act;                // actions of the current stage (NULL if not kept)
+};
+
+
+#endif
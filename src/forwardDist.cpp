@@ -0,0 +1,91 @@
+#include "forwardDist.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <unordered_map>
+
+// ===================================================
+
+ForwardDist::ForwardDist(MDPV & model) : m(model), remaining(0), maxStates(0) {
+  sizeG = m.sizeSMW*m.sizeSSW*m.sizeSMP*m.sizeSSP*m.sizeST*m.sizeSP;
+}
+
+// ===================================================
+
+void ForwardDist::Propagate(const vector<int> & grid, const vector<double> & pr){
+  if (m.valueFun.empty() || m.tFirstSolved>1) throw runtime_error("The model must be solved before propagating a distribution");
+  if (grid.size()!=pr.size()) throw runtime_error("The initial states and probabilities must have the same length");
+  int t, op, d, g, a, k;
+  int iMWt, iSWt, iMPt, iSPt, iTt, iPt;
+  int t0 = (int)m.opE[0];
+  m.RestoreTables();   // released in reduced precision
+
+  completion.assign(m.tMax+1, 0);
+  actionPr.assign(m.tMax+1, vector<double>(3, 0));
+  soilWater.assign(m.opNum, vector<double>(m.sizeSMW, 0));
+  remaining = 0;
+  maxStates = 0;
+
+  // the states with positive mass at the current stage (index (op*(opDMax+1)+d)*sizeG+g) and the mass of the next stage
+  vector< pair<int,double> > cur;
+  unordered_map<int,double> acc;
+  for(size_t i=0; i<grid.size(); i++){
+    if ( (grid[i]<0) || (grid[i]>=sizeG) ) throw runtime_error("Initial state outside the grid");
+    if (pr[i]>0) cur.push_back(make_pair((int)m.opD[0]*sizeG+grid[i], pr[i]));
+  }
+
+  for(t=t0; t<m.tMax && !cur.empty(); t++){
+    maxStates = max(maxStates, (int)cur.size());
+    m.CalcTransPrSW(t);
+    for(k=0; k<(int)cur.size(); k++){
+      int slab = cur[k].first/sizeG;
+      double mass = cur[k].second;
+      op = slab/(m.opDMax+1);
+      d = slab%(m.opDMax+1);
+      g = cur[k].first%sizeG;
+      if (!m.ValidState(t,op,d)) {
+        remaining += mass;
+        continue;
+      }
+      iPt = g % m.sizeSP;
+      iTt = (g/m.sizeSP) % m.sizeST;
+      iSPt = (g/(m.sizeSP*m.sizeST)) % m.sizeSSP;
+      iMPt = (g/(m.sizeSP*m.sizeST*m.sizeSSP)) % m.sizeSMP;
+      iSWt = (g/(m.sizeSP*m.sizeST*m.sizeSSP*m.sizeSMP)) % m.sizeSSW;
+      iMWt = g/(m.sizeSP*m.sizeST*m.sizeSSP*m.sizeSMP*m.sizeSSW);
+
+      a = MDPV::actionCode(m.optAction[t][op][d][iMWt][iSWt][iMPt][iSPt][iTt][iPt]);
+      actionPr[t][a] += mass;
+      int slabN = slab;
+      if (a>0) {
+        soilWater[op][iMWt] += mass;
+        if (d>1) slabN = op*(m.opDMax+1)+d-1;
+        else if (op<m.opNum-1) slabN = (op+1)*(m.opDMax+1)+(int)m.opD[op+1];
+        else {
+          completion[t] += mass;   // the last operation is finished
+          continue;
+        }
+      }
+
+      // push the mass through the kernel
+      MDPV::KernelRow row = m.Row(iMWt, iMPt, iSPt, iTt, iPt);
+      double rowSum = m.rowSumMW[row.rowMW]*m.rowSumSW[t*m.sizeSSW+iSWt]*m.rowSumMP[row.rowMW]*m.rowSumSP[row.rowSP]*
+        m.rowSumT[row.rowTP]*m.rowSumP[iPt];
+      double scale = mass/rowSum;
+      int next = slabN*sizeG;
+      const vector<double> & pSW = m.prSW[t][iSWt];
+      m.ForSuccessors(row, [&](int iMW, int iMP, int iSP, int iT, int iP, double pr4) {
+        for(int iSW=0; iSW<m.sizeSSW; iSW++){
+          double pr = pr4*exp(pSW[iSW]);
+          if (pr>0) acc[next+((((iMW*m.sizeSSW+iSW)*m.sizeSMP+iMP)*m.sizeSSP+iSP)*m.sizeST+iT)*m.sizeSP+iP] += scale*pr;
+        }
+      });
+    }
+
+    // the sparse state vector of the next stage (sorted by index)
+    cur.assign(acc.begin(), acc.end());
+    sort(cur.begin(), cur.end());
+    acc.clear();
+  }
+  for(k=0; k<(int)cur.size(); k++) remaining += cur[k].second;
+}
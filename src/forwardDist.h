@@ -0,0 +1,78 @@
+#ifndef FORWARDDIST_HPP
+#define FORWARDDIST_HPP
+
+#include <iostream>
+#include <vector>
+#include "mdp.h"
+
+using namespace std;
+
+// ===================================================
+
+/**
+* Exact state distribution under the optimal policy (forward Chapman-Kolmogorov equations).
+*
+* Starting from a distribution over the states at day opE of the first operation, the probability mass is pushed
+* through the factored transition kernel stage by stage using the optimal actions of a solved model. Only states
+* with positive mass are stored: the states of a stage are a sorted vector of (index, mass) pairs and the mass of
+* the next stage is accumulated in a hash map, i.e. the memory is proportional to the number of reachable states
+* (not the grid). The trans pr of each state are divided by the row sum of the
+* kernel so the mass is preserved (the kernel may be truncated, see MDPV::setTruncation).
+*
+* The results are exact marginals: the distribution of the day the last operation is finished, the probability
+* of each action at each day and the distribution of the mean soil water content (iMW) at the days each operation
+* is done.
+*
+* @author Reza Pourmoayed
+*/
+class ForwardDist
+{
+  public:
+
+    /** Constructor.
+    *
+    * @param model A solved model.
+    */
+    ForwardDist(MDPV & model);
+
+
+    /** Propagate an initial distribution.
+    *
+    * @param grid The initial states (operation 0 with opD days left at day opE) given by the flat index of
+    *   (iMW, iSW, iMP, iSP, iT, iP), i.e. ((((iMW*sizeSSW+iSW)*sizeSMP+iMP)*sizeSSP+iSP)*sizeST+iT)*sizeSP+iP.
+    * @param pr The probability of each initial state.
+    */
+    void Propagate(const vector<int> & grid, const vector<double> & pr);
+
+
+    /** Probability that the last operation is finished at day t (index t). */
+    const vector<double> & Completion() const {return(completion);}
+
+    /** Probability of each action (0 = pos., 1 = do., 2 = doF.) at day t [t][action]. */
+    const vector< vector<double> > & ActionPr() const {return(actionPr);}
+
+    /** Probability that operation op is done at a day with mean soil water content in interval iMW [op][iMW]. The
+    * probabilities of an operation sum to the expected number of days the operation is done.
+    */
+    const vector< vector<double> > & SoilWater() const {return(soilWater);}
+
+    /** Mass not finished at tMax or in states without a policy. */
+    double Remaining() const {return(remaining);}
+
+    /** Max number of states with positive mass at a stage. */
+    int MaxStates() const {return(maxStates);}
+
+
+  private:
+
+    MDPV & m;
+    int sizeG;                               // number of grid states (iMW, iSW, iMP, iSP, iT, iP)
+    vector<double> completion;
+    vector< vector<double> > actionPr;
+    vector< vector<double> > soilWater;
+    double remaining;
+    int maxStates;
+};
+
+
+#endif
@@ -1,85 +1,123 @@
 #include "mdp.h"
+#include "footprint.h"
+#include "parallel.h"
+#include "policyWriter.h"
+#include "trace.h"
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
 
 // ===================================================
 
-const double MDPV::ZERO = 1e-10; //4.656613e-10;   // equal 1/2147483647 (limit of int since trans pr is stored as int when build the hgf)
-
-// ===================================================
-
-MDPV::MDPV(const List paramModel){
-
-  List rParam(paramModel);       // Get parameters in params
-  opNum=as<int>(rParam["opNum"]);
-  tMax=as<int>(rParam["tMax"]);
-  opSeq=as<arma::vec>(rParam["opSeq"]);
-  opE=as<arma::vec>(rParam["opE"]);
-  opL=as<arma::vec>(rParam["opL"]);
-  opD=as<arma::vec>(rParam["opD"]);
-  opDelay=as<arma::vec>(rParam["opDelay"]);
-  opFixCost=as<arma::vec>(rParam["opFixCost"]);
-  watTh=as<arma::vec>(rParam["watTh"]);
-  coefLoss=as<double>(rParam["coefLoss"]);
-  priceYield=as<double>(rParam["priceYield"]);
-  machCap=as<double>(rParam["machCap"]);
-  yieldHa=as<double>(rParam["yieldHa"]);
-  fieldArea=as<double>(rParam["fieldArea"]);
-  coefTimeliness=as<double>(rParam["coefTimeliness"]);
-  costSkip=as<double>(rParam["costSkip"]);
-
-  watUpper=as<arma::vec>(rParam["watUpper"]);
-  watLower=as<arma::vec>(rParam["watLower"]);
-  stress=as<arma::vec>(rParam["stress"]);
-  strength=as<arma::vec>(rParam["strength"]);
-  weightCompletion=as<double>(rParam["weightCompletion"]);
-  weightWorkable=as<double>(rParam["weightWorkable"]);
-  weightTraffic=as<double>(rParam["weightTraffic"]);
-  minOpt=as<int>(rParam["minOpt"]);
-  maxOpt=as<int>(rParam["maxOpt"]);
-
-  temMeanDry=as<double>(rParam["temMeanDry"]);
-  temMeanWet=as<double>(rParam["temMeanWet"]);
-  temVarDry=as<double>(rParam["temVarDry"]);
-  temVarWet=as<double>(rParam["temVarWet"]);
-  dryDayTh=as<double>(rParam["dryDayTh"]);
-  precShape=as<double>(rParam["precShape"]);
-  precScale=as<double>(rParam["precScale"]);
-  prDryWet=as<double>(rParam["prDryWet"]);
-  prWetWet=as<double>(rParam["prWetWet"]);
-
-  hydroWatR=as<double>(rParam["hydroWatR"]);
-  hydroWatS=as<double>(rParam["hydroWatS"]);
-  hydroM=as<double>(rParam["hydroM"]);
-  hydroKs=as<double>(rParam["hydroKs"]);
-  hydroFi=as<double>(rParam["hydroFi"]);
-  hydroLamba=as<double>(rParam["hydroLamba"]);
-  hydroETa=as<double>(rParam["hydroETa"]);
-  hydroETb=as<double>(rParam["hydroETb"]);
-  hydroETx=as<double>(rParam["hydroETx"]);
-
-  gSSMW=as<double>(rParam["gSSMW"]);
-  gSSMV=as<double>(rParam["gSSMV"]);
-  gSSMm0=as<double>(rParam["gSSMm0"]);
-  gSSMc0=as<double>(rParam["gSSMc0"]);
-  nGSSMm0=as<double>(rParam["nGSSMm0"]);
-  nGSSMc0=as<double>(rParam["nGSSMc0"]);
-  nGSSMK=as<double>(rParam["nGSSMK"]);
-
-  check = as<bool>(rParam["check"]);
-  rewRisk = as<bool>(rParam["rewRisk"]);
-
-  dMP = as<arma::mat>(rParam["disMeanPos"]);
-  dSP = as<arma::mat>(rParam["disSdPos"]);
-  dMW = as<arma::mat>(rParam["disAvgWat"]);
-  dSW = as<arma::mat>(rParam["disSdWat"]);
-  dT = as<arma::mat>(rParam["disTem"]);
-  dP = as<arma::mat>(rParam["disPre"]);
-
-  sMP = as<arma::vec>(rParam["centerPointsMeanPos"]);
-  sSP = as<arma::vec>(rParam["centerPointsSdPos"]);
-  sMW = as<arma::vec>(rParam["centerPointsAvgWat"]);
-  sSW = as<arma::vec>(rParam["centerPointsSdWat"]);
-  sT = as<arma::vec>(rParam["centerPointsTem"]);
-  sP = as<arma::vec>(rParam["centerPointsPre"]);
+
+// ===================================================
+
+MDPV::MDPV(const ModelParam & paramModel, ostream & out) : out(out) {
+  checkpointFile = "";
+  resume = false;
+  exportBin = exportCsv = "";
+  stageCallback = NULL;
+  precision = PREC_DOUBLE;
+  weatherStage = -1;
+  truncEps = 0;
+  for(int g=0; g<TAB_GROUPS; g++) tableHash[g] = 0;
+  elimination = true;
+  boundStage = -1;
+  eliminated = 0;
+  keySW[0] = keySW[1] = -1;
+  nextSW = 0;
+  sampleN = 0;
+  sampleSeed = 1;
+  sampleKey = -1;
+  sampleSlot = 0;
+  lazyPrune = 0;
+  SetParameters(paramModel);
+  Allocate();
+  tFirstSolved = tMax;
+  solvedSettings = 0;
+}
+
+// ===================================================
+
+void MDPV::SetParameters(const ModelParam & paramModel){
+
+  const ModelParam & rParam(paramModel);       // Get parameters in params
+  opNum=rParam.opNum;
+  tMax=rParam.tMax;
+  opSeq=rParam.opSeq;
+  opE=rParam.opE;
+  opL=rParam.opL;
+  opD=rParam.opD;
+  opDelay=rParam.opDelay;
+  opFixCost=rParam.opFixCost;
+  watTh=rParam.watTh;
+  coefLoss=rParam.coefLoss;
+  priceYield=rParam.priceYield;
+  machCap=rParam.machCap;
+  yieldHa=rParam.yieldHa;
+  fieldArea=rParam.fieldArea;
+  coefTimeliness=rParam.coefTimeliness;
+  costSkip=rParam.costSkip;
+
+  watUpper=rParam.watUpper;
+  watLower=rParam.watLower;
+  stress=rParam.stress;
+  strength=rParam.strength;
+  weightCompletion=rParam.weightCompletion;
+  weightWorkable=rParam.weightWorkable;
+  weightTraffic=rParam.weightTraffic;
+  minOpt=rParam.minOpt;
+  maxOpt=rParam.maxOpt;
+
+  temMeanDry=rParam.temMeanDry;
+  temMeanWet=rParam.temMeanWet;
+  temVarDry=rParam.temVarDry;
+  temVarWet=rParam.temVarWet;
+  dryDayTh=rParam.dryDayTh;
+  precShape=rParam.precShape;
+  precScale=rParam.precScale;
+  prDryWet=rParam.prDryWet;
+  prWetWet=rParam.prWetWet;
+
+  hydroWatR=rParam.hydroWatR;
+  hydroWatS=rParam.hydroWatS;
+  hydroM=rParam.hydroM;
+  hydroKs=rParam.hydroKs;
+  hydroFi=rParam.hydroFi;
+  hydroLamba=rParam.hydroLamba;
+  hydroETa=rParam.hydroETa;
+  hydroETb=rParam.hydroETb;
+  hydroETx=rParam.hydroETx;
+
+  gSSMW=rParam.gSSMW;
+  gSSMV=rParam.gSSMV;
+  gSSMm0=rParam.gSSMm0;
+  gSSMc0=rParam.gSSMc0;
+  nGSSMm0=rParam.nGSSMm0;
+  nGSSMc0=rParam.nGSSMc0;
+  nGSSMK=rParam.nGSSMK;
+
+  check = rParam.check;
+  rewRisk = rParam.rewRisk;
+
+  dMP = rParam.disMeanPos;
+  dSP = rParam.disSdPos;
+  dMW = rParam.disAvgWat;
+  dSW = rParam.disSdWat;
+  dT = rParam.disTem;
+  dP = rParam.disPre;
+
+  modelHash = rParam.hash();
+
+  sMP = rParam.centerPointsMeanPos;
+  sSP = rParam.centerPointsSdPos;
+  sMW = rParam.centerPointsAvgWat;
+  sSW = rParam.centerPointsSdWat;
+  sT = rParam.centerPointsTem;
+  sP = rParam.centerPointsPre;
 
   sizeSMP = sMP.size();
   sizeSSP = sSP.size();
@@ -87,8 +125,20 @@ MDPV::MDPV(const List paramModel){
   sizeSSW = sSW.size();
   sizeST = sT.size();
   sizeSP = sP.size();
+  opDMax = *max_element(opD.begin(), opD.end());
 
-  // matrices for filling the rewards and transition probabilities before running the HMDP:
+  preprocessed = false;
+  for(int g=0; g<TAB_GROUPS; g++){   // only the tables of groups with changed parameters are recalculated
+    unsigned long long h = rParam.hashTables((TableGroup)g);
+    if(h!=tableHash[g]) tablesReady[g] = false;
+    tableHash[g] = h;
+  }
+  ClearLazy();
+}
+
+// ===================================================
+
+void MDPV::AllocateSoil(){
   prMW = vector <vector<vector< vector< vector< vector<double> > > > > >(sizeSMW,
          vector<vector< vector< vector< vector<double> > > > >(sizeSMP,
          vector<vector< vector< vector<double> > > >(sizeSSP,
@@ -102,6 +152,13 @@ MDPV::MDPV(const List paramModel){
          vector<vector< vector<double> > >(sizeST,
          vector<vector<double> > (sizeSP,
          vector <double>(sizeSMP) ) ) ) ) ); //prMP[iMWt][iMPt][iSPt][iTt][iPt][iMP]
+}
+
+// ===================================================
+
+void MDPV::Allocate(){
+  // matrices for filling the rewards and transition probabilities before running the HMDP:
+  AllocateSoil();
 
   prSP = vector<vector< vector< vector< vector<double> > > > >(sizeSMW,
          vector<vector< vector< vector<double> > > >(sizeSSP,
@@ -126,8 +183,22 @@ MDPV::MDPV(const List paramModel){
           vector<double>(sizeSSW) ) ); //rewDo[op][iMWt][iSWt]
 
 
-  int opDMax = arma::max(opD);
 
+  valFunDummy = vector<double>(tMax+1);
+  iMWFrom = 0;
+  iMWTo = sizeSMW;
+  for(int g=0; g<TAB_GROUPS; g++) { tablesReady[g] = false; tablesTrunc[g] = -1; }
+
+  // the value function and optimal actions are allocated when needed (see AllocateValues)
+  mapL1Vector.clear();
+  valueFun.clear();
+  optAction.clear();
+}
+
+// ===================================================
+
+void MDPV::AllocateValues(int iMWLo, int iMWHi){
+  if(iMWHi<0) iMWHi=sizeSMW;
   mapL1Vector = vector< vector< vector< vector< vector< vector< vector< vector<int> > > > > > > >(opNum,
                 vector< vector< vector< vector< vector< vector< vector<int> > > > > > >(opDMax+1,
                 vector< vector< vector< vector< vector< vector<int> > > > > >(sizeSMW,
@@ -137,127 +208,673 @@ MDPV::MDPV(const List paramModel){
                 vector< vector<int> >(sizeST,
                 vector <int>(sizeSP) ) ) ) ) ) ) ) ; //mapL1Vector[op][d][iMW][iSW][iMP][iSP][iT][iP];
 
+  // the iMW level is allocated first such that only the slices in [iMWLo, iMWHi) use memory
   valueFun =    vector< vector< vector< vector< vector< vector< vector< vector< vector<double> > > > > > > > >(tMax+1,
                 vector< vector< vector< vector< vector< vector< vector< vector<double> > > > > > > >(opNum,
                 vector< vector< vector< vector< vector< vector< vector<double> > > > > > >(opDMax+1,
-                vector< vector< vector< vector< vector< vector<double> > > > > >(sizeSMW,
-                vector< vector< vector< vector< vector<double> > > > >(sizeSSW,
-                vector< vector< vector< vector<double> > > >(sizeSMP,
-                vector< vector< vector<double> > >(sizeSSP,
-                vector< vector<double> >(sizeST,
-                vector <double>(sizeSP) ) ) ) ) ) ) ) ) ; //valueFun[t][op][d][iMW][iSW][iMP][iSP][iT][iP];
-
-  valFunDummy = vector<double>(tMax+1);
+                vector< vector< vector< vector< vector< vector<double> > > > > >(sizeSMW) ) ) ) ; //valueFun[t][op][d][iMW][iSW][iMP][iSP][iT][iP];
 
   optAction =   vector< vector< vector< vector< vector< vector< vector< vector< vector<string> > > > > > > > >(tMax+1,
                 vector< vector< vector< vector< vector< vector< vector< vector<string> > > > > > > >(opNum,
                 vector< vector< vector< vector< vector< vector< vector<string> > > > > > >(opDMax+1,
-                vector< vector< vector< vector< vector< vector<string> > > > > >(sizeSMW,
-                vector< vector< vector< vector< vector<string> > > > >(sizeSSW,
-                vector< vector< vector< vector<string> > > >(sizeSMP,
-                vector< vector< vector<string> > >(sizeSSP,
-                vector< vector<string> >(sizeST,
-                vector <string>(sizeSP) ) ) ) ) ) ) ) ) ; //optAction[t][op][d][iMW][iSW][iMP][iSP][iT][iP];
-
+                vector< vector< vector< vector< vector< vector<string> > > > > >(sizeSMW) ) ) ) ; //optAction[t][op][d][iMW][iSW][iMP][iSP][iT][iP];
+
+  for(int t=0; t<=tMax; t++)
+    for(int op=0; op<opNum; op++)
+      for(int d=0; d<=opDMax; d++)
+        for(int iMW=iMWLo; iMW<iMWHi; iMW++){
+          valueFun[t][op][d][iMW] = vector< vector< vector< vector< vector<double> > > > >(sizeSSW,
+                                    vector< vector< vector< vector<double> > > >(sizeSMP,
+                                    vector< vector< vector<double> > >(sizeSSP,
+                                    vector< vector<double> >(sizeST,
+                                    vector <double>(sizeSP) ) ) ) );
+          optAction[t][op][d][iMW] = vector< vector< vector< vector< vector<string> > > > >(sizeSSW,
+                                     vector< vector< vector< vector<string> > > >(sizeSMP,
+                                     vector< vector< vector<string> > >(sizeSSP,
+                                     vector< vector<string> >(sizeST,
+                                     vector <string>(sizeSP) ) ) ) );
+        }
 }
 
 // ===================================================
 
 void MDPV::Preprocess() {
-  Rcout << "Build the HMDP ... \n\nStart preprocessing ...\n"<<endl;
-  CalcTransPrMW();
-  CalcTransPrSW();
-  CalcTransPrMP();
-  CalcTransPrSP();
-  CalcTransPrT();
-  CalcTransPrP();
-  CalcRewaerdDo();
-  Rcout << "... finished preprocessing.\n";
+  TRACE_SPAN("preprocess");
+  out << "Build the HMDP ... \n\nStart preprocessing ...\n"<<endl;
+  const char * groups[TAB_GROUPS] = {"soil", "SW", "weather", "reward"};
+  out << "Tables calculated:";
+  for(int g=0; g<TAB_GROUPS; g++){
+    if(tablesReady[g]) continue;
+    calcTables((TableGroup)g);
+    out << " " << groups[g];
+  }
+  out << endl;
+  TableGroup kernel[2] = {TAB_SOIL, TAB_WEATHER};
+  for(int k=0; k<2; k++){
+    if(tablesTrunc[kernel[k]]==truncEps) continue;
+    if(tablesTrunc[kernel[k]]>0) calcTables(kernel[k]);   // truncated using another eps
+    TruncateTables(kernel[k]);
+  }
+  CalcSupport();
+  if(precision==PREC_FLOAT) CalcReduced(redF);
+  if(precision==PREC_Q16) CalcReduced(redQ);
+  if( (precision!=PREC_DOUBLE) && (sampleN==0) ) ReleaseTables();
+  weatherStage = -1;
+  boundStage = -1;
+  preprocessed = true;
+  out << "... finished preprocessing.\n";
+}
+
+// ===================================================
+
+void MDPV::calcTables(TableGroup g){
+  TRACE_SPAN_ARG("calcTables", g);
+  if(g==TAB_SOIL){
+    if(prMW.empty()) AllocateSoil();
+    CalcTransPrMW();
+    CalcTransPrMP();
+    CalcTransPrSP();
+  }
+  if(g==TAB_SW) CalcTransPrSW();
+  if(g==TAB_WEATHER){
+    CalcTransPrT();
+    CalcTransPrP();
+  }
+  if(g==TAB_REWARD) CalcRewaerdDo();
+  tablesReady[g] = true;
+  tablesTrunc[g] = -1;
+}
+
+// ===================================================
+
+void MDPV::copyTables(const MDPV & src, TableGroup g){
+  if(!src.tablesReady[g]) throw runtime_error("Cannot copy tables that have not been calculated");
+  if(g==TAB_SOIL){
+    prMW = src.prMW;
+    prMP = src.prMP;
+    prSP = src.prSP;
+    cutMW = src.cutMW; cutMP = src.cutMP; cutSP = src.cutSP;
+  }
+  if(g==TAB_SW){
+    prSW = src.prSW;
+    readySW = src.readySW;
+    rowSumSW = src.rowSumSW;
+  }
+  if(g==TAB_WEATHER){
+    prT = src.prT;
+    prP = src.prP;
+    cutT = src.cutT; cutP = src.cutP;
+  }
+  if(g==TAB_REWARD) rewDo = src.rewDo;
+  tablesReady[g] = true;
+  tablesTrunc[g] = src.tablesTrunc[g];
+}
+
+// ===================================================
+
+/** Remove the successors with the lowest trans pr from a row as long as the removed mass is at most eps.
+ *
+ * @param isLog True if the row holds log trans pr (removed successors get log trans pr -inf, otherwise 0).
+ *
+ * @return The removed mass.
+ */
+static double truncateRow(vector<double> & row, bool isLog, double eps){
+  vector< pair<double,int> > p;
+  for(size_t i=0; i<row.size(); i++){
+    double x = isLog ? exp(row[i]) : row[i];
+    if (x>0) p.push_back(make_pair(x, (int)i));
+  }
+  sort(p.begin(), p.end());
+  double cut=0;
+  for(size_t k=0; (k<p.size()) && (cut+p[k].first<=eps); k++){
+    cut += p[k].first;
+    row[p[k].second] = isLog ? -INFINITY : 0;
+  }
+  return(cut);
+}
+
+// ===================================================
+
+/** Store the first and last+1 successor with positive trans pr of a row in sup and return the row sum. */
+static double rowSupport(const vector<double> & row, bool isLog, int* sup){
+  double sum=0;
+  sup[0] = sup[1] = 0;
+  for(size_t i=0; i<row.size(); i++){
+    double x = isLog ? exp(row[i]) : row[i];
+    if (x<=0) continue;
+    if (sum==0) sup[0] = i;
+    sup[1] = i+1;
+    sum += x;
+  }
+  return(sum);
+}
+
+// ===================================================
+
+void MDPV::setTruncation(double eps){
+  if ( !(eps>=0) || (eps>=1) ) throw runtime_error("The truncated mass must be in [0,1)");
+  truncEps=eps;
+  preprocessed=false;
+  ClearLazy();
+}
+
+// ===================================================
+
+void MDPV::TruncateTables(TableGroup g){
+  TRACE_SPAN_ARG("truncate", g);
+  int iMWt, iMPt, iSPt, iTt, iPt;
+  double eps = truncEps/5;   // five factors are truncated
+
+  if(g==TAB_SOIL){
+    cutMW.clear(); cutMP.clear(); cutSP.clear();
+    for(iMWt=0; iMWt<sizeSMW; iMWt++)
+      for(iMPt=0; iMPt<sizeSMP; iMPt++)
+        for(iSPt=0; iSPt<sizeSSP; iSPt++)
+          for(iTt=0; iTt<sizeST; iTt++)
+            for(iPt=0; iPt<sizeSP; iPt++){
+              cutMW.push_back( truncateRow(prMW[iMWt][iMPt][iSPt][iTt][iPt], true, eps) );
+              cutMP.push_back( truncateRow(prMP[iMWt][iMPt][iSPt][iTt][iPt], true, eps) );
+            }
+    for(iMWt=0; iMWt<sizeSMW; iMWt++)
+      for(iSPt=0; iSPt<sizeSSP; iSPt++)
+        for(iTt=0; iTt<sizeST; iTt++)
+          for(iPt=0; iPt<sizeSP; iPt++) cutSP.push_back( truncateRow(prSP[iMWt][iSPt][iTt][iPt], false, eps) );
+  }
+  if(g==TAB_WEATHER){
+    cutT.clear(); cutP.clear();
+    for(iTt=0; iTt<sizeST; iTt++)
+      for(iPt=0; iPt<sizeSP; iPt++) cutT.push_back( truncateRow(prT[iTt][iPt], true, eps) );
+    for(iPt=0; iPt<sizeSP; iPt++) cutP.push_back( truncateRow(prP[iPt], true, eps) );
+  }
+  tablesTrunc[g] = truncEps;
+}
+
+// ===================================================
+
+void MDPV::CalcSupport(){
+  TRACE_SPAN("support");
+  int iMWt, iMPt, iSPt, iTt, iPt, i;
+  int rowsMW = sizeSMW*sizeSMP*sizeSSP*sizeST*sizeSP;
+  int rowsSP = sizeSMW*sizeSSP*sizeST*sizeSP;
+  vector<double> & sumMW = rowSumMW, & sumMP = rowSumMP, & sumSP = rowSumSP, & sumT = rowSumT, & sumP = rowSumP;
+
+  sumMW.resize(rowsMW); sumMP.resize(rowsMW); sumSP.resize(rowsSP); sumT.resize(sizeST*sizeSP); sumP.resize(sizeSP);
+  supMW.resize(2*rowsMW); supMP.resize(2*rowsMW); supSP.resize(2*rowsSP);
+  supT.resize(2*sizeST*sizeSP); supP.resize(2*sizeSP);
+  for(iMWt=0, i=0; iMWt<sizeSMW; iMWt++)
+    for(iMPt=0; iMPt<sizeSMP; iMPt++)
+      for(iSPt=0; iSPt<sizeSSP; iSPt++)
+        for(iTt=0; iTt<sizeST; iTt++)
+          for(iPt=0; iPt<sizeSP; iPt++, i++){
+            sumMW[i] = rowSupport(prMW[iMWt][iMPt][iSPt][iTt][iPt], true, &supMW[2*i]);
+            sumMP[i] = rowSupport(prMP[iMWt][iMPt][iSPt][iTt][iPt], true, &supMP[2*i]);
+          }
+  for(iMWt=0, i=0; iMWt<sizeSMW; iMWt++)
+    for(iSPt=0; iSPt<sizeSSP; iSPt++)
+      for(iTt=0; iTt<sizeST; iTt++)
+        for(iPt=0; iPt<sizeSP; iPt++, i++) sumSP[i] = rowSupport(prSP[iMWt][iSPt][iTt][iPt], false, &supSP[2*i]);
+  for(iTt=0, i=0; iTt<sizeST; iTt++)
+    for(iPt=0; iPt<sizeSP; iPt++, i++) sumT[i] = rowSupport(prT[iTt][iPt], true, &supT[2*i]);
+  for(iPt=0; iPt<sizeSP; iPt++) sumP[iPt] = rowSupport(prP[iPt], true, &supP[2*iPt]);
+
+  // max removed mass and row sum over the parent states (the SW factor is not truncated and only depends on t)
+  double maxCut=0, maxSum=0, visited=0;
+  for(iMWt=0, i=0; iMWt<sizeSMW; iMWt++)
+    for(iMPt=0; iMPt<sizeSMP; iMPt++)
+      for(iSPt=0; iSPt<sizeSSP; iSPt++)
+        for(iTt=0; iTt<sizeST; iTt++)
+          for(iPt=0; iPt<sizeSP; iPt++, i++){
+            int iS = ((iMWt*sizeSSP+iSPt)*sizeST+iTt)*sizeSP+iPt, iTP = iTt*sizeSP+iPt;
+            double f[5] = {sumMW[i], sumMP[i], sumSP[iS], sumT[iTP], sumP[iPt]};
+            double c[5] = {cutMW[i], cutMP[i], cutSP[iS], cutT[iTP], cutP[iPt]};
+            double pr=1, cut=0;   // product of the truncated row sums and the removed mass (no cancellation)
+            for(int k=0; k<5; k++){
+              cut = cut*(f[k]+c[k]) + pr*c[k];
+              pr *= f[k];
+            }
+            maxCut = max(maxCut, cut);
+            maxSum = max(maxSum, pr);
+            visited += (double)(supMW[2*i+1]-supMW[2*i])*(supMP[2*i+1]-supMP[2*i])*(supSP[2*iS+1]-supSP[2*iS])*
+              (supT[2*iTP+1]-supT[2*iTP])*(supP[2*iPt+1]-supP[2*iPt]);
+          }
+  kernelCut = maxCut;
+  kernelSum = maxSum;
+  if(truncEps>0) out << "Kernel truncated (eps " << truncEps << "): max mass removed from a row " << maxCut <<
+    ", successors visited " << 100*visited/((double)rowsMW*rowsMW) << "% of the grid" << endl;
+}
+
+// ===================================================
+
+void MDPV::CalcErrorBound(const vector<double> * maxValue){
+  int t, op, d, iMW, iSW, iMP, iSP, iT, iP;
+
+  errBound.assign(tMax+1, 0);
+  if(truncEps==0) return;
+  for(t=tMax-1; t>=1; t--){
+    double m=0;   // max absolute value at stage t+1
+    if(maxValue!=NULL) m=(*maxValue)[t+1];
+    else for(op=0; op<opNum; op++)
+      for(d=0; d<=opDMax; d++)
+        for(iMW=0; iMW<sizeSMW; iMW++)
+          for(iSW=0; iSW<sizeSSW; iSW++)
+            for(iMP=0; iMP<sizeSMP; iMP++)
+              for(iSP=0; iSP<sizeSSP; iSP++)
+                for(iT=0; iT<sizeST; iT++)
+                  for(iP=0; iP<sizeSP; iP++) m = max(m, fabs(valueFun[t+1][op][d][iMW][iSW][iMP][iSP][iT][iP]));
+    double maxSW=0;   // the SW factor only depends on t
+    CalcTransPrSW(t);
+    for(iSW=0; iSW<sizeSSW; iSW++) maxSW = max(maxSW, rowSumSW[t*sizeSSW+iSW]);
+    errBound[t] = (maxSW*kernelSum)*errBound[t+1] + (maxSW*kernelCut)*(m+errBound[t+1]);
+  }
+}
+
+// ===================================================
+
+double MDPV::memoryUse(){
+  return( FootprintPlanner(*this).Bytes(precision) );
 }
 
 
 
 // ===================================================
-SEXP MDPV::SolveMDP(){
+double MDPV::SolveMDP(){
+  if(valueFun.empty()) AllocateValues();
   Preprocess();
-  int t, op, iMW, iSW, iMP, iSP, iT, iP, d;
-  double valueDo, valuePos;
+  if(check) Validate().print(out);
+  int t;
 
   int counter=0;
+  int tStart=tMax;   // stages t>=tStart have already been solved (loaded from checkpoint file)
+  eliminated=0;
+  sampled=SampleStats();
+
+  if(!checkpointFile.empty()){
+    if(resume) tStart=readCheckpoint();
+    initCheckpoint(tStart);
+  }
+  PolicyWriter writer(*this, exportBin, exportCsv);
+  vector<double> vals;
+  vector<char> acts;
 
   for(t=tMax; t>=1; --t){
     if(t==tMax){
       if (rewRisk) valFunDummy[tMax]=0; else valFunDummy[tMax]=priceYield*yieldHa*fieldArea;
       continue;
       }
-    Rcout<<" day: "<<t<<endl;
+    valFunDummy[t]=0+valFunDummy[t+1]; //IS IT TRUE?
+    if(t<tStart){
+      TRACE_SPAN_ARG("stage", t);
+      out<<" day: "<<t<<endl;
+      counter += SolveStage(t);
+      if(!checkpointFile.empty()) writeCheckpointStage(t);
+    }
+    if(writer.Active()){   // the stage is final
+      getStage(t, vals, acts);
+      writer.Push(t, vals, acts);
+    }
+    if( (t<tStart) && (stageCallback!=NULL) ) stageCallback(t);
+  }
+  writer.Finish();
+  tFirstSolved=1;
+  solvedSettings=settingsTag();
+  out<<" Number of actions: "<< counter << endl;
+  if(elimination && (sampleN==0)) out<<" Actions eliminated by bounds: "<< eliminated << endl;
+  if(sampleN>0) out<<" Sampled expectations: "<< sampled.expectations << " (" << sampleN << " samples, mean standard error "
+                   << sampled.meanSe() << "), decisions within 1.96 standard errors: " << sampled.close << " of " << sampled.decisions << endl;
+  CalcErrorBound();
+  if(truncEps>0) out << " Bound on the value function error at day 1: " << errBound[1] << endl;
+  totalRew=weightIni();
+  return(totalRew);
+
+}
+
+
+// ===================================================
+
+double MDPV::ResolveMDP(const ModelParam & paramModel, int tStart){
+  int t, op, d;
+  int counter=0;
+  bool allDirty;
+
+  if(tStart<1) tStart=1;
+  eliminated=0;
+  sampled=SampleStats();
+  bool newStructure = (paramModel.tMax!=tMax) || (paramModel.opNum!=opNum) || (paramModel.opE!=opE) ||
+    (paramModel.opL!=opL) || (paramModel.opD!=opD) ||
+    ((int)paramModel.centerPointsAvgWat.size()!=sizeSMW) || ((int)paramModel.centerPointsSdWat.size()!=sizeSSW) ||
+    ((int)paramModel.centerPointsMeanPos.size()!=sizeSMP) || ((int)paramModel.centerPointsSdPos.size()!=sizeSSP) ||
+    ((int)paramModel.centerPointsTem.size()!=sizeST) || ((int)paramModel.centerPointsPre.size()!=sizeSP);
+
+  // store the stage inputs of the previous solve (the trans pr tables are compared by the hash of their parameters)
+  vector <vector< vector<double> > > rewDoOld;
+  vector<double> finalOld(tMax+1);
+  vector<unsigned long long> swOld(tMax+1, 0);   // hash of prSW[t] (0 = not calculated)
+  double rewPosOld = RewardPos();
+  unsigned long long soilOld = tableHash[TAB_SOIL], weatherOld = tableHash[TAB_WEATHER];
+  if(!newStructure){
+    rewDoOld=rewDo;
+    for(t=1; t<tMax; t++){
+      finalOld[t]=FinalReward(t+1);
+      if(readySW[t]) swOld[t]=hashSW(t);
+    }
+  }
+
+  SetParameters(paramModel);
+  if(newStructure){
+    out << "The structure of the model has changed. Solve all stages." << endl;
+    Allocate();
+    tFirstSolved=tMax;
+  }
+  if(valueFun.empty()) AllocateValues();
+  Preprocess();
+  InitFinalValues();
+
+  // find the stage inputs that have changed (other solve settings change all values)
+  bool settingsChanged = (solvedSettings!=settingsTag());
+  if(settingsChanged && !newStructure) out << "The solve settings have changed. Solve all stages." << endl;
+  bool kernelChanged = newStructure || settingsChanged || (tableHash[TAB_SOIL]!=soilOld) || (tableHash[TAB_WEATHER]!=weatherOld);
+  bool posChanged = kernelChanged || (RewardPos()!=rewPosOld);
+  vector<char> rewChanged(opNum);
+  for(op=0; op<opNum; op++) rewChanged[op] = kernelChanged || (rewDo[op]!=rewDoOld[op]);
+
+  // solve the states (op,d) at stage t if their rewards or trans pr have changed or they have a changed successor
+  vector< vector<char> > dirty(opNum, vector<char>(opDMax+1,0)), dirtyNext(dirty);
+  int slicesSolved=0, slicesTotal=0;
+  for(t=tMax-1; t>=tStart; --t){
+    CalcTransPrSW(t);
+    allDirty = kernelChanged || (t<tFirstSolved) || (hashSW(t)!=swOld[t]);
     for(op=0; op<opNum; op++){
+      for(d=0; d<=opDMax; d++) dirty[op][d]=0;
       if( (opE[op]>t) || (opL[op]<=t) ) continue;
       for(d=1; d<=opD[op]; d++){
-        if(opD[op]-t+opE(op)>d) continue;
+        if(opD[op]-t+opE[op]>d) continue;
         if(opL[op]-t<d) continue;
-        for(iMW=0; iMW<sizeSMW; iMW++){
-          for(iSW=0; iSW<sizeSSW; iSW++){
-            for(iMP=0; iMP<sizeSMP; iMP++){
-              for(iSP=0; iSP<sizeSSP; iSP++){
-                for(iT=0; iT<sizeST; iT++){
-                  for(iP=0; iP<sizeSP; iP++){
-                    if ( d<opL[op]-t ){
-                      valuePos=WeightPos(op,d,iMW,iSW,iMP,iSP,iT,iP,t); counter = counter+1;
-                      valueDo=WeightDo(op,d,iMW,iSW,iMP,iSP,iT,iP,t); counter = counter+1;
-                      if(valueDo>valuePos){
-                        valueFun[t][op][d][iMW][iSW][iMP][iSP][iT][iP]=valueDo; optAction[t][op][d][iMW][iSW][iMP][iSP][iT][iP]="do.";
-                      }else{
-                        valueFun[t][op][d][iMW][iSW][iMP][iSP][iT][iP]=valuePos; optAction[t][op][d][iMW][iSW][iMP][iSP][iT][iP]="pos.";
-                      }
-                    }
-                    if( d==(opL[op]-t) ){
-                      valueDo=WeightDo(op,d,iMW,iSW,iMP,iSP,iT,iP,t); counter = counter+1;
-                      valueFun[t][op][d][iMW][iSW][iMP][iSP][iT][iP]=valueDo; optAction[t][op][d][iMW][iSW][iMP][iSP][iT][iP]="doF.";
-                    }
-                    valFunDummy[t]=0+valFunDummy[t+1]; //IS IT TRUE?
+        dirty[op][d] = allDirty || rewChanged[op] ||
+          ( (d<opL[op]-t) && (posChanged || dirtyNext[op][d]) ) ||
+          ( (d>1) && dirtyNext[op][d-1] ) ||
+          ( (d==1) && (op<opNum-1) && dirtyNext[op+1][opD[op+1]] ) ||
+          ( (d==1) && (op==opNum-1) && (FinalReward(t+1)!=finalOld[t]) );
+        slicesTotal++;
+        if(dirty[op][d]) slicesSolved++;
+      }
+    }
+    {
+      TRACE_SPAN_ARG("stage", t);
+      counter += SolveStage(t, &dirty);
+    }
+    swap(dirty, dirtyNext);
+  }
+  tFirstSolved=tStart;
+  solvedSettings=settingsTag();
+  out<<" Re-solved "<< slicesSolved << " of " << slicesTotal << " (t,op,d) slices. Number of actions: "<< counter << endl;
+  if(elimination && (sampleN==0)) out<<" Actions eliminated by bounds: "<< eliminated << endl;
+  CalcErrorBound();
+  totalRew=weightIni();
+  return(totalRew);
+}
 
-                  }
-                }
-              }
-            }
-          }
+
+// ===================================================
+
+double MDPV::SolveState(int t, int op, int d, int iMW, int iSW, int iMP, int iSP, int iT, int iP, string & action){
+  if(!preprocessed) Preprocess();
+  InitFinalValues();
+
+  if( (t<1) || (t>=tMax) || (op<0) || (op>=opNum) || !ValidState(t,op,d) || (iMW<0) || (iMW>=sizeSMW) || (iSW<0) || (iSW>=sizeSSW) ||
+      (iMP<0) || (iMP>=sizeSMP) || (iSP<0) || (iSP>=sizeSSP) || (iT<0) || (iT>=sizeST) || (iP<0) || (iP>=sizeSP) ){
+    out << "Error: state " << getLabel(op,d,iMW,iSW,iMP,iSP,iT,iP,t) << " is not a state of the model!" << endl;
+    action = "";
+    return(0);
+  }
+  if(t>=tFirstSolved){   // solved by SolveMDP or ResolveMDP
+    action = optAction[t][op][d][iMW][iSW][iMP][iSP][iT][iP];
+    return(valueFun[t][op][d][iMW][iSW][iMP][iSP][iT][iP]);
+  }
+  RestoreTables();   // the lazy solve uses the double trans pr
+  if(elimination && (lazyBoundsFrom!=tFirstSolved)) CalcLazyBounds();
+  size_t n = lazyMemo.size();
+  eliminated=0;
+  const LazyState & s = EvalState(t,op,d,iMW,iSW,iMP,iSP,iT,iP);
+  out << " States evaluated: " << lazyMemo.size()-n << " (memoized: " << lazyMemo.size() << ")" << endl;
+  if(elimination) out << " Actions eliminated by bounds: " << eliminated << endl;
+  action = actionLabel(s.action);
+  return(s.value);
+}
+
+
+// ===================================================
+
+const MDPV::LazyState & MDPV::EvalState(int t, int op, int d, int iMW, int iSW, int iMP, int iSP, int iT, int iP){
+  long long key = ((((((((long long)t*opNum+op)*(opDMax+1)+d)*sizeSMW+iMW)*sizeSSW+iSW)*sizeSMP+iMP)*sizeSSP+iSP)*sizeST+iT)*sizeSP+iP;
+  unordered_map<long long, LazyState>::iterator it = lazyMemo.find(key);
+  if(it!=lazyMemo.end()) return(it->second);
+
+  // the successors of do. (none if the last operation is finished)
+  int opDo=-1, dDo=0;
+  if(d>1) { opDo=op; dDo=d-1; }
+  else if(op<opNum-1) { opDo=op+1; dDo=opD[op+1]; }
+  bool evalPos = (d<opL[op]-t), evalDo = true;
+  LazyState s;
+
+  if( evalPos && elimination ){
+    double loPos, hiPos, loDo, hiDo;
+    LazyBound(t, op, d, iMW, iSW, iMP, iSP, iT, iP, loPos, hiPos);
+    loPos += RewardPos(); hiPos += RewardPos();
+    if(opDo>=0){
+      LazyBound(t, opDo, dDo, iMW, iSW, iMP, iSP, iT, iP, loDo, hiDo);
+      loDo += rewDo[op][iMW][iSW]; hiDo += rewDo[op][iMW][iSW];
+    } else {
+      loDo = hiDo = WeightDo(op,d,iMW,iSW,iMP,iSP,iT,iP,t);   // no expectation needed
+    }
+    double margin = 1e-9*(fabs(loPos)+fabs(hiPos)+fabs(loDo)+fabs(hiDo));   // rounding in the bounds
+    if(hiDo+margin<loPos) { evalDo = false; eliminated++; }
+    else if(loDo>hiPos+margin) { evalPos = false; eliminated++; }
+  }
+  double valuePos=0, valueDo=0;
+  if(evalDo){
+    if(opDo>=0) valueDo = rewDo[op][iMW][iSW] + LazyExpect(t, opDo, dDo, iMW, iSW, iMP, iSP, iT, iP);
+    else valueDo = WeightDo(op,d,iMW,iSW,iMP,iSP,iT,iP,t);   // no expectation needed
+  }
+  if(evalPos) valuePos = RewardPos() + LazyExpect(t, op, d, iMW, iSW, iMP, iSP, iT, iP);
+  if(!evalPos) { s.value = valueDo; s.action = (d==opL[op]-t) ? 2 : 1; }
+  else if(evalDo && (valueDo>valuePos)) { s.value = valueDo; s.action = 1; }
+  else { s.value = valuePos; s.action = 0; }
+  return(lazyMemo[key] = s);
+}
+
+
+// ===================================================
+
+double MDPV::LazyValue(int t, int op, int d, int iMW, int iSW, int iMP, int iSP, int iT, int iP){
+  if( (t>=tMax) || !ValidState(t,op,d) ) return(0);   // terminal or value zero
+  if(t>=tFirstSolved) return(valueFun[t][op][d][iMW][iSW][iMP][iSP][iT][iP]);
+  return(EvalState(t,op,d,iMW,iSW,iMP,iSP,iT,iP).value);
+}
+
+
+// ===================================================
+
+double MDPV::LazyExpect(int t, int opN, int dN, int iMWt, int iSWt, int iMPt, int iSPt, int iTt, int iPt){
+  int iSW;
+  KernelRow r = Row(iMWt, iMPt, iSPt, iTt, iPt);
+  long long key = (((long long)t*opNum+opN)*(opDMax+1)+dN)*sizeSMW*sizeSMP*sizeSSP*sizeST*sizeSP+r.rowMW;
+  double weightFu=0, keptSW=0;
+
+  CalcTransPrSW(t);
+  vector<double> & part = lazySW[key];   // references to the elements stay valid when the recursion inserts
+  if(part.empty()) part.assign(sizeSSW, NAN);
+  for(iSW=0; iSW<sizeSSW; iSW++){
+    double pr = exp(prSW[t][iSWt][iSW]);
+    if( !(pr>0) || (pr<lazyPrune) ) continue;
+    if(std::isnan(part[iSW])){
+      // a single pass over the successors evaluating and weighting each of them
+      double sum=0, kept=0;
+      ForSuccessors(r, [&](int iMW, int iMP, int iSP, int iT, int iP, double pr4) {
+        if(pr4>=lazyPrune) {
+          sum += pr4*LazyValue(t+1,opN,dN,iMW,iSW,iMP,iSP,iT,iP);
+          kept += pr4;
         }
+      });
+      if( (lazyPrune>0) && (kept>0) ){   // the mass of the pruned successors is moved to the kept ones
+        sum *= rowSumMW[r.rowMW]*rowSumMP[r.rowMW]*rowSumSP[r.rowSP]*rowSumT[r.rowTP]*rowSumP[iPt]/kept;
       }
+      part[iSW] = sum;
     }
+    weightFu += pr*part[iSW];
+    keptSW += pr;
   }
-  Rcout<<" Number of actions: "<< counter << endl;
-  totalRew=weightIni();
-  printPolicy();
-  return( wrap( List::create(Named("totalRew") = totalRew) ) );
-  // return( wrap( List::create(Named("weights") = valueFun, Named("optAction") = optAction, Named("totalRew") = totalRew) ) );
+  if( (lazyPrune>0) && (keptSW>0) ) weightFu *= rowSumSW[t*sizeSSW+iSWt]/keptSW;
+  return(weightFu);
+}
 
+
+// ===================================================
+
+void MDPV::LazyBound(int t, int opN, int dN, int iMWt, int iSWt, int iMPt, int iSPt, int iTt, int iPt, double & lo, double & hi){
+  KernelRow r = Row(iMWt, iMPt, iSPt, iTt, iPt);
+  double a = lazyLo[((t+1)*opNum+opN)*(opDMax+1)+dN], b = lazyHi[((t+1)*opNum+opN)*(opDMax+1)+dN];
+  // the successors have total trans pr in [massMin, mass] (pruned successors are dropped) and values in [a, b]
+  double mass = rowSumSW[t*sizeSSW+iSWt]*rowSumMW[r.rowMW]*rowSumMP[r.rowMW]*rowSumSP[r.rowSP]*rowSumT[r.rowTP]*rowSumP[iPt];
+  double massMin = (lazyPrune>0) ? 0 : mass;
+  lo = min(a*massMin, a*mass);
+  hi = max(b*massMin, b*mass);
 }
 
 
 // ===================================================
 
-double MDPV::WeightPos(int & opt, int & dt, int & iMWt, int & iSWt, int & iMPt, int & iSPt, int & iTt, int & iPt, int & t) {
-  double pr4, prS, reward;
-  double weightFu=0;
-  int op,d,iMW,iSW,iMP,iSP,iT,iP, tN;
-  op=opt;
-  d=dt;
-  tN=t+1;
+void MDPV::CalcLazyBounds(){
+  int t, op, d, iMW, iSW, iMP, iSP, iT, iP, i;
+  int n = (tMax+1)*opNum*(opDMax+1);
+  int tFirst = min(tFirstSolved, tMax);
 
-  pr.clear();
-  for(iMW=0; iMW<sizeSMW; iMW++){
+  lazyLo.assign(n, 0);   // the value is zero at tMax and in states that are not valid
+  lazyHi.assign(n, 0);
+  if(tFirst<tMax){   // the min and max of the value function of the first solved stage
+    for(op=0; op<opNum; op++){
+      for(d=1; d<=opD[op]; d++){
+        if(!ValidState(tFirst,op,d)) continue;
+        double & lo = lazyLo[(tFirst*opNum+op)*(opDMax+1)+d];
+        double & hi = lazyHi[(tFirst*opNum+op)*(opDMax+1)+d];
+        lo = hi = valueFun[tFirst][op][d][0][0][0][0][0][0];
+        for(iMW=0; iMW<sizeSMW; iMW++)
+          for(iSW=0; iSW<sizeSSW; iSW++)
+            for(iMP=0; iMP<sizeSMP; iMP++)
+              for(iSP=0; iSP<sizeSSP; iSP++)
+                for(iT=0; iT<sizeST; iT++)
+                  for(iP=0; iP<sizeSP; iP++){
+                    double v = valueFun[tFirst][op][d][iMW][iSW][iMP][iSP][iT][iP];
+                    lo = min(lo, v);
+                    hi = max(hi, v);
+                  }
+      }
+    }
+  }
+
+  // the range of the mass of a kernel row (without SW) and of the rewards of do.
+  int rowsMW = sizeSMW*sizeSMP*sizeSSP*sizeST*sizeSP;
+  double kMin = INFINITY, kMax = 0;
+  for(i=0; i<rowsMW; i++){
+    int iPt = i % sizeSP, iTt = (i/sizeSP) % sizeST, iSPt = (i/(sizeSP*sizeST)) % sizeSSP, iMWt = i/(sizeSP*sizeST*sizeSSP*sizeSMP);
+    int iS = ((iMWt*sizeSSP+iSPt)*sizeST+iTt)*sizeSP+iPt;
+    double k = rowSumMW[i]*rowSumMP[i]*rowSumSP[iS]*rowSumT[iTt*sizeSP+iPt]*rowSumP[iPt];
+    kMin = min(kMin, k);
+    kMax = max(kMax, k);
+  }
+  if(lazyPrune>0) kMin = 0;
+  vector<double> rMin(opNum), rMax(opNum);
+  for(op=0; op<opNum; op++){
+    rMin[op] = rMax[op] = rewDo[op][0][0];
+    for(iMW=0; iMW<sizeSMW; iMW++)
+      for(iSW=0; iSW<sizeSSW; iSW++){
+        rMin[op] = min(rMin[op], rewDo[op][iMW][iSW]);
+        rMax[op] = max(rMax[op], rewDo[op][iMW][iSW]);
+      }
+  }
+
+  // backward pass over (t,op,d): the value is the max over the actions of the reward plus the expectation
+  for(t=tFirst-1; t>=1; --t){
+    double sMin = INFINITY, sMax = 0;
+    CalcTransPrSW(t);
     for(iSW=0; iSW<sizeSSW; iSW++){
-      for(iMP=0; iMP<sizeSMP; iMP++){
-        for(iSP=0; iSP<sizeSSP; iSP++){
-          for(iT=0; iT<sizeST; iT++){
-            for(iP=0; iP<sizeSP; iP++){
-              prS = prSP[iMWt][iSPt][iTt][iPt][iSP];
-              pr4 = prS*exp(prMW[iMWt][iMPt][iSPt][iTt][iPt][iMW] + prSW[t][iSWt][iSW] + prMP[iMWt][iMPt][iSPt][iTt][iPt][iMP]
-                              + prT[iTt][iPt][iT] + prP[iPt][iP]);
-              if (pr4>ZERO) {
-                weightFu = weightFu + pr4*valueFun[tN][op][d][iMW][iSW][iMP][iSP][iT][iP];
-                pr.push_back(pr4);
+      sMin = min(sMin, rowSumSW[t*sizeSSW+iSW]);
+      sMax = max(sMax, rowSumSW[t*sizeSSW+iSW]);
+    }
+    double mMin = kMin*sMin, mMax = kMax*sMax;
+    for(op=0; op<opNum; op++){
+      for(d=1; d<=opD[op]; d++){
+        if(!ValidState(t,op,d)) continue;
+        int opDo=-1, dDo=0;
+        if(d>1) { opDo=op; dDo=d-1; }
+        else if(op<opNum-1) { opDo=op+1; dDo=opD[op+1]; }
+        double loDo, hiDo;
+        if(opDo>=0){
+          double a = lazyLo[((t+1)*opNum+opDo)*(opDMax+1)+dDo], b = lazyHi[((t+1)*opNum+opDo)*(opDMax+1)+dDo];
+          loDo = rMin[op] + min(a*mMin, a*mMax);
+          hiDo = rMax[op] + max(b*mMin, b*mMax);
+        } else {
+          double c = valFunDummy[t+1] + (rewRisk ? weightCompletion*CompletionCri(t+1) : 0);
+          loDo = rMin[op] + c;
+          hiDo = rMax[op] + c;
+        }
+        double & lo = lazyLo[(t*opNum+op)*(opDMax+1)+d];
+        double & hi = lazyHi[(t*opNum+op)*(opDMax+1)+d];
+        lo = loDo; hi = hiDo;
+        if(d<opL[op]-t){
+          double a = lazyLo[((t+1)*opNum+op)*(opDMax+1)+d], b = lazyHi[((t+1)*opNum+op)*(opDMax+1)+d];
+          lo = max(lo, RewardPos() + min(a*mMin, a*mMax));
+          hi = max(hi, RewardPos() + max(b*mMin, b*mMax));
+        }
+      }
+    }
+  }
+  lazyBoundsFrom = tFirstSolved;
+}
+
+
+// ===================================================
+
+void MDPV::ClearLazy(){
+  lazyMemo.clear();
+  lazySW.clear();
+  lazyBoundsFrom = -1;
+}
+
+
+// ===================================================
+
+void MDPV::setLazyPruning(double minPr){
+  if ( !(minPr>=0) || (minPr>=1) ) throw runtime_error("The pruning threshold must be in [0,1)");
+  lazyPrune = minPr;
+  ClearLazy();
+}
+
+
+// ===================================================
+
+int MDPV::SolveStage(int t, const vector< vector<char> > * slices){
+  int op, iMW, iSW, iMP, iSP, iT, iP, d;
+  int counter=0;
+
+  CalcTransPrSW(t);
+  keySW[0] = keySW[1] = -1;   // new values at day t+1
+  if(elimination && (sampleN==0)) CalcValueBounds(t+1);
+  for(op=0; op<opNum; op++){
+    if( (opE[op]>t) || (opL[op]<=t) ) continue;
+    for(d=1; d<=opD[op]; d++){
+      if(opD[op]-t+opE[op]>d) continue;
+      if(opL[op]-t<d) continue;
+      if( (slices!=NULL) && !(*slices)[op][d] ) continue;
+      TRACE_SPAN_ARG("expect", op*(opDMax+1)+d);   // the expectations of slice (op,d)
+      // iSW is the inner loop so the states reuse the cached ExpectSW results
+      for(iMW=iMWFrom; iMW<iMWTo; iMW++){
+        for(iMP=0; iMP<sizeSMP; iMP++){
+          for(iSP=0; iSP<sizeSSP; iSP++){
+            for(iT=0; iT<sizeST; iT++){
+              for(iP=0; iP<sizeSP; iP++){
+                for(iSW=0; iSW<sizeSSW; iSW++){
+                  counter += OptimizeState(t,op,d,iMW,iSW,iMP,iSP,iT,iP);
+                }
               }
             }
           }
@@ -265,100 +882,472 @@ double MDPV::WeightPos(int & opt, int & dt, int & iMWt, int & iSWt, int & iMPt,
       }
     }
   }
+  return(counter);
+}
+
+
+// ===================================================
+
+int MDPV::OptimizeState(int & t, int & op, int & d, int & iMW, int & iSW, int & iMP, int & iSP, int & iT, int & iP){
+  double valueDo, valuePos;
+  int counter=0;
+
+  sampleSlot=0;   // the sampled values of pos. and do. are stored in sampleVal[0] and sampleVal[1]
+  if ( d<opL[op]-t ){
+    if( elimination && (boundStage==t+1) ){
+      double loPos, hiPos, loDo, hiDo;
+      BoundExpect(t, op, d, iMW, iSW, iMP, iSP, iT, iP, loPos, hiPos);
+      loPos += RewardPos(); hiPos += RewardPos();
+      if( (d>1) || (op<opNum-1) ){
+        if(d>1) BoundExpect(t, op, d-1, iMW, iSW, iMP, iSP, iT, iP, loDo, hiDo);
+        else BoundExpect(t, op+1, opD[op+1], iMW, iSW, iMP, iSP, iT, iP, loDo, hiDo);
+        loDo += rewDo[op][iMW][iSW]; hiDo += rewDo[op][iMW][iSW];
+      } else {
+        loDo = hiDo = WeightDo(op,d,iMW,iSW,iMP,iSP,iT,iP,t);   // no expectation needed
+      }
+      double margin = 1e-9*(fabs(loPos)+fabs(hiPos)+fabs(loDo)+fabs(hiDo));   // rounding in the bounds
+      if(hiDo+margin<loPos){   // pos. is optimal
+        valueFun[t][op][d][iMW][iSW][iMP][iSP][iT][iP]=WeightPos(op,d,iMW,iSW,iMP,iSP,iT,iP,t);
+        optAction[t][op][d][iMW][iSW][iMP][iSP][iT][iP]="pos.";
+        eliminated++;
+        return(1);
+      }
+      if(loDo>hiPos+margin){   // do. is optimal
+        valueFun[t][op][d][iMW][iSW][iMP][iSP][iT][iP]=WeightDo(op,d,iMW,iSW,iMP,iSP,iT,iP,t);
+        optAction[t][op][d][iMW][iSW][iMP][iSP][iT][iP]="do.";
+        eliminated++;
+        return(1);
+      }
+    }
+    valuePos=WeightPos(op,d,iMW,iSW,iMP,iSP,iT,iP,t); counter = counter+1;
+    valueDo=WeightDo(op,d,iMW,iSW,iMP,iSP,iT,iP,t); counter = counter+1;
+    if(sampleN>0) CountSampleDecision(valueDo-valuePos, (d>1) || (op<opNum-1));
+    if(valueDo>valuePos){
+      valueFun[t][op][d][iMW][iSW][iMP][iSP][iT][iP]=valueDo; optAction[t][op][d][iMW][iSW][iMP][iSP][iT][iP]="do.";
+    }else{
+      valueFun[t][op][d][iMW][iSW][iMP][iSP][iT][iP]=valuePos; optAction[t][op][d][iMW][iSW][iMP][iSP][iT][iP]="pos.";
+    }
+  }
+  if( d==(opL[op]-t) ){
+    valueDo=WeightDo(op,d,iMW,iSW,iMP,iSP,iT,iP,t); counter = counter+1;
+    valueFun[t][op][d][iMW][iSW][iMP][iSP][iT][iP]=valueDo; optAction[t][op][d][iMW][iSW][iMP][iSP][iT][iP]="doF.";
+  }
+  return(counter);
+}
 
-  if(rewRisk) reward=0; else  reward=-coefTimeliness*priceYield*yieldHa*fieldArea;
+// ===================================================
+
+void MDPV::CalcValueBounds(int t){
+  TRACE_SPAN_ARG("bounds", t);
+  int op, d, iMW, iSW, iMP, iSP, iT, iP;
 
-  if (check) {
-    arma::vec tmp(pr);
-    if (!Equal(sum(tmp),1,1e-8)) {
-      Rcout << "Warning sum pr!=1 in WeightsTransPrPos - diff = " << 1-sum(tmp) << " op = " << op << " action = pos. " << " index:" << endl; //vec2String<int>(index) << " pr:" << vec2String<flt>(pr) << endl;
+  vMin.assign(opNum*(opDMax+1)*sizeSMW, 0);
+  vMax.assign(opNum*(opDMax+1)*sizeSMW, 0);
+  for(op=0; op<opNum; op++){
+    for(d=0; d<=opDMax; d++){
+      for(iMW=0; iMW<sizeSMW; iMW++){
+        double & lo = vMin[(op*(opDMax+1)+d)*sizeSMW+iMW];
+        double & hi = vMax[(op*(opDMax+1)+d)*sizeSMW+iMW];
+        if(valueFun[t][op][d][iMW].empty()) continue;   // not allocated (distributed solve)
+        lo = hi = valueFun[t][op][d][iMW][0][0][0][0][0];
+        for(iSW=0; iSW<sizeSSW; iSW++)
+          for(iMP=0; iMP<sizeSMP; iMP++)
+            for(iSP=0; iSP<sizeSSP; iSP++)
+              for(iT=0; iT<sizeST; iT++)
+                for(iP=0; iP<sizeSP; iP++){
+                  double v = valueFun[t][op][d][iMW][iSW][iMP][iSP][iT][iP];
+                  if(v<lo) lo=v;
+                  if(v>hi) hi=v;
+                }
+      }
     }
   }
+  boundStage = t;
+}
+
+// ===================================================
+
+void MDPV::BoundExpect(int t, int opN, int dN, int iMWt, int iSWt, int iMPt, int iSPt, int iTt, int iPt, double & lo, double & hi){
+  KernelRow r = Row(iMWt, iMPt, iSPt, iTt, iPt);
+  const double* vLo = &vMin[(opN*(opDMax+1)+dN)*sizeSMW];
+  const double* vHi = &vMax[(opN*(opDMax+1)+dN)*sizeSMW];
+  // the successors of each iMW have total trans pr pMW*rest and values in [vLo, vHi]
+  double rest = rowSumSW[t*sizeSSW+iSWt]*rowSumMP[r.rowMW]*rowSumSP[r.rowSP]*rowSumT[r.rowTP]*rowSumP[iPt];
+
+  lo = hi = 0;
+  for(int iMW=r.sMW[0]; iMW<r.sMW[1]; iMW++){
+    double pr;
+    if(r.pMW!=NULL) pr = exp(r.pMW[iMW]);
+    else if(precision==PREC_Q16) pr = redQ.MW[r.rowMW*sizeSMW+iMW]/65535.0;   // released (see ReleaseTables)
+    else pr = redF.MW[r.rowMW*sizeSMW+iMW];
+    lo += pr*vLo[iMW];
+    hi += pr*vHi[iMW];
+  }
+  lo *= rest;
+  hi *= rest;
+}
+
+// ===================================================
+
+double MDPV::WeightPos(int & opt, int & dt, int & iMWt, int & iSWt, int & iMPt, int & iSPt, int & iTt, int & iPt, int & t) {
+  double reward;
+  double weightFu=0;
+  int op,d;
+  op=opt;
+  d=dt;
+
+  weightFu = Expect(t, op, d, iMWt, iSWt, iMPt, iSPt, iTt, iPt);
+
+  reward=RewardPos();
+
   return(reward+weightFu);
 }
 
 // ===================================================
 
 double MDPV::WeightDo(int & opt, int & dt, int & iMWt, int & iSWt, int & iMPt, int & iSPt, int & iTt, int & iPt, int & t) {
-  double pr4, prS, reward;
+  double pr4, reward;
   double weightFu=0;
   double completionCri=0;
-  int op,d,iMW,iSW,iMP,iSP,iT,iP, tN;
+  int op,d, tN;
 
-  pr.clear();
   if( (dt>1) ){
     d=dt-1;
     op=opt;
+    weightFu = Expect(t, op, d, iMWt, iSWt, iMPt, iSPt, iTt, iPt);
+
+    if(rewRisk) reward = rewDo[opt][iMWt][iSWt]; else reward=rewDo[opt][iMWt][iSWt];
+  }
+
+  if( (dt==1) & (opt<(opNum-1)) ){
+    d=opD[opt+1];
+    op=opt+1;
+    weightFu = Expect(t, op, d, iMWt, iSWt, iMPt, iSPt, iTt, iPt);
+    if(rewRisk) reward = rewDo[opt][iMWt][iSWt]; else reward=rewDo[opt][iMWt][iSWt];
+  }
+
+  if( (dt==1) & (opt==(opNum-1)) ){
+    pr4=1;
     tN=t+1;
-    for(iMW=0; iMW<sizeSMW; iMW++){
-      for(iSW=0; iSW<sizeSSW; iSW++){
-        for(iMP=0; iMP<sizeSMP; iMP++){
-          for(iSP=0; iSP<sizeSSP; iSP++){
-            for(iT=0; iT<sizeST; iT++){
-              for(iP=0; iP<sizeSP; iP++){
-                prS = prSP[iMWt][iSPt][iTt][iPt][iSP];
-                pr4 = prS*exp(prMW[iMWt][iMPt][iSPt][iTt][iPt][iMW] + prSW[t][iSWt][iSW] + prMP[iMWt][iMPt][iSPt][iTt][iPt][iMP]
-                                + prT[iTt][iPt][iT] + prP[iPt][iP]);
-                if (pr4>ZERO) {
-                  weightFu = weightFu + pr4*valueFun[tN][op][d][iMW][iSW][iMP][iSP][iT][iP];
-                  pr.push_back(pr4);
-                }
-              }
-            }
-          }
-        }
-      }
+    weightFu = weightFu + pr4*valFunDummy[tN];
+    completionCri = CompletionCri(tN);
+
+    if(rewRisk) reward = ( rewDo[opt][iMWt][iSWt] +  weightCompletion*(completionCri) ); else reward=rewDo[opt][iMWt][iSWt];
+  }
+
+  return(reward+weightFu);
+}
+
+// ===================================================
+
+double MDPV::Expect(int t, int opN, int dN, int iMWt, int iSWt, int iMPt, int iSPt, int iTt, int iPt) {
+  double weightFu=0;
+  int iSW, tN;
+  tN=t+1;
+
+  if( sampleN>0 ) return( ExpectSample(t, opN, dN, iMWt, iSWt, iMPt, iSPt, iTt, iPt) );
+  if( weatherStage==tN ) return( ExpectWeather(t, opN, dN, iMWt, iSWt, iMPt, iSPt, iTt, iPt) );
+  if( (precision==PREC_FLOAT) && !redF.MW.empty() ) return( ExpectReduced(redF, 1.0, t, opN, dN, iMWt, iSWt, iMPt, iSPt, iTt, iPt) );
+  if( (precision==PREC_Q16) && !redQ.MW.empty() ) return( ExpectReduced(redQ, 1.0/65535, t, opN, dN, iMWt, iSWt, iMPt, iSPt, iTt, iPt) );
+  const double* part = ExpectSW(t, opN, dN, iMWt, iMPt, iSPt, iTt, iPt);
+  const vector<double> & pSW = prSW[t][iSWt];
+
+  for(iSW=0; iSW<sizeSSW; iSW++){
+    double pr = exp(pSW[iSW]);
+    if (pr>0) weightFu = weightFu + pr*part[iSW];
+  }
+  return(weightFu);
+}
+
+// ===================================================
+
+const double* MDPV::ExpectSW(int t, int opN, int dN, int iMWt, int iMPt, int iSPt, int iTt, int iPt) {
+  KernelRow r = Row(iMWt, iMPt, iSPt, iTt, iPt);
+  long long key = (((long long)t*opNum+opN)*(opDMax+1)+dN)*sizeSMW*sizeSMP*sizeSSP*sizeST*sizeSP+r.rowMW;
+  if (keySW[0]==key) return(&cacheSW[0][0]);
+  if (keySW[1]==key) return(&cacheSW[1][0]);
+
+  int c = nextSW;
+  nextSW = 1-nextSW;
+  keySW[c] = key;
+  vector<double> & part = cacheSW[c];
+  part.assign(sizeSSW, 0);
+  const vector< vector< vector< vector< vector< vector<double> > > > > > & v = valueFun[t+1][opN][dN];
+
+  // only the successors in the support of each factor are visited
+  ForSuccessors(r, [&](int iMW, int iMP, int iSP, int iT, int iP, double pr4) {
+    for(int iSW=0; iSW<sizeSSW; iSW++) part[iSW] = part[iSW] + pr4*v[iMW][iSW][iMP][iSP][iT][iP];
+  });
+  return(&part[0]);
+}
+
+// ===================================================
+
+double MDPV::ExpectWeather(int t, int opN, int dN, int iMWt, int iSWt, int iMPt, int iSPt, int iTt, int iPt) {
+  double weightFu=0;
+  const double* c = &weatherSlab[(((opN*(opDMax+1)+dN)*sizeST+iTt)*sizeSP+iPt)*sizeSMW*sizeSSW*sizeSMP*sizeSSP];
+
+  ForSoilSuccessors(Row(iMWt, iMPt, iSPt, iTt, iPt), t, iSWt, [&](int iMW, int iSW, int iMP, int iSP, double pr4) {
+    weightFu = weightFu + pr4*c[((iMW*sizeSSW+iSW)*sizeSMP+iMP)*sizeSSP+iSP];
+  });
+  return(weightFu);
+}
+
+// ===================================================
+
+/** Next random number of a splitmix64 generator. */
+static unsigned long long splitMix(unsigned long long & state){
+  unsigned long long z = (state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return( z ^ (z >> 31) );
+}
+
+// ===================================================
+
+void MDPV::DrawSamples(int t, int iMWt, int iSWt, int iMPt, int iSPt, int iTt, int iPt){
+  KernelRow r = Row(iMWt, iMPt, iSPt, iTt, iPt);
+  long long key = ((long long)t*sizeSSW+iSWt)*sizeSMW*sizeSMP*sizeSSP*sizeST*sizeSP+r.rowMW;
+  if (key==sampleKey) return;
+  sampleKey = key;
+
+  // the cumulative trans pr of each factor over its support (iMW, iSW, iMP, iSP, iT, iP)
+  int lo[6] = {r.sMW[0], 0, r.sMP[0], r.sSP[0], r.sT[0], r.sP[0]};
+  int hi[6] = {r.sMW[1], sizeSSW, r.sMP[1], r.sSP[1], r.sT[1], r.sP[1]};
+  vector<double> cum[6];
+  int f, i;
+  sampleMass = 1;
+  for(f=0; f<6; f++){
+    double sum = 0;
+    for(i=lo[f]; i<hi[f]; i++){
+      if (f==0) sum += exp(r.pMW[i]);
+      else if (f==1) sum += exp(prSW[t][iSWt][i]);
+      else if (f==2) sum += exp(r.pMP[i]);
+      else if (f==3) sum += r.pSP[i];
+      else if (f==4) sum += exp(r.pT[i]);
+      else sum += exp(r.pP[i]);
+      cum[f].push_back(sum);
     }
+    sampleMass *= sum;
+  }
 
-    if(rewRisk) reward = rewDo[opt][iMWt][iSWt]; else reward=rewDo[opt][iMWt][iSWt];
+  // draw each factor by inversion (the random numbers only depend on the seed and the parent)
+  sampleIdx.assign(6*sampleN, 0);
+  if (sampleMass==0) return;   // no successors, the expectation is zero
+  unsigned long long state = sampleSeed, h = (unsigned long long)key;
+  state = splitMix(state) ^ splitMix(h);
+  for(int k=0; k<sampleN; k++){
+    for(f=0; f<6; f++){
+      double u = (splitMix(state) >> 11) * (1.0/9007199254740992.0);   // uniform in [0,1)
+      i = upper_bound(cum[f].begin(), cum[f].end(), u*cum[f].back()) - cum[f].begin();
+      if (i>=(int)cum[f].size()) i = cum[f].size()-1;
+      sampleIdx[6*k+f] = lo[f]+i;
+    }
+  }
+}
+
+// ===================================================
+
+double MDPV::ExpectSample(int t, int opN, int dN, int iMWt, int iSWt, int iMPt, int iSPt, int iTt, int iPt) {
+  int i;
+  double sum=0, sum2=0;
+
+  DrawSamples(t, iMWt, iSWt, iMPt, iSPt, iTt, iPt);
+  vector<double> & x = sampleVal[sampleSlot];
+  sampleSlot = 1;
+  x.resize(sampleN);
+  const vector< vector< vector< vector< vector< vector<double> > > > > > & v = valueFun[t+1][opN][dN];
+  const int* s = &sampleIdx[0];
+  for(i=0; i<sampleN; i++, s+=6){
+    x[i] = v[s[0]][s[1]][s[2]][s[3]][s[4]][s[5]];
+    sum += x[i];
   }
+  double mean = sum/sampleN;
+  for(i=0; i<sampleN; i++) sum2 += (x[i]-mean)*(x[i]-mean);
+  double se = (sampleN>1) ? sampleMass*sqrt(sum2/(sampleN-1)/sampleN) : 0;
+  sampled.expectations++;
+  sampled.sumSe += se;
+  sampled.maxSe = max(sampled.maxSe, se);
+  return(sampleMass*mean);
+}
+
+// ===================================================
+
+void MDPV::CountSampleDecision(double diff, bool paired){
+  int i;
+  double sum=0, sum2=0;
+  const vector<double> & pos = sampleVal[0];
+  const vector<double> & dO = sampleVal[1];
+
+  // the samples of both actions use the same successors, i.e. the differences are paired
+  for(i=0; i<sampleN; i++) sum += paired ? dO[i]-pos[i] : pos[i];
+  double mean = sum/sampleN;
+  for(i=0; i<sampleN; i++){
+    double x = (paired ? dO[i]-pos[i] : pos[i]) - mean;
+    sum2 += x*x;
+  }
+  double se = (sampleN>1) ? sampleMass*sqrt(sum2/(sampleN-1)/sampleN) : 0;
+  sampled.decisions++;
+  if (fabs(diff)<1.96*se) sampled.close++;
+}
+
+// ===================================================
+
+template<typename Pr>
+double MDPV::ExpectReduced(const RedTables<Pr> & tab, double scale, int t, int opN, int dN, int iMWt, int iSWt, int iMPt, int iSPt, int iTt, int iPt) {
+  int iMW,iSW,iMP,iSP,iT,iP;
+  int tN=t+1;
+  KernelRow r = Row(iMWt, iMPt, iSPt, iTt, iPt);
+  const Pr* pSW = &tab.SW[(t*sizeSSW+iSWt)*sizeSSW];
+  double weightFu=0;
 
-  if( (dt==1) & (opt<(opNum-1)) ){
-    d=opD[opt+1];
-    op=opt+1;
-    tN=t+1;
-    for(iMW=0; iMW<sizeSMW; iMW++){
-      for(iSW=0; iSW<sizeSSW; iSW++){
-        for(iMP=0; iMP<sizeSMP; iMP++){
-          for(iSP=0; iSP<sizeSSP; iSP++){
-            for(iT=0; iT<sizeST; iT++){
-              for(iP=0; iP<sizeSP; iP++){
-                prS = prSP[iMWt][iSPt][iTt][iPt][iSP];
-                pr4 = prS*exp(prMW[iMWt][iMPt][iSPt][iTt][iPt][iMW] + prSW[t][iSWt][iSW] + prMP[iMWt][iMPt][iSPt][iTt][iPt][iMP]
-                                + prT[iTt][iPt][iT] + prP[iPt][iP]);
-                if (pr4>ZERO) {
-                  weightFu = weightFu + pr4*valueFun[tN][op][d][iMW][iSW][iMP][iSP][iT][iP];
-                  pr.push_back(pr4);
-                }
+  // the expectation over the successors (iMW, iMP, iSP, iT, iP) of each iSW is shared by the states of the key
+  long long key = (((long long)t*opNum+opN)*(opDMax+1)+dN)*sizeSMW*sizeSMP*sizeSSP*sizeST*sizeSP+r.rowMW;
+  int c = (keySW[0]==key) ? 0 : 1;
+  if (keySW[c]!=key) {
+    c = nextSW;
+    nextSW = 1-nextSW;
+    keySW[c] = key;
+    vector<double> & part = cacheSW[c];
+    part.assign(sizeSSW, 0);
+    const Pr* pMW = &tab.MW[r.rowMW*sizeSMW];
+    const Pr* pMP = &tab.MP[r.rowMW*sizeSMP];
+    const Pr* pSP = &tab.SP[r.rowSP*sizeSSP];
+    const Pr* pT = &tab.T[r.rowTP*sizeST];
+    const Pr* pP = &tab.P[iPt*sizeSP];
+    const int *sMW = r.sMW, *sMP = r.sMP, *sSP = r.sSP, *sT = r.sT, *sP = r.sP;
+    double pr1, pr2, pr3, pr4, pr5;
+
+    // the products are built up loop by loop and branches with zero probability are skipped
+    for(iMW=sMW[0]; iMW<sMW[1]; iMW++){
+      pr1 = scale*pMW[iMW];
+      if (pr1==0) continue;
+      const vector< vector< vector< vector< vector<double> > > > > & v = valueFun[tN][opN][dN][iMW];
+      for(iMP=sMP[0]; iMP<sMP[1]; iMP++){
+        pr2 = pr1*scale*pMP[iMP];
+        if (pr2==0) continue;
+        for(iSP=sSP[0]; iSP<sSP[1]; iSP++){
+          pr3 = pr2*scale*pSP[iSP];
+          if (pr3==0) continue;
+          for(iT=sT[0]; iT<sT[1]; iT++){
+            pr4 = pr3*scale*pT[iT];
+            if (pr4==0) continue;
+            for(iP=sP[0]; iP<sP[1]; iP++){
+              pr5 = pr4*scale*pP[iP];
+              if (pr5>0) {
+                for(iSW=0; iSW<sizeSSW; iSW++) part[iSW] = part[iSW] + pr5*v[iSW][iMP][iSP][iT][iP];
               }
             }
           }
         }
       }
     }
-    if(rewRisk) reward = rewDo[opt][iMWt][iSWt]; else reward=rewDo[opt][iMWt][iSWt];
   }
+  const double* part = &cacheSW[c][0];
+  for(iSW=0; iSW<sizeSSW; iSW++){
+    double pr = scale*pSW[iSW];
+    if (pr>0) weightFu = weightFu + pr*part[iSW];
+  }
+  return(weightFu);
+}
 
-  if( (dt==1) & (opt==(opNum-1)) ){
-    pr4=1;
-    pr.push_back(pr4);
-    tN=t+1;
-    weightFu = weightFu + pr4*valFunDummy[tN];
-    if( (tN>=minOpt) & (tN<=maxOpt) ) completionCri = 1;
-    if( tN<minOpt ) completionCri = (double)(minOpt-tN)/(double)(minOpt);
-    if( tN>maxOpt ) completionCri = (double)(tN-maxOpt)/(double)(tN);
+// ===================================================
 
-    if(rewRisk) reward = ( rewDo[opt][iMWt][iSWt] +  weightCompletion*(completionCri) ); else reward=rewDo[opt][iMWt][iSWt];
-  }
+/** Store a trans pr with reduced precision. */
+static void storePr(float & x, double p) { x = (float)p; }
+static void storePr(unsigned short & x, double p) { x = (unsigned short)floor(p*65535+0.5); }
 
-  if (check) {
-    arma::vec tmp(pr);
-    if (!Equal(sum(tmp),1,1e-8)) {
-      Rcout << "Warning sum pr!=1 in WeightsTransPrDo - diff = " << 1-sum(tmp) << " op = " << op << " action = Do. " << endl; // " index:" << vec2String<int>(index) << " pr:" << vec2String<flt>(pr) << endl;
+template<typename Pr>
+void MDPV::CalcReduced(RedTables<Pr> & tab){
+  int iMWt,iMPt,iSPt,iTt,iPt, t, i;
+
+  tab.MW.resize(sizeSMW*sizeSMP*sizeSSP*sizeST*sizeSP*sizeSMW);
+  tab.MP.resize(sizeSMW*sizeSMP*sizeSSP*sizeST*sizeSP*sizeSMP);
+  tab.SP.resize(sizeSMW*sizeSSP*sizeST*sizeSP*sizeSSP);
+  tab.SW.resize((tMax+1)*sizeSSW*sizeSSW);
+  tab.T.resize(sizeST*sizeSP*sizeST);
+  tab.P.resize(sizeSP*sizeSP);
+
+  Pr* x = &tab.MW[0];
+  Pr* y = &tab.MP[0];
+  for(iMWt=0; iMWt<sizeSMW; iMWt++){
+    for(iMPt=0; iMPt<sizeSMP; iMPt++){
+      for(iSPt=0; iSPt<sizeSSP; iSPt++){
+        for(iTt=0; iTt<sizeST; iTt++){
+          for(iPt=0; iPt<sizeSP; iPt++){
+            for(i=0; i<sizeSMW; i++) storePr(*x++, exp(prMW[iMWt][iMPt][iSPt][iTt][iPt][i]));
+            for(i=0; i<sizeSMP; i++) storePr(*y++, exp(prMP[iMWt][iMPt][iSPt][iTt][iPt][i]));
+          }
+        }
+      }
     }
   }
+  x = &tab.SP[0];
+  for(iMWt=0; iMWt<sizeSMW; iMWt++)
+    for(iSPt=0; iSPt<sizeSSP; iSPt++)
+      for(iTt=0; iTt<sizeST; iTt++)
+        for(iPt=0; iPt<sizeSP; iPt++)
+          for(i=0; i<sizeSSP; i++) storePr(*x++, prSP[iMWt][iSPt][iTt][iPt][i]);
+  for(t=0; t<=tMax; t++)
+    if(readySW[t]) StoreReducedSW(tab, t);   // the other rows are stored when calculated
+  x = &tab.T[0];
+  for(iTt=0; iTt<sizeST; iTt++)
+    for(iPt=0; iPt<sizeSP; iPt++)
+      for(i=0; i<sizeST; i++) storePr(*x++, exp(prT[iTt][iPt][i]));
+  x = &tab.P[0];
+  for(iPt=0; iPt<sizeSP; iPt++)
+    for(i=0; i<sizeSP; i++) storePr(*x++, exp(prP[iPt][i]));
+}
 
-  return(reward+weightFu);
+// the reduced tables are also calculated by FootprintPlanner::Probe
+template void MDPV::CalcReduced(RedTables<float> & tab);
+template void MDPV::CalcReduced(RedTables<unsigned short> & tab);
+
+// ===================================================
+
+void MDPV::ReleaseTables(){
+  vector <vector<vector< vector< vector< vector<double> > > > > >().swap(prMW);
+  vector <vector<vector< vector< vector< vector<double> > > > > >().swap(prMP);
+  tablesReady[TAB_SOIL] = false;   // calculated again by the next Preprocess
+}
+
+// ===================================================
+
+void MDPV::RestoreTables(){
+  if(!prMW.empty()) return;
+  calcTables(TAB_SOIL);
+  if(truncEps>0) TruncateTables(TAB_SOIL);
+}
+
+// ===================================================
+
+void MDPV::InitFinalValues(){
+  if (rewRisk) valFunDummy[tMax]=0; else valFunDummy[tMax]=priceYield*yieldHa*fieldArea;
+  for(int t=tMax-1; t>=1; --t) valFunDummy[t]=0+valFunDummy[t+1];
+}
+
+// ===================================================
+
+double MDPV::RewardPos(){
+  if(rewRisk) return(0);
+  return(-coefTimeliness*priceYield*yieldHa*fieldArea);
+}
+
+// ===================================================
+
+double MDPV::CompletionCri(int tN){
+  double completionCri=0;
+  if( (tN>=minOpt) & (tN<=maxOpt) ) completionCri = 1;
+  if( tN<minOpt ) completionCri = (double)(minOpt-tN)/(double)(minOpt);
+  if( tN>maxOpt ) completionCri = (double)(tN-maxOpt)/(double)(tN);
+  return(completionCri);
+}
+
+// ===================================================
+
+double MDPV::FinalReward(int tN){
+  if(rewRisk) return(weightCompletion*CompletionCri(tN) + valFunDummy[tN]);
+  return(valFunDummy[tN]);
 }
 
 // ===================================================
@@ -397,9 +1386,9 @@ double MDPV::weightIni() {
   // reward=0
   //
   // if (check) {
-  //   arma::vec tmp(pr);
-  //   if (!Equal(sum(tmp),1,1e-8)) {
-  //     Rcout << "Warning sum pr!=1 in WeightsTransPrPos - diff = " << 1-sum(tmp) << " op = " << op << " action = pos. " << " index:" << endl; //vec2String<int>(index) << " pr:" << vec2String<flt>(pr) << endl;
+  //   double sumPr = accumulate(pr.begin(), pr.end(), 0.0);
+  //   if (!Equal(sumPr,1,1e-8)) {
+  //     out << "Warning sum pr!=1 in WeightsTransPrPos - diff = " << 1-sumPr << " op = " << op << " action = pos. " << " index:" << endl; //vec2String<int>(index) << " pr:" << vec2String<flt>(pr) << endl;
   //   }
   // }
   // return(reward+weightFu);
@@ -427,7 +1416,7 @@ void MDPV::CalcRewaerdDo(){
 
           rewDo[op][iMW][iSW] = weightWorkable*workCri + weightTraffic*trafiCriteria;
         }else{
-          rewDo[op][iMW][iSW]= -coefLoss*priceYield*yieldHa*machCap*(1- R::pnorm(watTh[op],dMW(iMW,0),dSW(iSW,0),1,0) );
+          rewDo[op][iMW][iSW]= -coefLoss*priceYield*yieldHa*machCap*(1- normCdf(watTh[op],dMW(iMW,0),dSW(iSW,0)) );
         }
       }
     }
@@ -451,7 +1440,7 @@ void MDPV::CalcTransPrMW(){   //prMW[iMWt][iMPt][iSPt][iTt][iPt][iMW]
             mt=ft*dMP(iMPt,0); ct=qt;
             for(iMW=0; iMW<sizeSMW; iMW++){
               lower= dMW(iMW,1); upper=dMW(iMW,2);
-              prMW[iMWt][iMPt][iSPt][iTt][iPt][iMW] = log( R::pnorm(upper,mt,sqrt(ct),1,0) - R::pnorm(lower,mt,sqrt(ct),1,0)  );
+              prMW[iMWt][iMPt][iSPt][iTt][iPt][iMW] = log( normCdf(upper,mt,sqrt(ct)) - normCdf(lower,mt,sqrt(ct))  );
             }
           }
         }
@@ -463,16 +1452,69 @@ void MDPV::CalcTransPrMW(){   //prMW[iMWt][iMPt][iSPt][iTt][iPt][iMW]
 // ===================================================
 
 void MDPV::CalcTransPrSW(){  //prSW[t][iSWt][iSW]
-  cpuTime.Reset(0); cpuTime.StartTime(0);
-  int t,iSWt,iSW;
+  readySW.assign(tMax+1, 0);
+  readySW[0] = readySW[tMax] = 1;   // not used
+  rowSumSW.assign((tMax+1)*sizeSSW, 0);
+}
 
-  for(t=1; t<tMax; t++){
+// ===================================================
+
+/** The quantile of the beta distribution of a variance limit u given location a (see CalcTransPrSW). */
+static double ngssmQuantile(double u, double a){
+  double beta = 1;   // Weibull parameter
+  return( (double)(1)/( 1 + pow( (double)(u-a)/(a), -beta ) ) );
+}
+
+// ===================================================
+
+void MDPV::CalcTransPrSW(int t){
+  if(readySW[t]) return;
+  TRACE_SPAN_ARG("calcSW", t);
+  int iSWt, iSW;
+
+  if(sizeSSW==1){
+    prSW[t][0][0] = log(1);   // a single interval holds all the mass
+  } else {
+    double oShape = (double) (nGSSMK-1)/(2);
+    double iShape = (double) (nGSSMK-1)/(2);
+    BetaCdf cdf(oShape, iShape + oShape*t + 1);
+    vector<double> lower(sizeSSW), upper(sizeSSW);
     for(iSWt=0; iSWt<sizeSSW; iSWt++){
+      double a = (double) ( pow(dSW(iSWt,0),2) * ( iShape + oShape*t ) ) / ( iShape + oShape*(t+1) );
       for(iSW=0; iSW<sizeSSW; iSW++){
-        prSW[t][iSWt][iSW] = log(1);//log(PrNGSSM( t, pow(dSW(iSW,1),2), pow(dSW(iSW,2),2), pow(dSW(iSWt,0),2) ) );
+        // adjacent intervals share a limit
+        if( (iSW>0) && (dSW(iSW,1)==dSW(iSW-1,2)) ) lower[iSW] = upper[iSW-1];
+        else lower[iSW] = cdf(ngssmQuantile(pow(dSW(iSW,1),2), a));
+        upper[iSW] = cdf(ngssmQuantile(pow(dSW(iSW,2),2), a));
+        prSW[t][iSWt][iSW] = log(upper[iSW]-lower[iSW]);
       }
     }
   }
+  for(iSWt=0; iSWt<sizeSSW; iSWt++){
+    double & sum = rowSumSW[t*sizeSSW+iSWt];
+    sum = 0;
+    for(iSW=0; iSW<sizeSSW; iSW++) sum += exp(prSW[t][iSWt][iSW]);
+  }
+  if( (precision==PREC_FLOAT) && !redF.SW.empty() ) StoreReducedSW(redF, t);
+  if( (precision==PREC_Q16) && !redQ.SW.empty() ) StoreReducedSW(redQ, t);
+  readySW[t] = 1;
+}
+
+// ===================================================
+
+unsigned long long MDPV::hashSW(int t) const {
+  FNVHash f;
+  for(int iSWt=0; iSWt<sizeSSW; iSWt++) f.add(prSW[t][iSWt]);
+  return(f.h);
+}
+
+// ===================================================
+
+template<typename Pr>
+void MDPV::StoreReducedSW(RedTables<Pr> & tab, int t){
+  Pr* x = &tab.SW[t*sizeSSW*sizeSSW];
+  for(int iSWt=0; iSWt<sizeSSW; iSWt++)
+    for(int i=0; i<sizeSSW; i++) storePr(*x++, exp(prSW[t][iSWt][i]));
 }
 
 
@@ -494,7 +1536,7 @@ void MDPV::CalcTransPrMP(){   //prMP[iMWt][iMPt][iSPt][iTt][iPt][iMP]
             mt=dMP(iMPt,0); ct= pow(rt,2)*pow(ft,2)/qt;
             for(iMP=0; iMP<sizeSMP; iMP++){
               lower= dMP(iMP,1); upper=dMP(iMP,2);
-              prMP[iMWt][iMPt][iSPt][iTt][iPt][iMP] = log( R::pnorm(upper,mt,sqrt(ct),1,0) - R::pnorm(lower,mt,sqrt(ct),1,0)  );
+              prMP[iMWt][iMPt][iSPt][iTt][iPt][iMP] = log( normCdf(upper,mt,sqrt(ct)) - normCdf(lower,mt,sqrt(ct))  );
             }
           }
         }
@@ -545,7 +1587,7 @@ void MDPV::CalcTransPrT(){ //prT[iTt][iPt][iT]
       }
       for(iT=0; iT<sizeST; iT++){
         lower=dT(iT,1); upper=dT(iT,2);
-        prT[iTt][iPt][iT] = log( R::pnorm(upper,mt,sqrt(ct),1,0) - R::pnorm(lower,mt,sqrt(ct),1,0) );
+        prT[iTt][iPt][iT] = log( normCdf(upper,mt,sqrt(ct)) - normCdf(lower,mt,sqrt(ct)) );
       }
     }
   }
@@ -563,18 +1605,18 @@ void MDPV::CalcTransPrP(){ //prP[iPt][iP]
       lower=dP(iP,1); upper=dP(iP,2);
       //if( (uppert<=dryDayTh) & (upper<=dryDayTh) ) prP[iPt][iP]= log(1-prDryWet);
       //if( (lowert>dryDayTh) & (upper<=dryDayTh) ) prP[iPt][iP]= log(1-prWetWet);
-      //if( (uppert<=dryDayTh) & (lower>dryDayTh) ) prP[iPt][iP]= log(prDryWet*( R::pgamma(upper,precShape,precScale,1,0) - R::pgamma(lower,precShape,precScale,1,0)) );
-      //if( (lowert>dryDayTh) & (lower>dryDayTh) ) prP[iPt][iP]= log(prWetWet*( R::pgamma(upper,precShape,precScale,1,0) - R::pgamma(lower,precShape,precScale,1,0) ) );
+      //if( (uppert<=dryDayTh) & (lower>dryDayTh) ) prP[iPt][iP]= log(prDryWet*( gammaCdf(upper,precShape,precScale) - gammaCdf(lower,precShape,precScale)) );
+      //if( (lowert>dryDayTh) & (lower>dryDayTh) ) prP[iPt][iP]= log(prWetWet*( gammaCdf(upper,precShape,precScale) - gammaCdf(lower,precShape,precScale) ) );
 
       // if( (dP(iPt,0)<=dryDayTh) & (dP(iP,0)<=dryDayTh) ) prP[iPt][iP]= log(1-prDryWet);
       // if( (dP(iPt,0)>dryDayTh) & (dP(iP,0)<=dryDayTh) ) prP[iPt][iP]= log(1-prWetWet);
-      // if( (dP(iPt,0)<=dryDayTh) & (dP(iP,0)>dryDayTh) ) prP[iPt][iP]= log(prDryWet*( R::pgamma(upper,precShape,precScale,1,0) - R::pgamma(lower,precShape,precScale,1,0)) );
-      // if( (dP(iPt,0)>dryDayTh) & (dP(iP,0)>dryDayTh) ) prP[iPt][iP]= log(prWetWet*( R::pgamma(upper,precShape,precScale,1,0) - R::pgamma(lower,precShape,precScale,1,0) ) );
+      // if( (dP(iPt,0)<=dryDayTh) & (dP(iP,0)>dryDayTh) ) prP[iPt][iP]= log(prDryWet*( gammaCdf(upper,precShape,precScale) - gammaCdf(lower,precShape,precScale)) );
+      // if( (dP(iPt,0)>dryDayTh) & (dP(iP,0)>dryDayTh) ) prP[iPt][iP]= log(prWetWet*( gammaCdf(upper,precShape,precScale) - gammaCdf(lower,precShape,precScale) ) );
 
       if( (dP(iPt,0)<=dryDayTh) & (dP(iP,0)<=dryDayTh) ) prP[iPt][iP]= log(1-prDryWet);
       if( (dP(iPt,0)>dryDayTh) & (dP(iP,0)<=dryDayTh) ) prP[iPt][iP]= log(1-prWetWet);
-      if( (dP(iPt,0)<=dryDayTh) & (dP(iP,0)>dryDayTh)  ) { if(iP==1)lower=0; prP[iPt][iP]= log(prDryWet*( R::pgamma(upper,precShape,precScale,1,0) - R::pgamma(lower,precShape,precScale,1,0)) ); }
-      if( (dP(iPt,0)>dryDayTh) & (dP(iP,0)>dryDayTh) ) { if(iP==1)lower=0; prP[iPt][iP]= log(prWetWet*( R::pgamma(upper,precShape,precScale,1,0) - R::pgamma(lower,precShape,precScale,1,0) ) ); }
+      if( (dP(iPt,0)<=dryDayTh) & (dP(iP,0)>dryDayTh)  ) { if(iP==1)lower=0; prP[iPt][iP]= log(prDryWet*( gammaCdf(upper,precShape,precScale) - gammaCdf(lower,precShape,precScale)) ); }
+      if( (dP(iPt,0)>dryDayTh) & (dP(iP,0)>dryDayTh) ) { if(iP==1)lower=0; prP[iPt][iP]= log(prWetWet*( gammaCdf(upper,precShape,precScale) - gammaCdf(lower,precShape,precScale) ) ); }
     }
   }
 }
@@ -596,93 +1638,345 @@ double MDPV::Hydro(double & Wt, double & Tt, double Pt){ // ssm.hydro(dMW(iMWt,0
 
 
 // ===================================================
-double MDPV::PrNGSSM(int t, double lower, double upper, double var) { //SOLVED[Reza] : Based on the formulatiom for this probability in the paper, I changed "n" to "nf" (nf is the sample size).
 
-  double probSd, xUpper, xLower;
-  double a, s, alpha, gamma, beta;
-  double G=1;
+long long MDPV::countStatesMDP(){
+  return( (long long)FootprintPlanner(*this).States() + tMax );
+}
+
+// ===================================================
+
+
+void MDPV::printPolicy(const string & fileName){
+  TRACE_SPAN("printPolicy");
+  int t, op, iMW, iSW, iMP, iSP, iT, iP, d;
 
-  double oShape = (double) (nGSSMK-1)/(2);   //shape parameter of observation distribution
-  double iShape = (double) (nGSSMK-1)/(2);//(double) (numSample-3)/(numSample-5); //("shape parameter of prior at t=1"): c_1 in the paper
+  //Store the resalts in the csv files:
+  ofstream  myFile;
+  //myFile.open("C:\\Academic_Postdoc\\Codes\\hmdpTillage\\policyMDP.csv", ios::trunc);
+  myFile.open(fileName.c_str(), ios::trunc);
+  myFile << "statLbl" << ";" << "day" << ";" << "op" << ";" << "d" << ";" << "iMW" << ";" << "iSW" << ";" << "iMP" << ";" << "iSP" << ";" << "iT" << ";" << "iP" << ";" << "optAction" << ";" << "weight" <<endl;
 
-  a = (double) (G * var * ( iShape + oShape*t ) ) / ( iShape + oShape*(t+1) ) ; // location
-  s = a; // scale
-  alpha = oShape; // shape 1
-  gamma = iShape + oShape*t + 1; // shape 2
-  beta =1 ;  // Weibul parameter
-  xUpper = (double) (1)/( 1 + pow ( (double)(upper-a)/(s),-beta ) );
-  xLower = (double) (1)/( 1 + pow ( (double)(lower-a)/(s),-beta ) );
 
-  probSd= R::pbeta(xUpper, alpha, gamma,1, 0) - R::pbeta(xLower, alpha, gamma,1, 0);
-  if( ( R::pbeta(xUpper, alpha, gamma,1, 0) - R::pbeta(xLower, alpha, gamma,1, 0) )<0 ) DBG4("error_minus"<<endl)
-    //if(probSd!=probSd)  DBG4(endl << " Error" << " lower=" << lower << " upper=" << upper << " centerp=" << var <<" t: "<<t<< endl)
-    return (probSd);  // Rf_pgamma(q, shape, scale, lower.tail, log.p)
+  for(t=tMax; t>=1; --t){
+    if(t==tMax){valFunDummy[tMax]=priceYield*yieldHa*fieldArea; continue;}
+    for(op=0; op<opNum; op++){
+      if( (opE[op]>t) || (opL[op]<=t) ) continue;
+      for(d=1; d<=opD[op]; d++){
+        if(opD[op]-t+opE[op]>d) continue;
+        if(opL[op]-t<d) continue;
+        for(iMW=0; iMW<sizeSMW; iMW++){
+          for(iSW=0; iSW<sizeSSW; iSW++){
+            for(iMP=0; iMP<sizeSMP; iMP++){
+              for(iSP=0; iSP<sizeSSP; iSP++){
+                for(iT=0; iT<sizeST; iT++){
+                  for(iP=0; iP<sizeSP; iP++){
+                    label = getLabel(op,d,iMW,iSW,iMP,iSP,iT,iP,t);
+                    myFile << label << ";" << t << ";" << op + 1 << ";" << d << ";" << iMW << ";" <<
+                              iSW << ";" << iMP << ";" << iSP << ";" << iT << ";" << iP << ";" <<
+                              optAction[t][op][d][iMW][iSW][iMP][iSP][iT][iP] << ";" <<
+                              valueFun[t][op][d][iMW][iSW][iMP][iSP][iT][iP] <<endl;
+                  }
+                }
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+  myFile.close();
 }
 
+// ===================================================
+
+void MDPV::writePolicy(const string & fileName){
+  TRACE_SPAN("writePolicy");
+  int t, op, iMW, iSW, iMP, iSP, iT, iP, d, action;
+  vector<int> rec(10);
+  double w;
+  bool ok;
+
+  long long states = countStatesMDP()-tMax;
+  if (states>(long long)UINT32_MAX) throw runtime_error("Too many states to write the policy to " + fileName);
+  FILE* pFile = fopen(fileName.c_str(), "wb");
+  if (pFile==NULL) throw runtime_error("Cannot open " + fileName);
+  int header[9] = {1, tMax, opNum, sizeSMW, sizeSSW, sizeSMP, sizeSSP, sizeST, sizeSP};
+  uint32_t count = (uint32_t)states;   // number of records
+  ok = fwrite(header, sizeof(int), 9, pFile)==9 && fwrite(&count, sizeof(uint32_t), 1, pFile)==1;
+
+  for(t=tMax-1; t>=1 && ok; --t){
+    for(op=0; op<opNum; op++){
+      if( (opE[op]>t) || (opL[op]<=t) ) continue;
+      for(d=1; d<=opD[op]; d++){
+        if(opD[op]-t+opE[op]>d) continue;
+        if(opL[op]-t<d) continue;
+        for(iMW=0; iMW<sizeSMW; iMW++){
+          for(iSW=0; iSW<sizeSSW; iSW++){
+            for(iMP=0; iMP<sizeSMP; iMP++){
+              for(iSP=0; iSP<sizeSSP; iSP++){
+                for(iT=0; iT<sizeST; iT++){
+                  for(iP=0; iP<sizeSP; iP++){
+                    action = actionCode(optAction[t][op][d][iMW][iSW][iMP][iSP][iT][iP]);
+                    rec[0]=t; rec[1]=op+1; rec[2]=d; rec[3]=iMW; rec[4]=iSW; rec[5]=iMP; rec[6]=iSP; rec[7]=iT; rec[8]=iP; rec[9]=action;
+                    w = valueFun[t][op][d][iMW][iSW][iMP][iSP][iT][iP];
+                    if (fwrite(&rec[0], sizeof(int), rec.size(), pFile)!=rec.size()) ok = false;
+                    if (fwrite(&w, sizeof(double), 1, pFile)!=1) ok = false;
+                  }
+                }
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+  if (fclose(pFile)!=0) ok = false;
+  if (!ok) throw runtime_error("Error writing the policy to " + fileName);
+}
 
 // ===================================================
 
-int MDPV::countStatesMDP(){
-  int x, t, iMW, iSW, iMP, iSP, iT, iP, op, d;
-  x=0;
+PolicyTree MDPV::compressPolicy(){
+  int t, op, iMW, iSW, iMP, iSP, iT, iP, d;
+  int sizes[6] = {sizeSMW, sizeSSW, sizeSMP, sizeSSP, sizeST, sizeSP};
+  PolicyTree tree(tMax, opNum, opDMax, vector<int>(sizes, sizes+6));
+  vector<char> acts;
+  int states=0;
 
-  for(t=tMax; t>=1; --t){
-    if(t == tMax)  continue;
+  for(t=tMax-1; t>=1; --t){
     for(op=0; op<opNum; op++){
       if( (opE[op]>t) || (opL[op]<=t) ) continue;
       for(d=1; d<=opD[op]; d++){
-        if(opD[op]-t+opE(op)>d) continue;
+        if(opD[op]-t+opE[op]>d) continue;
         if(opL[op]-t<d) continue;
+        acts.clear();
         for(iMW=0; iMW<sizeSMW; iMW++){
           for(iSW=0; iSW<sizeSSW; iSW++){
             for(iMP=0; iMP<sizeSMP; iMP++){
               for(iSP=0; iSP<sizeSSP; iSP++){
                 for(iT=0; iT<sizeST; iT++){
                   for(iP=0; iP<sizeSP; iP++){
-                    x++;
+                    acts.push_back(actionCode(optAction[t][op][d][iMW][iSW][iMP][iSP][iT][iP]));
                   }
                 }
               }
             }
           }
         }
+        tree.AddSlice(t,op,d,acts);
+        states+=acts.size();
       }
     }
   }
-  return(x+tMax);
+  out << " Policy compressed: " << states << " states in " << tree.Slices() << " slices stored using " << tree.Nodes() << " tree nodes (" << tree.Bytes() << " bytes)." << endl;
+  return(tree);
 }
 
 // ===================================================
 
+void MDPV::setCheckpoint(const string & fileName, bool resumeSolve){
+  checkpointFile=fileName;
+  resume=resumeSolve;
+}
 
-void MDPV::printPolicy(){
-  int t, op, iMW, iSW, iMP, iSP, iT, iP, d;
+// ===================================================
 
-  //Store the resalts in the csv files:
-  ofstream  myFile;
-  //myFile.open("C:\\Academic_Postdoc\\Codes\\hmdpTillage\\policyMDP.csv", ios::trunc);
-  myFile.open("policyMDP.csv", ios::trunc);
-  myFile << "statLbl" << ";" << "day" << ";" << "op" << ";" << "d" << ";" << "iMW" << ";" << "iSW" << ";" << "iMP" << ";" << "iSP" << ";" << "iT" << ";" << "iP" << ";" << "optAction" << ";" << "weight" <<endl;
+void MDPV::setExport(const string & binFile, const string & csvFile){
+  exportBin=binFile;
+  exportCsv=csvFile;
+}
+
+// ===================================================
 
+void MDPV::setStageCallback(void (*callback)(int t)){
+  stageCallback=callback;
+}
 
-  for(t=tMax; t>=1; --t){
-    if(t==tMax){valFunDummy[tMax]=priceYield*yieldHa*fieldArea; continue;}
+// ===================================================
+
+bool ValidationReport::ok() const {
+  for(size_t i=0; i<tables.size(); i++) if( (tables[i].badRows>0) || (tables[i].nan>0) ) return(false);
+  return(true);
+}
+
+// ===================================================
+
+void ValidationReport::print(ostream & out) const {
+  out << "Validation of rewards and trans pr (tolerance " << tol << "):" << endl;
+  for(size_t i=0; i<tables.size(); i++){
+    const Table & tab = tables[i];
+    out << "  " << tab.name << ": rows " << tab.rows << ", bad rows " << tab.badRows << ", max |sum-1| " << tab.maxError
+        << ", NaN " << tab.nan << ", -Inf " << tab.negInf << endl;
+  }
+  out << (ok() ? "  The model is valid." : "  Error: the model is not valid!") << endl;
+}
+
+// ===================================================
+
+/** Add a row of trans pr to a table check and return the row sum.
+ *
+ * @param isLog True if the row holds log trans pr.
+ */
+static double checkRow(const vector<double> & row, bool isLog, ValidationReport::Table & tab, double tol){
+  double sum=0;
+  for(size_t i=0; i<row.size(); i++){
+    if (std::isnan(row[i])) { tab.nan++; continue; }
+    if (isLog && std::isinf(row[i]) && row[i]<0) { tab.negInf++; continue; }
+    sum += isLog ? exp(row[i]) : row[i];
+  }
+  tab.rows++;
+  tab.maxError = max(tab.maxError, fabs(sum-1));
+  if (!(fabs(sum-1)<=tol)) tab.badRows++;
+  return(sum);
+}
+
+// ===================================================
+
+ValidationReport MDPV::Validate(int threads, double tol){
+  int t, iMWt, iSWt, iMPt, iSPt, iTt, iPt, op, k;
+  ValidationReport rep;
+  const char * names[8] = {"prMW", "prSW", "prMP", "prSP", "prT", "prP", "rewDo", "kernel"};
+
+  if(!preprocessed) Preprocess();
+  RestoreTables();   // the double trans pr are validated
+  tol += truncEps;   // the rows of a truncated kernel sum to at least 1-eps
+  rep.tol = tol;
+  rep.tables.resize(8);
+  for(k=0; k<8; k++){
+    ValidationReport::Table & tab = rep.tables[k];
+    tab.name = names[k]; tab.rows = 0; tab.badRows = 0; tab.maxError = 0; tab.nan = 0; tab.negInf = 0;
+  }
+
+  // row sums of the factors
+  vector<double> sMW(sizeSMW*sizeSMP*sizeSSP*sizeST*sizeSP), sMP(sMW.size()), sSP(sizeSMW*sizeSSP*sizeST*sizeSP);
+  vector<double> sSW((tMax+1)*sizeSSW, 1), sT(sizeST*sizeSP), sP(sizeSP);
+  for(iMWt=0, k=0; iMWt<sizeSMW; iMWt++)
+    for(iMPt=0; iMPt<sizeSMP; iMPt++)
+      for(iSPt=0; iSPt<sizeSSP; iSPt++)
+        for(iTt=0; iTt<sizeST; iTt++)
+          for(iPt=0; iPt<sizeSP; iPt++, k++){
+            sMW[k] = checkRow(prMW[iMWt][iMPt][iSPt][iTt][iPt], true, rep.tables[0], tol);
+            sMP[k] = checkRow(prMP[iMWt][iMPt][iSPt][iTt][iPt], true, rep.tables[2], tol);
+          }
+  for(t=1; t<tMax; t++){
+    CalcTransPrSW(t);
+    for(iSWt=0; iSWt<sizeSSW; iSWt++) sSW[t*sizeSSW+iSWt] = checkRow(prSW[t][iSWt], true, rep.tables[1], tol);
+  }
+  for(iMWt=0, k=0; iMWt<sizeSMW; iMWt++)
+    for(iSPt=0; iSPt<sizeSSP; iSPt++)
+      for(iTt=0; iTt<sizeST; iTt++)
+        for(iPt=0; iPt<sizeSP; iPt++, k++) sSP[k] = checkRow(prSP[iMWt][iSPt][iTt][iPt], false, rep.tables[3], tol);
+  for(iTt=0, k=0; iTt<sizeST; iTt++)
+    for(iPt=0; iPt<sizeSP; iPt++, k++) sT[k] = checkRow(prT[iTt][iPt], true, rep.tables[4], tol);
+  for(iPt=0; iPt<sizeSP; iPt++) sP[iPt] = checkRow(prP[iPt], true, rep.tables[5], tol);
+  for(op=0; op<opNum; op++){
+    for(iMWt=0; iMWt<sizeSMW; iMWt++){
+      for(iSWt=0; iSWt<sizeSSW; iSWt++){
+        double r = rewDo[op][iMWt][iSWt];
+        rep.tables[6].rows++;
+        if (std::isnan(r)) rep.tables[6].nan++;
+        if (!std::isfinite(r)) rep.tables[6].badRows++;
+      }
+    }
+  }
+
+  // row sums of the kernel for each parent state (stages split between the threads)
+  if (threads<1) threads = 1;
+  vector<ValidationReport::Table> kernel(threads, rep.tables[7]);
+  RunThreads(threads, [&](int th) {
+      TRACE_SPAN("validate");
+      ValidationReport::Table & tab = kernel[th];
+      for(int t=1+th; t<tMax; t+=threads){
+        for(int iMWt=0; iMWt<sizeSMW; iMWt++)
+          for(int iSWt=0; iSWt<sizeSSW; iSWt++)
+            for(int iMPt=0; iMPt<sizeSMP; iMPt++)
+              for(int iSPt=0; iSPt<sizeSSP; iSPt++)
+                for(int iTt=0; iTt<sizeST; iTt++)
+                  for(int iPt=0; iPt<sizeSP; iPt++){
+                    int iK = (((iMWt*sizeSMP+iMPt)*sizeSSP+iSPt)*sizeST+iTt)*sizeSP+iPt;
+                    int iS = ((iMWt*sizeSSP+iSPt)*sizeST+iTt)*sizeSP+iPt;
+                    double sum = sMW[iK]*sSW[t*sizeSSW+iSWt]*sMP[iK]*sSP[iS]*sT[iTt*sizeSP+iPt]*sP[iPt];
+                    tab.rows++;
+                    tab.maxError = max(tab.maxError, fabs(sum-1));
+                    if (!(fabs(sum-1)<=tol)) tab.badRows++;
+                  }
+      }
+  });
+  for(int th=0; th<threads; th++){
+    rep.tables[7].rows += kernel[th].rows;
+    rep.tables[7].badRows += kernel[th].badRows;
+    rep.tables[7].maxError = max(rep.tables[7].maxError, kernel[th].maxError);
+  }
+  return(rep);
+}
+
+// ===================================================
+
+void MDPV::setPrecision(Precision mode){
+  precision=mode;
+  preprocessed=false;   // the reduced tables are calculated in Preprocess
+  if(mode!=PREC_FLOAT) redF = RedTables<float>();
+  if(mode!=PREC_Q16) redQ = RedTables<unsigned short>();
+}
+
+// ===================================================
+
+MDPV::Precision MDPV::parsePrecision(const string & mode){
+  if (mode=="double") return(PREC_DOUBLE);
+  if (mode=="float") return(PREC_FLOAT);
+  if (mode=="q16") return(PREC_Q16);
+  throw runtime_error("Unknown precision " + mode + " (use double, float or q16)");
+}
+
+// ===================================================
+
+void MDPV::setSampling(int samples, unsigned long long seed){
+  if (samples<0) throw runtime_error("The number of samples must be non-negative");
+  sampleN = samples;
+  sampleSeed = seed;
+  sampleKey = -1;
+}
+
+// ===================================================
+
+double MDPV::initialValue() const {
+  int iMW, iSW, iMP, iSP, iT, iP;
+  int t = (int)opE[0], d = (int)opD[0];
+  double sum = 0;
+
+  for(iMW=0; iMW<sizeSMW; iMW++)
+    for(iSW=0; iSW<sizeSSW; iSW++)
+      for(iMP=0; iMP<sizeSMP; iMP++)
+        for(iSP=0; iSP<sizeSSP; iSP++)
+          for(iT=0; iT<sizeST; iT++)
+            for(iP=0; iP<sizeSP; iP++) sum += valueFun[t][0][d][iMW][iSW][iMP][iSP][iT][iP];
+  return(sum/((double)sizeSMW*sizeSSW*sizeSMP*sizeSSP*sizeST*sizeSP));
+}
+
+// ===================================================
+
+int MDPV::compareSolution(MDPV & ref, double & maxValueDiff, int & actionDiff){
+  int t, op, iMW, iSW, iMP, iSP, iT, iP, d;
+  int n=0;
+
+  if( (ref.tMax!=tMax) || (ref.opNum!=opNum) || (ref.opD!=opD) || (ref.sizeSMW!=sizeSMW) || (ref.sizeSSW!=sizeSSW) ||
+      (ref.sizeSMP!=sizeSMP) || (ref.sizeSSP!=sizeSSP) || (ref.sizeST!=sizeST) || (ref.sizeSP!=sizeSP) )
+    throw runtime_error("Cannot compare solutions of models with different size");
+  maxValueDiff=0;
+  actionDiff=0;
+  for(t=1; t<tMax; t++){
     for(op=0; op<opNum; op++){
-      if( (opE[op]>t) || (opL[op]<=t) ) continue;
       for(d=1; d<=opD[op]; d++){
-        if(opD[op]-t+opE(op)>d) continue;
-        if(opL[op]-t<d) continue;
+        if(!ValidState(t,op,d)) continue;
         for(iMW=0; iMW<sizeSMW; iMW++){
           for(iSW=0; iSW<sizeSSW; iSW++){
             for(iMP=0; iMP<sizeSMP; iMP++){
               for(iSP=0; iSP<sizeSSP; iSP++){
                 for(iT=0; iT<sizeST; iT++){
                   for(iP=0; iP<sizeSP; iP++){
-                    label = getLabel(op,d,iMW,iSW,iMP,iSP,iT,iP,t);
-                    myFile << label << ";" << t << ";" << op + 1 << ";" << d << ";" << iMW << ";" <<
-                              iSW << ";" << iMP << ";" << iSP << ";" << iT << ";" << iP << ";" <<
-                              optAction[t][op][d][iMW][iSW][iMP][iSP][iT][iP] << ";" <<
-                              valueFun[t][op][d][iMW][iSW][iMP][iSP][iT][iP] <<endl;
+                    maxValueDiff = max(maxValueDiff, fabs(valueFun[t][op][d][iMW][iSW][iMP][iSP][iT][iP] - ref.valueFun[t][op][d][iMW][iSW][iMP][iSP][iT][iP]));
+                    if (optAction[t][op][d][iMW][iSW][iMP][iSP][iT][iP]!=ref.optAction[t][op][d][iMW][iSW][iMP][iSP][iT][iP]) actionDiff++;
+                    n++;
                   }
                 }
               }
@@ -692,18 +1986,158 @@ void MDPV::printPolicy(){
       }
     }
   }
-  myFile.close();
+  return(n);
+}
+
+// ===================================================
+
+void MDPV::getStage(int t, vector<double> & vals, vector<char> & acts){
+  int op, iMW, iSW, iMP, iSP, iT, iP, d;
+
+  vals.clear(); acts.clear();
+  for(op=0; op<opNum; op++){
+    if( (opE[op]>t) || (opL[op]<=t) ) continue;
+    for(d=1; d<=opD[op]; d++){
+      if(opD[op]-t+opE[op]>d) continue;
+      if(opL[op]-t<d) continue;
+      for(iMW=0; iMW<sizeSMW; iMW++){
+        for(iSW=0; iSW<sizeSSW; iSW++){
+          for(iMP=0; iMP<sizeSMP; iMP++){
+            for(iSP=0; iSP<sizeSSP; iSP++){
+              for(iT=0; iT<sizeST; iT++){
+                for(iP=0; iP<sizeSP; iP++){
+                  vals.push_back(valueFun[t][op][d][iMW][iSW][iMP][iSP][iT][iP]);
+                  acts.push_back(actionCode(optAction[t][op][d][iMW][iSW][iMP][iSP][iT][iP]));
+                }
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+// ===================================================
+
+void MDPV::setStage(int t, const vector<double> & vals, const vector<char> & acts){
+  int op, iMW, iSW, iMP, iSP, iT, iP, d;
+  int i=0;
+
+  for(op=0; op<opNum; op++){
+    if( (opE[op]>t) || (opL[op]<=t) ) continue;
+    for(d=1; d<=opD[op]; d++){
+      if(opD[op]-t+opE[op]>d) continue;
+      if(opL[op]-t<d) continue;
+      for(iMW=0; iMW<sizeSMW; iMW++){
+        for(iSW=0; iSW<sizeSSW; iSW++){
+          for(iMP=0; iMP<sizeSMP; iMP++){
+            for(iSP=0; iSP<sizeSSP; iSP++){
+              for(iT=0; iT<sizeST; iT++){
+                for(iP=0; iP<sizeSP; iP++){
+                  valueFun[t][op][d][iMW][iSW][iMP][iSP][iT][iP]=vals[i];
+                  optAction[t][op][d][iMW][iSW][iMP][iSP][iT][iP]=actionLabel(acts[i]);
+                  i++;
+                }
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+// ===================================================
+
+unsigned long long MDPV::checkpointTag() const {
+  return(ModelParam::hashSolve(modelHash, precision, truncEps, sampleN, sampleSeed));
+}
+
+// ===================================================
+
+void MDPV::initCheckpoint(int tLast){
+  string tmpFile = checkpointFile + ".tmp";   // the old file is replaced when the new one is complete
+  FILE* pFile = fopen(tmpFile.c_str(), "wb");
+  if (pFile==NULL) throw runtime_error("Cannot open checkpoint file " + tmpFile);
+  unsigned long long tag = checkpointTag();
+  bool ok = fwrite("MDPTCKP1", sizeof(char), 8, pFile)==8 && fwrite(&tag, sizeof(unsigned long long), 1, pFile)==1 &&
+            fwrite(&tMax, sizeof(int), 1, pFile)==1;
+  for(int t=tMax-1; t>=tLast && ok; --t) ok = putCheckpointStage(pFile, t);   // stages loaded (the old file may end with an incomplete stage)
+  if (fclose(pFile)!=0) ok = false;
+  if (!ok || rename(tmpFile.c_str(), checkpointFile.c_str())!=0) {
+    remove(tmpFile.c_str());
+    throw runtime_error("Cannot write checkpoint file " + checkpointFile);
+  }
+}
+
+// ===================================================
+
+void MDPV::writeCheckpointStage(int t){
+  TRACE_SPAN_ARG("checkpoint", t);
+  FILE* pFile = fopen(checkpointFile.c_str(), "ab");
+  if (pFile==NULL) throw runtime_error("Cannot open checkpoint file " + checkpointFile);
+  bool ok = putCheckpointStage(pFile, t);
+  if (fclose(pFile)!=0 || !ok) throw runtime_error("Cannot write checkpoint file " + checkpointFile);
+}
+
+// ===================================================
+
+bool MDPV::putCheckpointStage(FILE* pFile, int t){
+  vector<double> vals;
+  vector<char> acts;
+
+  getStage(t,vals,acts);
+  int n=vals.size();
+  return( fwrite(&t, sizeof(int), 1, pFile)==1 && fwrite(&n, sizeof(int), 1, pFile)==1 &&
+          ( n==0 || (fwrite(&vals[0], sizeof(double), n, pFile)==(size_t)n && fwrite(&acts[0], sizeof(char), n, pFile)==(size_t)n) ) &&
+          fwrite(&t, sizeof(int), 1, pFile)==1 );   // a stage without valid (op,d) slices has no values
 }
 
 // ===================================================
 
-int MDPV::findIndex(double st, arma::mat dis){
-  for(int i=0; i<dis.n_rows; i++){
-    if( ( st>=dis(i,1) ) & ( st<dis(i,2) )  )
-      return(i);
+int MDPV::readCheckpoint(){
+  TRACE_SPAN("readCheckpoint");
+  char magic[8];
+  unsigned long long hash;
+  int tM, t, n, tEnd, tLast=tMax;
+  vector<double> vals;
+  vector<char> acts;
+
+  FILE* pFile = fopen(checkpointFile.c_str(), "rb");
+  if (pFile==NULL) {
+    out << "No checkpoint file " << checkpointFile << " found. Solve from t = " << tMax-1 << endl;
+    return(tMax);
+  }
+  if ( fread(magic, sizeof(char), 8, pFile)!=8 || string(magic,8)!="MDPTCKP1" ||
+       fread(&hash, sizeof(unsigned long long), 1, pFile)!=1 || hash!=checkpointTag() ||
+       fread(&tM, sizeof(int), 1, pFile)!=1 || tM!=tMax ) {
+    out << "Checkpoint file " << checkpointFile << " does not belong to the model and solve settings. Solve from t = " << tMax-1 << endl;
+    fclose(pFile);
+    return(tMax);
+  }
+  while (tLast>1) {
+    getStage(tLast-1,vals,acts);   // get the stage size
+    if ( fread(&t, sizeof(int), 1, pFile)!=1 || t!=tLast-1 ) break;
+    if ( fread(&n, sizeof(int), 1, pFile)!=1 || n!=(int)vals.size() ) break;
+    if ( (n>0) && fread(&vals[0], sizeof(double), n, pFile)!=(size_t)n ) break;
+    if ( (n>0) && fread(&acts[0], sizeof(char), n, pFile)!=(size_t)n ) break;
+    if ( fread(&tEnd, sizeof(int), 1, pFile)!=1 || tEnd!=t ) break;
+    setStage(t,vals,acts);
+    tLast=t;
   }
-  cout<<"error in index: "<< st << " dis " << dis << endl;
-  return(-1);
+  fclose(pFile);
+  if (tLast<tMax) out << "Resume from checkpoint file " << checkpointFile << ". Stages " << tLast << "-" << tMax-1 << " loaded." << endl;
+  else out << "No complete stages in checkpoint file " << checkpointFile << ". Solve from t = " << tMax-1 << endl;
+  return(tLast);
+}
+
+// ===================================================
+
+int MDPV::findIndex(double st, const DisMat & dis){
+  int i = dis.find(st);
+  if(i<0) out<<"error in index: "<< st << " dis " << dis << endl;
+  return(i);
 }
 
 
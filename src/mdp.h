@@ -2,17 +2,77 @@
 #ifndef MDPV_HPP
 #define MDPV_HPP
 
-#include "RcppArmadillo.h"    // we only include RcppArmadillo.h which pulls Rcpp.h in for us
+#include <cmath>
+#include <iostream>
+#include <unordered_map>
 #include "binaryMDPWriter.h"
 #include "time.h"
+#include "param.h"
+#include "distributions.h"
+#include "policyTree.h"
 
-using namespace Rcpp;
 using namespace std;
 
-// via the depends attribute we tell Rcpp to create hooks for
-// RcppArmadillo so that the build process will know what to do
+// ===================================================
+
+/** Transition probabilities (not log) of the factored kernel stored with a reduced precision (see MDPV::setPrecision).
+ *  The tables have the same layout as the corresponding nested vectors (e.g. prMW) flattened in row-major order.
+ */
+template<typename Pr>
+struct RedTables {
+  vector<Pr> MW;   // [iMWt][iMPt][iSPt][iTt][iPt][iMW]
+  vector<Pr> SW;   // [t][iSWt][iSW]
+  vector<Pr> MP;   // [iMWt][iMPt][iSPt][iTt][iPt][iMP]
+  vector<Pr> SP;   // [iMWt][iSPt][iTt][iPt][iSP]
+  vector<Pr> T;    // [iTt][iPt][iT]
+  vector<Pr> P;    // [iPt][iP]
+};
+
+// ===================================================
+
+/** Result of MDPV::Validate. */
+struct ValidationReport {
+
+  /** Check of a table of (log) trans pr. For rewDo the bad rows are the non-finite rewards. */
+  struct Table {
+    string name;
+    long rows;          // number of rows (parent states)
+    long badRows;       // rows not summing to one
+    double maxError;    // max |row sum - 1|
+    long nan;           // number of NaN values
+    long negInf;        // number of -Inf values (log(0), i.e. zero trans pr, counted for information only)
+  };
+
+  vector<Table> tables;   // prMW, prSW, prMP, prSP, prT, prP, rewDo and the kernel (product of the factors)
+  double tol;             // tolerance used for the row sums
+
+  /** True if all rows sum to one and there are no NaN values.
+   *
+   * -Inf values do not make a model invalid: the tables hold log trans pr, so -Inf is a successor with zero trans
+   * pr (e.g. out of reach of the parent or removed by truncation). They are excluded from the row sums, i.e. a row
+   * with -Inf in place of a positive trans pr is found as a bad row.
+   */
+  bool ok() const;
+
+  /** Print the report (one line for each table). */
+  void print(ostream & out) const;
+};
+
+// ===================================================
 
-// [[Rcpp::depends(RcppArmadillo)]]
+/** Statistics of the sampled expectations of a solve (see MDPV::setSampling). */
+struct SampleStats {
+  long long expectations;   // number of sampled expectations
+  double sumSe;             // sum of their standard errors
+  double maxSe;             // max standard error
+  long long decisions;      // number of states where pos. and do. were compared
+  long long close;          // decisions where |value(do.) - value(pos.)| < 1.96 times its standard error
+
+  SampleStats() : expectations(0), sumSe(0), maxSe(0), decisions(0), close(0) {}
+
+  /** Mean standard error of a sampled expectation. */
+  double meanSe() const {return(expectations>0 ? sumSe/expectations : 0);}
+};
 
 // ===================================================
 
@@ -23,35 +83,527 @@ using namespace std;
 */
 class MDPV
 {
+  friend class FieldBatch;
+  friend class PolicyEval;
+  friend class ForwardDist;
+  friend class DistSolver;
+  friend class ForecastMDP;
+  friend class FootprintPlanner;
+  friend class ScalingBenchmark;   // cli/benchmark.h (not part of the R package)
+
   public:  // methods
 
+    /** Storage precision of the transition probabilities used when calculating expectations. */
+    enum Precision {PREC_DOUBLE = 0, PREC_FLOAT = 1, PREC_Q16 = 2};
+
     /** Constructor. Store the parameters.
     *
-    * @param paramModel A list for model parameters related to HMDP and SSMs created using \code{setParam} in R.
+    * @param paramModel Model parameters related to HMDP and SSMs (see \code{setParam} in R).
+    * @param out Stream used for log output.
+    */
+    MDPV(const ModelParam & paramModel, ostream & out = cout);
+
+
+    /** Solve the MDP using value iteration (backward induction).
+    *
+    *  @return The total reward.
+    */
+    double SolveMDP();
+
+
+    /** Re-solve the model after the parameters have changed (rolling horizon planning).
+    *
+    *  The preprocessing tables of the groups with changed parameters (see ModelParam::hashTables) are recomputed.
+    *  The trans pr tables are compared by these group hashes (and a hash of prSW at each day), i.e. the tables of the
+    *  previous solve are not copied; the rewards are compared by value. States (t,op,d,...)
+    *  are only solved again if their rewards or transition probabilities have changed or if the value of one of their
+    *  successors has changed. Otherwise the value function of the previous solve is reused. If a solve setting
+    *  (precision, truncation or sampling) has changed since the previous solve all states are solved again. Stages
+    *  before tStart are not solved.
+    *
+    *  @param paramModel The new parameters. If tMax, the operations or the size of the grids have changed the
+    *    model is solved from scratch.
+    *  @param tStart First day of the planning horizon (e.g. today).
+    *
+    *  @return The total reward.
     */
-    MDPV(const List paramModel);
+    double ResolveMDP(const ModelParam & paramModel, int tStart = 1);
 
 
-    /** Build the HMDP (to binary files). Use "shared linking".
+    /** Find the optimal action and value of a single state without solving the whole model.
     *
-    *  Build a 3 level HMDP saved in binary files by using the
-    *  binaryMDPWriter (c++ version).
+    *  The recursion is evaluated top-down from the state. Only successors with a positive transition probability
+    *  (at least the threshold of setLazyPruning) are evaluated. The value and action of each state are memoized in
+    *  a hash table (the dense value function is not allocated) and so are the expectations over each SW successor,
+    *  i.e. states differing only in iSW share the evaluation of their successors. The memo is kept between calls.
+    *  Stages already solved using SolveMDP or ResolveMDP are used directly. If action elimination is on (see
+    *  setActionElimination) an action is not evaluated if bounds on the values of the stages show that it is
+    *  dominated. The bounds are found by a backward pass over (t,op,d) from the min and max reward and the
+    *  min and max of the value function of the first solved stage.
     *
-    *  @return Build log (string)
-    *  @export
+    *  @param t Current day.
+    *  @param op Tillage operation (zero-based).
+    *  @param d Remaining days for finishing operation op.
+    *  @param iMW, iSW, iMP, iSP, iT, iP Indexes of the remaining state variables.
+    *  @param action The optimal action (empty if the state is not in the model).
+    *
+    *  @return The value function of the state.
+    */
+    double SolveState(int t, int op, int d, int iMW, int iSW, int iMP, int iSP, int iT, int iP, string & action);
+
+
+    /** Print the optimal policy with optimal valur functions in a csv file.
+     *
+     * @param fileName Name of the csv file.
+     */
+    void printPolicy(const string & fileName);
+
+
+    /** Write the optimal policy with optimal value functions to a binary file.
+     *
+     * The file starts with the integers (version, tMax, opNum, sizeSMW, sizeSSW, sizeSMP, sizeSSP, sizeST, sizeSP) and the
+     * number of records n (32 bit unsigned) followed by n records (same order as in printPolicy) each containing the integers (t, op, d, iMW, iSW, iMP, iSP, iT, iP, action)
+     * and a double holding the value function. Here op is one-based as in printPolicy and action is 0 = pos., 1 = do. and 2 = doF.
+     *
+     * @param fileName Name of the binary file.
+     *
+     * Throws std::runtime_error if the file cannot be written.
+     */
+    void writePolicy(const string & fileName);
+
+
+    /** Check if there are states with operation op (zero-based) and d remaining days at day t. */
+    bool ValidState(int t, int op, int d) const {
+      if( (opE[op]>t) || (opL[op]<=t) ) return(false);
+      if( (d<1) || (d>opD[op]) ) return(false);
+      if( (opD[op]-t+opE[op]>d) || (opL[op]-t<d) ) return(false);
+      return(true);
+    }
+
+
+    /** The value function of a state (after solving). The indexes are given as in printPolicy except op is zero-based. */
+    double getValue(int t, int op, int d, int iMW, int iSW, int iMP, int iSP, int iT, int iP) const {
+      return(valueFun[t][op][d][iMW][iSW][iMP][iSP][iT][iP]);
+    }
+
+
+    /** The optimal action of a state (after solving). */
+    const string & getAction(int t, int op, int d, int iMW, int iSW, int iMP, int iSP, int iT, int iP) const {
+      return(optAction[t][op][d][iMW][iSW][iMP][iSP][iT][iP]);
+    }
+
+
+    /** Number of stages (tMax) and operations. */
+    int stages() const {return(tMax);}
+    int operations() const {return(opNum);}
+
+    /** First solved stage, i.e. getValue and getAction are only valid at stages t>=firstSolved() (tMax if not solved). */
+    int firstSolved() const {return(tFirstSolved);}
+
+    /** Number of days needed to complete operation op (zero-based). */
+    int opDays(int op) const {return((int)opD[op]);}
+
+    /** Number of intervals of the state variables (iMW, iSW, iMP, iSP, iT, iP). */
+    vector<int> gridSizes() const {
+      int s[6] = {sizeSMW, sizeSSW, sizeSMP, sizeSSP, sizeST, sizeSP};
+      return(vector<int>(s, s+6));
+    }
+
+
+    /** Count the number of states in the HMDP (closed form, see FootprintPlanner). */
+    long long countStatesMDP();
+
+
+    /** Compress the optimal policy into decision trees (one for each (t,op,d) slice).
+     *
+     * @return The trees. They give the same actions as optAction for all states.
+     */
+    PolicyTree compressPolicy();
+
+
+    /** Store each solved stage in a checkpoint file.
+    *
+    * The file starts with "MDPTCKP1", a tag (unsigned 64 bit integer hash of the parameters and the solve settings,
+    * see ModelParam::hashSolve) and tMax (int).
+    * Each solved stage t is then appended as the integers (t, n) followed by n doubles holding
+    * the value function, n chars holding the optimal action (0 = pos., 1 = do., 2 = doF.) and t again.
+    * States are stored in the same order as in printPolicy.
+    *
+    * @param fileName Name of the checkpoint file ("" = no checkpoints).
+    * @param resumeSolve If true the stages already stored in the file are loaded (if the file
+    *   belongs to the same model and settings) and backward induction continues from the earliest stored stage.
+    *   The file is rewritten with the loaded stages to a temporary file (fileName.tmp) that replaces the old
+    *   file when complete, i.e. an interrupted rewrite does not lose the stored stages.
+    *
+    * SolveMDP throws std::runtime_error if the checkpoint file cannot be written.
     */
-    SEXP SolveMDP();
+    void setCheckpoint(const string & fileName, bool resumeSolve);
+
 
+    /** Write the policy while SolveMDP runs (pipelined export, see PolicyWriter).
+    *
+    * Each stage is written by a background thread as soon as it is solved, overlapping the export with the
+    * solve of the next stages. The files are identical to the ones written by writePolicy and printPolicy.
+    *
+    * @param binFile Name of the binary file ("" = none).
+    * @param csvFile Name of the csv file ("" = none).
+    */
+    void setExport(const string & binFile, const string & csvFile = "");
 
-    /** Count the number of states in the HMDP */
-    int countStatesMDP();
+
+    /** Calculate the preprocessing tables in group g (otherwise calculated when the model is solved). */
+    void calcTables(TableGroup g);
+
+
+    /** Copy the preprocessing tables in group g from another model instead of calculating them.
+    *
+    * @param src A model with the same parameters for group g (see ModelParam::hashTables) and tables in group g calculated.
+    */
+    void copyTables(const MDPV & src, TableGroup g);
+
+
+    /** Number of bytes used by the model when solved using the current precision (value function, optimal actions and
+    * tables, see FootprintPlanner).
+    */
+    double memoryUse();
+
+
+    /** Validate the rewards and trans pr (calculated if needed).
+    *
+    * The rows of each factor of the transition kernel are checked for NaN and -Inf log trans pr and it is checked
+    * that they sum to one. The row sum of the kernel for each parent state (t,iMW,iSW,iMP,iSP,iT,iP) is the
+    * product of the row sums of the factors and is checked in parallel. If check is true in the parameters the
+    * model is validated once in SolveMDP.
+    *
+    * @param threads Number of threads used.
+    * @param tol Tolerance on the row sums (the truncated mass is added if the kernel is truncated, see setTruncation).
+    */
+    ValidationReport Validate(int threads = 1, double tol = 1e-8);
+
+
+    /** Truncate the transition kernel when it is built (must be called before SolveMDP).
+    *
+    * In each row of the factors prMW, prMP, prSP, prT and prP the successors with the lowest trans pr are removed
+    * as long as the removed mass is at most eps/5. Hence at most eps of the mass is removed from a row of the kernel.
+    * The rows are not renormalized. Only the successors between the first and last successor left in a row are
+    * visited when calculating the expectations. After solving, a bound on the error of the value function at each
+    * stage is found (see valueErrorBound).
+    *
+    * @param eps Max probability mass removed from a row of the kernel (0 = exact kernel). Throws
+    *   std::runtime_error if not in [0,1).
+    */
+    void setTruncation(double eps);
+
+
+    /** Bound on the absolute error of the value function at stage t caused by the truncation of the kernel.
+    *
+    * Let delta_t be the max mass removed from a row of the kernel at stage t, S_t the max row sum of the
+    * truncated kernel and M_{t+1} the max absolute value of the solved value function at stage t+1. The error
+    * bound is then e_t = S_t*e_{t+1} + delta_t*(M_{t+1} + e_{t+1}) with e_tMax = 0. Available after SolveMDP or ResolveMDP.
+    */
+    double valueErrorBound(int t = 1) const {return(errBound.empty() ? 0 : errBound[t]);}
+
+
+    /** Skip the expectation of provably dominated actions (default true).
+    *
+    * Before a stage t is solved, the min and max of the value function at stage t+1 are found for each (op,d,iMW).
+    * The expectation of an action is then bounded by a sum over iMW only. If the upper bound of one action is below
+    * the lower bound of the other, only the expectation of the optimal action is calculated. The optimal actions are
+    * the same as without elimination. The number of eliminated actions is written to the log.
+    */
+    void setActionElimination(bool on) {elimination = on;}
+
+
+    /** Skip successors with a small trans pr in SolveState (default 0, i.e. all successors with a positive trans pr).
+    *
+    * A successor is skipped if its SW trans pr or the product of the trans pr of the other factors is below minPr.
+    * The trans pr of the kept successors are scaled up such that the row sums are unchanged, i.e. the value is
+    * approximate. Clears the states memoized by SolveState.
+    */
+    void setLazyPruning(double minPr);
+
+
+    /** Set the storage precision used when solving the model (must be called before SolveMDP).
+    *
+    * With PREC_FLOAT the transition probabilities used in the expectations are stored as float. With PREC_Q16 they
+    * are quantized to 16 bit integers (resolution 1/65535). Sums are accumulated in double and valueFun is kept in
+    * double. After the conversion the double tables prMW and prMP (the large factors) are released, i.e. the model
+    * uses less memory than in double precision. They are recalculated if needed (e.g. by a sampled solve or
+    * PolicyEval, see RestoreTables).
+    */
+    void setPrecision(Precision mode);
+
+
+    /** Convert "double", "float" or "q16" to a precision. Throws std::runtime_error if unknown. */
+    static Precision parsePrecision(const string & mode);
+
+
+    /** Compare the solution with another solve of the same model (e.g. a solve using PREC_DOUBLE).
+    *
+    * @param ref The other model (solved and with the same size).
+    * @param maxValueDiff Max absolute difference in the value function.
+    * @param actionDiff Number of states with a different optimal action.
+    *
+    * @return Number of states compared.
+    */
+    int compareSolution(MDPV & ref, double & maxValueDiff, int & actionDiff);
+
+
+    /** Estimate the expectations by sampling (sample average approximation, must be called before SolveMDP).
+    *
+    * For each parent state (t,iMW,iSW,iMP,iSP,iT,iP) samples successors are drawn from the factored kernel (each
+    * factor by inversion of its row) and the expectation is the row sum of the kernel times the mean value of the
+    * samples. The random numbers only depend on seed and the parent state, i.e. the same successors are used for
+    * both actions (common random numbers) and in each solve with the same seed. The cost of an expectation is
+    * the number of samples instead of the number of successors. Action elimination is not used. Statistics of
+    * the standard errors are available in sampleStats after solving (see also SolveSAA).
+    *
+    * @param samples Number of successors drawn for each parent state (0 = exact expectations).
+    * @param seed Seed of the random numbers.
+    */
+    void setSampling(int samples, unsigned long long seed = 1);
+
+
+    /** Statistics of the sampled expectations of the last solve. */
+    const SampleStats & sampleStats() const {return(sampled);}
+
+
+    /** Mean value function of the initial states (day opE of the first operation with opD days left, uniform over
+    * the grid) after solving.
+    */
+    double initialValue() const;
+
+
+    /** Set a function called each time a stage has been solved (e.g. to check for user interrupts in R).
+    *
+    * @param callback Function called with the current stage as argument. NULL if no function should be called.
+    */
+    void setStageCallback(void (*callback)(int t));
 
 
 private:
 
+  /** Copy the parameters to the class variables. */
+  void SetParameters(const ModelParam & paramModel);
+
+  /** Allocate the arrays for rewards and trans pr (the value function and optimal actions are released). */
+  void Allocate();
+
+  /** Allocate the arrays for the value function and optimal actions.
+  *
+  * @param iMWLo, iMWHi Only the states with iMW in [iMWLo, iMWHi) are allocated (iMWHi = -1 means sizeSMW). Used
+  *   by the workers of a distributed solve (see DistSolver).
+  */
+  void AllocateValues(int iMWLo = 0, int iMWHi = -1);
+
   /** Calculate and fill arrays with rewards and trans pr. */
   void Preprocess();
 
+  /** Truncate the rows of the kernel factors in group g (TAB_SOIL or TAB_WEATHER) and store the removed mass. */
+  void TruncateTables(TableGroup g);
+
+  /** Find the support of each row of the kernel factors and the max removed mass and row sum of the kernel (except prSW). */
+  void CalcSupport();
+
+  /** Calculate the bound on the value function error at each stage (errBound).
+  *
+  * @param maxValue The max absolute value of the value function at each stage (NULL = found from valueFun).
+  */
+  void CalcErrorBound(const vector<double> * maxValue = NULL);
+
+  /** Store the min and max of the value function at stage t for each (op,d,iMW) in vMin and vMax. */
+  void CalcValueBounds(int t);
+
+  /** Lower and upper bound on Expect(t, opN, dN, ...) using vMin and vMax (see setActionElimination). */
+  void BoundExpect(int t, int opN, int dN, int iMWt, int iSWt, int iMPt, int iSPt, int iTt, int iPt, double & lo, double & hi);
+
+
+  /** Find the optimal action and value function of the states at stage t.
+  *
+  * @param t Current day.
+  * @param slices If not NULL only the states with slices[op][d] true are solved.
+  *
+  * @return Number of actions evaluated.
+  */
+  int SolveStage(int t, const vector< vector<char> > * slices = NULL);
+
+
+
+  /** Find the optimal action and value function of a state (stored in optAction and valueFun).
+  *
+  * @return Number of actions evaluated.
+  */
+  int OptimizeState(int & t, int & op, int & d, int & iMW, int & iSW, int & iMP, int & iSP, int & iT, int & iP);
+
+
+  /** Value and optimal action of a state found by SolveState. */
+  struct LazyState {
+    double value;
+    char action;   // see actionCode
+  };
+
+  /** Evaluate a state at a day t<tFirstSolved and its reachable successors recursively (memoized in lazyMemo). */
+  const LazyState & EvalState(int t, int op, int d, int iMW, int iSW, int iMP, int iSP, int iT, int iP);
+
+
+  /** Value of a state in SolveState (zero if terminal or not valid, valueFun if solved, otherwise EvalState). */
+  double LazyValue(int t, int op, int d, int iMW, int iSW, int iMP, int iSP, int iT, int iP);
+
+
+  /** Same as Expect for SolveState. The expectation over the successors of each SW successor is memoized in lazySW. */
+  double LazyExpect(int t, int opN, int dN, int iMWt, int iSWt, int iMPt, int iSPt, int iTt, int iPt);
+
+
+  /** Bounds on LazyExpect using lazyLo and lazyHi (see setActionElimination). */
+  void LazyBound(int t, int opN, int dN, int iMWt, int iSWt, int iMPt, int iSPt, int iTt, int iPt, double & lo, double & hi);
+
+
+  /** Calculate lazyLo and lazyHi for the stages before tFirstSolved. */
+  void CalcLazyBounds();
+
+
+  /** Clear the states memoized by SolveState. */
+  void ClearLazy();
+
+
+  /** The rows of the kernel factors of a parent state (see Row). prMW and prMP use the row rowMW, prSP the row rowSP,
+  *  prT the row rowTP and prP the row iPt (also the index of the rows of the reduced tables and the row sums).
+  */
+  struct KernelRow {
+    int rowMW, rowSP, rowTP, iPt;
+    const int *sMW, *sMP, *sSP, *sT, *sP;         // support [first, last+1) of each factor (see CalcSupport)
+    const double *pMW, *pMP, *pSP, *pT, *pP;      // trans pr (log except prSP), pMW and pMP are NULL if released
+  };
+
+
+  /** The kernel rows of the parent state (iMWt, iSWt, iMPt, iSPt, iTt, iPt) (prSW is the only factor that depends on
+  *  iSWt and t, i.e. it is not part of the row).
+  */
+  KernelRow Row(int iMWt, int iMPt, int iSPt, int iTt, int iPt) const {
+    KernelRow r;
+    r.rowMW = (((iMWt*sizeSMP+iMPt)*sizeSSP+iSPt)*sizeST+iTt)*sizeSP+iPt;
+    r.rowSP = ((iMWt*sizeSSP+iSPt)*sizeST+iTt)*sizeSP+iPt;
+    r.rowTP = iTt*sizeSP+iPt;
+    r.iPt = iPt;
+    r.sMW = &supMW[2*r.rowMW];
+    r.sMP = &supMP[2*r.rowMW];
+    r.sSP = &supSP[2*r.rowSP];
+    r.sT = &supT[2*r.rowTP];
+    r.sP = &supP[2*iPt];
+    r.pMW = prMW.empty() ? NULL : &prMW[iMWt][iMPt][iSPt][iTt][iPt][0];
+    r.pMP = prMP.empty() ? NULL : &prMP[iMWt][iMPt][iSPt][iTt][iPt][0];
+    r.pSP = &prSP[iMWt][iSPt][iTt][iPt][0];
+    r.pT = &prT[iTt][iPt][0];
+    r.pP = &prP[iPt][0];
+    return(r);
+  }
+
+
+  /** Call f(iMW, iMP, iSP, iT, iP, pr) for each successor in the support of a kernel row with pr > 0, where pr is the
+  *  trans pr over all factors except prSW (in double precision). Shared by ExpectSW, LazyExpect,
+  *  PolicyEval and ForwardDist which add the SW factor as Expect does.
+  */
+  template<typename F>
+  void ForSuccessors(const KernelRow & r, F f) const {
+    for(int iMW=r.sMW[0]; iMW<r.sMW[1]; iMW++){
+      for(int iMP=r.sMP[0]; iMP<r.sMP[1]; iMP++){
+        for(int iSP=r.sSP[0]; iSP<r.sSP[1]; iSP++){
+          double prS = r.pSP[iSP];
+          if (prS==0) continue;
+          for(int iT=r.sT[0]; iT<r.sT[1]; iT++){
+            for(int iP=r.sP[0]; iP<r.sP[1]; iP++){
+              double pr = prS*exp(r.pMW[iMW] + r.pMP[iMP] + r.pT[iT] + r.pP[iP]);
+              if (pr>0) f(iMW, iMP, iSP, iT, iP, pr);
+            }
+          }
+        }
+      }
+    }
+  }
+
+
+  /** Call f(iMW, iSW, iMP, iSP, pr) for each soil successor in the support of a kernel row with pr > 0, where pr is
+  *  the trans pr over the soil factors (prMW, prSW of day t, prMP and prSP). Used by the kernels over values
+  *  contracted over the weather (ExpectWeather and ForecastMDP).
+  */
+  template<typename F>
+  void ForSoilSuccessors(const KernelRow & r, int t, int iSWt, F f) const {
+    const double* pSW = &prSW[t][iSWt][0];
+    for(int iMW=r.sMW[0]; iMW<r.sMW[1]; iMW++){
+      for(int iSW=0; iSW<sizeSSW; iSW++){
+        for(int iMP=r.sMP[0]; iMP<r.sMP[1]; iMP++){
+          for(int iSP=r.sSP[0]; iSP<r.sSP[1]; iSP++){
+            double prS = r.pSP[iSP];
+            if (prS==0) continue;
+            double pr = prS*exp(r.pMW[iMW] + pSW[iSW] + r.pMP[iMP]);
+            if (pr>0) f(iMW, iSW, iMP, iSP, pr);
+          }
+        }
+      }
+    }
+  }
+
+
+  /** Expected value function at day t+1 of the successors with operation opN and dN remaining days of a state at day t
+  *  (only the successors in the support of each factor of the kernel).
+  */
+  double Expect(int t, int opN, int dN, int iMWt, int iSWt, int iMPt, int iSPt, int iTt, int iPt);
+
+
+  /** The expectation of Expect over all factors except prSW for each successor iSW. Since prSW only depends on t
+  *  the result is the same for the parent states that only differ in iSWt, i.e. it is cached (two entries, one for
+  *  each action) and Expect only multiplies it with the prSW row.
+  *
+  * @return Pointer to sizeSSW values.
+  */
+  const double* ExpectSW(int t, int opN, int dN, int iMWt, int iMPt, int iSPt, int iTt, int iPt);
+
+
+  /** Same as Expect using the successors drawn by DrawSamples (see setSampling). */
+  double ExpectSample(int t, int opN, int dN, int iMWt, int iSWt, int iMPt, int iSPt, int iTt, int iPt);
+
+
+  /** Draw the successors of a parent state at day t (if not already drawn for the parent). */
+  void DrawSamples(int t, int iMWt, int iSWt, int iMPt, int iSPt, int iTt, int iPt);
+
+
+  /** Count a comparison of pos. and do. in sampled (see SampleStats).
+  *
+  * @param diff value(do.) - value(pos.).
+  * @param paired True if the value of do. is also sampled (the paired samples of both actions are used).
+  */
+  void CountSampleDecision(double diff, bool paired);
+
+
+  /** Same as Expect using the reduced precision tables (only the successors in the support of each factor). The
+  *  expectation over the successors of each SW successor is cached in cacheSW as in ExpectSW.
+  *
+  * @param tab Trans pr with reduced precision.
+  * @param scale Factor converting a stored trans pr into a probability.
+  */
+  template<typename Pr>
+  double ExpectReduced(const RedTables<Pr> & tab, double scale, int t, int opN, int dN, int iMWt, int iSWt, int iMPt, int iSPt, int iTt, int iPt);
+
+
+  /** Same as Expect using the value function contracted over the weather variables (see FieldBatch). */
+  double ExpectWeather(int t, int opN, int dN, int iMWt, int iSWt, int iMPt, int iSPt, int iTt, int iPt);
+
+
+  /** Calculate the reduced precision trans pr from the log trans pr (prMW, prSW, ...). */
+  template<typename Pr>
+  void CalcReduced(RedTables<Pr> & tab);
+
+
+  /** Release the double trans pr prMW and prMP (used after the conversion to a reduced precision). */
+  void ReleaseTables();
+
+
+  /** Recalculate prMW and prMP if they have been released (see ReleaseTables). */
+  void RestoreTables();
+
+
+  /** Allocate prMW and prMP. */
+  void AllocateSoil();
 
 
   /** Calculate the value function for action "pos." related to postpone tillage operation.
@@ -91,6 +643,22 @@ private:
   double weightIni();
 
 
+  /** Set the value of the last operation finished (valFunDummy). */
+  void InitFinalValues();
+
+
+  /** Reward of action pos. */
+  double RewardPos();
+
+
+  /** The completion criterion when the last operation is finished at day tN. */
+  double CompletionCri(int tN);
+
+
+  /** Reward of finishing the last operation at day tN except the reward of action do. (completion criterion and terminal value). */
+  double FinalReward(int tN);
+
+
   /** Calculate the reward values under action Do.
   *
   *  Values are stored in the vector \var(rewDo[op][iMW][iSW]).
@@ -104,13 +672,32 @@ private:
   void CalcTransPrMW();
 
 
-  /** Calculate the transition probability values for estimated standard deviation of soil water content.
+  /** Prepare the transition probability values for estimated standard deviation of soil water content.
   *
-  *  Values are stored in the vector \var(prSW[t][iSWt][iSW]).
+  *  The rows of day t are calculated by CalcTransPrSW(t) the first time they are needed (e.g. when stage t is solved).
   */
   void CalcTransPrSW();
 
 
+  /** Calculate the transition probability values for estimated standard deviation of soil water content at day t
+  *  (if not already calculated) for the variance component (posterior mean of the latent variable) of the non-Gaussian
+  *  SSM based on Theorem 4 in \url(http://www.sciencedirect.com/science/article/pii/S0377221715008802).
+  *
+  *  Values are stored in the vector \var(prSW[t][iSWt][iSW]) and the row sums in rowSumSW. The beta cdf of day t
+  *  is set up once and evaluated once at each interval limit of a row. With a single interval the trans pr is 1.
+  */
+  void CalcTransPrSW(int t);
+
+
+  /** Hash of the trans pr prSW[t] (used by ResolveMDP to find the days with changed rows). */
+  unsigned long long hashSW(int t) const;
+
+
+  /** Store the prSW rows of day t in the reduced precision tables. */
+  template<typename Pr>
+  void StoreReducedSW(RedTables<Pr> & tab, int t);
+
+
   /** Calculate the transition probability values for posterior mean of latent variable (error factor) in Gaussian SSM.
   *
   *  Values are stored in the vector \var(prMP[iMWt][iMPt][iSPt][iTt][iPt][iMP]).
@@ -138,12 +725,6 @@ private:
   */
   void CalcTransPrP();
 
-  /** Print the optimal policy with optimal valur functions in a csv file.
-   *
-   */
-  void printPolicy();
-
-
   /** Calculate the future soil water content based on a rainfall-runoff model given in \url(http://onlinelibrary.wiley.com/doi/10.1002/hyp.6629/abstract).
   *
   * @param Wt The current Soil water content (Volumetric measure)
@@ -154,18 +735,6 @@ private:
   */
   double Hydro(double & Wt, double & Tt, double Pt);
 
-
-  /** Calculate the transition probability for variance component (posterior mean of latent variable) in a non-Gaussian SSM baesd on Theorem 4 in \url(http://www.sciencedirect.com/science/article/pii/S0377221715008802).
-  *
-  * @param t current day.
-  * @param lower Lower limit of a variance component in the next day.
-  * @param upper Upper limit of a variance component in the next day.
-  * @param var Center point of the variance component in the current day.
-  *
-  * @return Transition probability for the variance component at the next day given variance var.
-  */
-  double PrNGSSM(int t, double lower, double upper, double var);
-
   /** Convert integers into a string. */
   string getLabel(const int & a, const int & b, const int & c, const int & d, const int & e, const int & f, const int & g, const int & h) {
     std::ostringstream s;
@@ -187,26 +756,68 @@ private:
    *
    * @return The index number of a specefic interval in dis that includes st.
    */
-  int findIndex(double st, arma::mat dis);
+  int findIndex(double st, const DisMat & dis);
 
-  //----------------------------------------------------------------------------------------------------------------------------------
+  /** Copy the value function and optimal actions of stage t to vectors (same order as in printPolicy). */
+  void getStage(int t, vector<double> & vals, vector<char> & acts);
 
-  private:   // variables
+  /** Set the value function and optimal actions of stage t (reverse of getStage). */
+  void setStage(int t, const vector<double> & vals, const vector<char> & acts);
+
+  /** Create the checkpoint file and write the header and the stages already solved (t>=tLast).
+   *
+   * @param tLast Last stage solved.
+   */
+  void initCheckpoint(int tLast);
 
-    static const double ZERO;  // trans pr below are considered as ZERO
+  /** Append stage t to the checkpoint file. */
+  void writeCheckpointStage(int t);
 
-    arma::vec opSeq;
-    arma::vec opE;
-    arma::vec opL;
-    arma::vec opD;
-    arma::vec opDelay;
-    arma::vec opFixCost;
-    arma::vec watTh;
+  /** Write stage t to an open checkpoint file. Return false if the write failed. */
+  bool putCheckpointStage(FILE* pFile, int t);
 
-    arma::vec watUpper;
-    arma::vec watLower;
-    arma::vec stress;
-    arma::vec strength;
+  /** Tag of the checkpoint file (hash of the parameters and the solve settings). */
+  unsigned long long checkpointTag() const;
+
+  /** Hash of the solve settings (precision, truncation epsilon, number of samples and seed). */
+  unsigned long long settingsTag() const {return(ModelParam::hashSolve(0, precision, truncEps, sampleN, sampleSeed));}
+
+  /** Read the complete stages in the checkpoint file.
+   *
+   * @return The earliest stage read (tMax if no stages could be used).
+   */
+  int readCheckpoint();
+
+  /** Convert an action to its code (0 = pos., 1 = do., 2 = doF.). */
+  static char actionCode(const string & action) {
+    if (action=="pos.") return(0);
+    if (action=="do.") return(1);
+    return(2);
+  }
+
+  /** Convert an action code to the action label. */
+  static string actionLabel(char code) {
+    if (code==0) return("pos.");
+    if (code==1) return("do.");
+    return("doF.");
+  }
+
+  //----------------------------------------------------------------------------------------------------------------------------------
+
+  private:   // variables
+
+    vector<double> opSeq;
+    vector<double> opE;
+    vector<double> opL;
+    vector<double> opD;
+    vector<double> opDelay;
+    vector<double> opFixCost;
+    vector<double> watTh;
+
+    vector<double> watUpper;
+    vector<double> watLower;
+    vector<double> stress;
+    vector<double> strength;
     double weightCompletion;
     double weightWorkable;
     double weightTraffic;
@@ -254,19 +865,19 @@ private:
     bool check;
     bool rewRisk;
 
-    arma::mat dMP;
-    arma::mat dSP;
-    arma::mat dMW;
-    arma::mat dSW;
-    arma::mat dT;
-    arma::mat dP;
+    DisMat dMP;
+    DisMat dSP;
+    DisMat dMW;
+    DisMat dSW;
+    DisMat dT;
+    DisMat dP;
 
-    arma::vec sMP;
-    arma::vec sSP;
-    arma::vec sMW;
-    arma::vec sSW;
-    arma::vec sT;
-    arma::vec sP;
+    vector<double> sMP;
+    vector<double> sSP;
+    vector<double> sMW;
+    vector<double> sSW;
+    vector<double> sT;
+    vector<double> sP;
 
     int sizeSMP;
     int sizeSSP;
@@ -277,8 +888,6 @@ private:
 
     double totalRew;
 
-    vector<flt> pr;
-
 
     vector <vector<vector< vector< vector< vector<double> > > > > > prMW;
     vector <vector<vector< vector< vector< vector<double> > > > > > prMP;
@@ -294,6 +903,59 @@ private:
 
     TimeMan cpuTime;
     string label;
+    ostream & out;  // log output
+
+    unsigned long long modelHash;   // hash of the parameters
+    string checkpointFile;          // checkpoint file ("" = no checkpoints)
+    bool resume;                    // resume from checkpoint file
+    string exportBin, exportCsv;    // policy files written while solving ("" = none)
+    void (*stageCallback)(int t);   // function called after each stage
+    int tFirstSolved;               // stages t>=tFirstSolved hold the value function of the last solve
+    unsigned long long solvedSettings;   // solve settings of the last solve (see settingsTag)
+    int iMWFrom, iMWTo;             // SolveStage only solves the states with iMW in [iMWFrom, iMWTo) (see DistSolver)
+    int opDMax;                     // max number of days needed to complete an operation
+    bool preprocessed;              // true if the rewards and trans pr are calculated
+    bool tablesReady[TAB_GROUPS];   // true if the tables in a group are calculated (or copied)
+    unsigned long long tableHash[TAB_GROUPS];   // hash of the parameters of the tables in each group
+    unordered_map<long long, LazyState> lazyMemo;        // states evaluated by SolveState
+    unordered_map<long long, vector<double> > lazySW;    // expectation over the successors of each SW successor [iSW] (NaN if not evaluated), key as in ExpectSW
+    double lazyPrune;                   // successors with a trans pr below are skipped by SolveState
+    vector<double> lazyLo, lazyHi;      // bounds on the value function [t][op][d] used by SolveState
+    int lazyBoundsFrom;                 // tFirstSolved when lazyLo and lazyHi were calculated
+
+    Precision precision;                // storage precision used in the expectations
+    RedTables<float> redF;              // trans pr stored as float (PREC_FLOAT)
+    RedTables<unsigned short> redQ;     // trans pr quantized to 16 bit (PREC_Q16)
+    vector<double> weatherSlab;         // value function of stage weatherStage contracted over (iT,iP) [op][d][iTt][iPt][iMW][iSW][iMP][iSP]
+    int weatherStage;                   // stage stored in weatherSlab (-1 if none)
+
+    double truncEps;                    // max mass removed from a row of the kernel
+    double tablesTrunc[TAB_GROUPS];     // eps used when truncating the tables in a group
+    vector<double> cutMW, cutMP, cutSP, cutT, cutP;   // mass removed from each row of the factors
+    vector<int> supMW, supMP, supSP, supT, supP;      // first and last+1 successor with positive trans pr in each row
+    double kernelCut;                   // max mass removed from a row of the kernel (except prSW)
+    double kernelSum;                   // max row sum of the (truncated) kernel (except prSW)
+    vector<double> errBound;            // bound on the value function error at stage t
+    vector<double> rowSumMW, rowSumMP, rowSumSP, rowSumT, rowSumP;   // row sums of the (truncated) factors
+    vector<double> rowSumSW;            // row sums of prSW [t][iSWt]
+    vector<char> readySW;               // true if prSW[t] and rowSumSW of day t are calculated
+    long long keySW[2];                 // key (t,opN,dN,rowMW) of the cached ExpectSW results (-1 = none)
+    vector<double> cacheSW[2];          // cached ExpectSW results
+    int nextSW;                         // cache entry replaced next
+
+    bool elimination;                   // skip dominated actions using bounds
+    int boundStage;                     // stage stored in vMin and vMax (-1 if none)
+    vector<double> vMin, vMax;          // min and max of the value function at stage boundStage [op][d][iMW]
+    long long eliminated;               // number of actions eliminated in the last solve
+
+    int sampleN;                        // successors drawn for each parent state (0 = exact expectations)
+    unsigned long long sampleSeed;      // seed of the random numbers
+    long long sampleKey;                // parent state (t,iSWt,rowMW) of the drawn successors (-1 = none)
+    vector<int> sampleIdx;              // drawn successors [i][iMW,iSW,iMP,iSP,iT,iP]
+    double sampleMass;                  // row sum of the kernel of the parent
+    vector<double> sampleVal[2];        // sampled values of the two expectations (pos., do.) of the parent
+    int sampleSlot;                     // entry of sampleVal used by the next expectation
+    SampleStats sampled;                // statistics of the last solve
 };
 
 
@@ -0,0 +1,58 @@
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Thread helpers shared by the parallel solvers (Ensemble, FieldBatch, PolicyEval, ForecastMDP and
+// MDPV::Validate). An exception thrown in a thread is caught there and rethrown in the calling thread, i.e. it is
+// never left to std::terminate.
+//
+// Example. ParallelFor(threads, n, [&](long long from, long long to) { ... });   // items [from, to) of a thread
+//-----------------------------------------------------------------------------
+
+/** Run f(k) for k = 0, ..., threads-1 in separate threads (in the calling thread if threads is 1) and wait for them.
+ *
+ * If f throws in some threads the first exception caught is rethrown after all threads have finished.
+ */
+template<typename F>
+void RunThreads(int threads, F f) {
+  if (threads<=1) {
+    f(0);
+    return;
+  }
+  vector<thread> pool;
+  exception_ptr error;
+  mutex errorLock;
+  try {
+    for(int k=0; k<threads; k++){
+      pool.push_back(thread([&f, &error, &errorLock, k]() {
+        try {
+          f(k);
+        } catch (...) {
+          lock_guard<mutex> lk(errorLock);
+          if (!error) error = current_exception();
+        }
+      }));
+    }
+  } catch (...) {   // a thread could not be started
+    for(size_t k=0; k<pool.size(); k++) pool[k].join();
+    throw;
+  }
+  for(size_t k=0; k<pool.size(); k++) pool[k].join();
+  if (error) rethrow_exception(error);
+}
+
+/** Run f(from, to) on the items [0, n) split in a contiguous block for each thread (see RunThreads). */
+template<typename F>
+void ParallelFor(int threads, long long n, F f) {
+  if (threads<1) threads = 1;
+  RunThreads(threads, [&f, n, threads](int k) { f(n*k/threads, n*(k+1)/threads); });
+}
+
+
+#endif
@@ -0,0 +1,197 @@
+#include "param.h"
+#include "basicdt.h"
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+// ===================================================
+
+/** Find the values of a parameter (throw an error if not given). */
+static const vector<double> & getValues(const ParamMap & values, const string & name){
+  ParamMap::const_iterator it = values.find(name);
+  if (it == values.end() || it->second.empty())
+    throw runtime_error("Parameter " + name + " is missing!");
+  return(it->second);
+}
+
+static double getScalar(const ParamMap & values, const string & name){
+  return(getValues(values, name)[0]);
+}
+
+static DisMat getMat(const ParamMap & values, const string & name){
+  const vector<double> & v = getValues(values, name);
+  if (v.size() % 3 != 0)
+    throw runtime_error("Discretization matrix " + name + " must have 3 columns!");
+  return(DisMat(v));
+}
+
+// ===================================================
+
+ModelParam::ModelParam(const ParamMap & values){
+  opNum=(int)getScalar(values,"opNum");
+  tMax=(int)getScalar(values,"tMax");
+  opSeq=getValues(values,"opSeq");
+  opE=getValues(values,"opE");
+  opL=getValues(values,"opL");
+  opD=getValues(values,"opD");
+  opDelay=getValues(values,"opDelay");
+  opFixCost=getValues(values,"opFixCost");
+  watTh=getValues(values,"watTh");
+  coefLoss=getScalar(values,"coefLoss");
+  priceYield=getScalar(values,"priceYield");
+  machCap=getScalar(values,"machCap");
+  yieldHa=getScalar(values,"yieldHa");
+  fieldArea=getScalar(values,"fieldArea");
+  coefTimeliness=getScalar(values,"coefTimeliness");
+  costSkip=getScalar(values,"costSkip");
+
+  watUpper=getValues(values,"watUpper");
+  watLower=getValues(values,"watLower");
+  stress=getValues(values,"stress");
+  strength=getValues(values,"strength");
+  weightCompletion=getScalar(values,"weightCompletion");
+  weightWorkable=getScalar(values,"weightWorkable");
+  weightTraffic=getScalar(values,"weightTraffic");
+  minOpt=(int)getScalar(values,"minOpt");
+  maxOpt=(int)getScalar(values,"maxOpt");
+
+  temMeanDry=getScalar(values,"temMeanDry");
+  temMeanWet=getScalar(values,"temMeanWet");
+  temVarDry=getScalar(values,"temVarDry");
+  temVarWet=getScalar(values,"temVarWet");
+  dryDayTh=getScalar(values,"dryDayTh");
+  precShape=getScalar(values,"precShape");
+  precScale=getScalar(values,"precScale");
+  prDryWet=getScalar(values,"prDryWet");
+  prWetWet=getScalar(values,"prWetWet");
+
+  hydroWatR=getScalar(values,"hydroWatR");
+  hydroWatS=getScalar(values,"hydroWatS");
+  hydroM=getScalar(values,"hydroM");
+  hydroKs=getScalar(values,"hydroKs");
+  hydroFi=getScalar(values,"hydroFi");
+  hydroLamba=getScalar(values,"hydroLamba");
+  hydroETa=getScalar(values,"hydroETa");
+  hydroETb=getScalar(values,"hydroETb");
+  hydroETx=getScalar(values,"hydroETx");
+
+  gSSMW=getScalar(values,"gSSMW");
+  gSSMV=getScalar(values,"gSSMV");
+  gSSMm0=getScalar(values,"gSSMm0");
+  gSSMc0=getScalar(values,"gSSMc0");
+  nGSSMm0=getScalar(values,"nGSSMm0");
+  nGSSMc0=getScalar(values,"nGSSMc0");
+  nGSSMK=getScalar(values,"nGSSMK");
+
+  check = getScalar(values,"check")!=0;
+  rewRisk = getScalar(values,"rewRisk")!=0;
+
+  disMeanPos = getMat(values,"disMeanPos");
+  disSdPos = getMat(values,"disSdPos");
+  disAvgWat = getMat(values,"disAvgWat");
+  disSdWat = getMat(values,"disSdWat");
+  disTem = getMat(values,"disTem");
+  disPre = getMat(values,"disPre");
+
+  centerPointsMeanPos = getValues(values,"centerPointsMeanPos");
+  centerPointsSdPos = getValues(values,"centerPointsSdPos");
+  centerPointsAvgWat = getValues(values,"centerPointsAvgWat");
+  centerPointsSdWat = getValues(values,"centerPointsSdWat");
+  centerPointsTem = getValues(values,"centerPointsTem");
+  centerPointsPre = getValues(values,"centerPointsPre");
+}
+
+// ===================================================
+
+ParamMap readParamFile(const string & fileName){
+  ifstream file(fileName.c_str());
+  if (!file) throw runtime_error("Cannot open parameter file " + fileName);
+
+  ParamMap values;
+  string line, name, token;
+  int lineNo = 0;
+  while (getline(file, line)) {
+    lineNo++;
+    size_t pos = line.find('#');
+    if (pos != string::npos) line.erase(pos);
+    istringstream s(line);
+    if (!(s >> name)) continue;   // empty line
+    vector<double> & v = values[name];
+    v.clear();
+    while (s >> token) {
+      if (token == "TRUE") v.push_back(1);
+      else if (token == "FALSE") v.push_back(0);
+      else {
+        double x;
+        if (!from_string(x, token, std::dec))
+          throw runtime_error("Cannot read value " + token + " of " + name + " (line " + ToString(lineNo) + ") in " + fileName);
+        v.push_back(x);
+      }
+    }
+  }
+  return(values);
+}
+
+// ===================================================
+
+unsigned long long ModelParam::hash() const {
+  FNVHash f;
+  f.add(opNum); f.add(tMax); f.add(opSeq); f.add(opE); f.add(opL); f.add(opD); f.add(opDelay); f.add(opFixCost); f.add(watTh);
+  f.add(coefLoss); f.add(priceYield); f.add(machCap); f.add(yieldHa); f.add(fieldArea); f.add(coefTimeliness); f.add(costSkip);
+  f.add(watUpper); f.add(watLower); f.add(stress); f.add(strength);
+  f.add(weightCompletion); f.add(weightWorkable); f.add(weightTraffic); f.add(minOpt); f.add(maxOpt);
+  f.add(temMeanDry); f.add(temMeanWet); f.add(temVarDry); f.add(temVarWet); f.add(dryDayTh); f.add(precShape); f.add(precScale);
+  f.add(prDryWet); f.add(prWetWet);
+  f.add(hydroWatR); f.add(hydroWatS); f.add(hydroM); f.add(hydroKs); f.add(hydroFi); f.add(hydroLamba); f.add(hydroETa); f.add(hydroETb); f.add(hydroETx);
+  f.add(gSSMW); f.add(gSSMV); f.add(gSSMm0); f.add(gSSMc0); f.add(nGSSMm0); f.add(nGSSMc0); f.add(nGSSMK);
+  f.add(rewRisk);
+  f.add(disMeanPos); f.add(disSdPos); f.add(disAvgWat); f.add(disSdWat); f.add(disTem); f.add(disPre);
+  return(f.h);
+}
+
+// ===================================================
+
+unsigned long long ModelParam::hashSolve(unsigned long long paramHash, int precision, double truncEps, int sampleN, unsigned long long seed) {
+  FNVHash f;
+  f.add(&paramHash, sizeof(paramHash));
+  f.add(precision); f.add(truncEps); f.add(sampleN); f.add(&seed, sizeof(seed));
+  return(f.h);
+}
+
+// ===================================================
+
+double ModelParam::hydro(double Wt, double Tt, double Pt) const {
+  double ET = hydroETa + hydroETb*hydroETx*(0.46*Tt + 8.13);
+  double f = Pt*(1- pow((Wt-hydroWatR)/(hydroWatS-hydroWatR),hydroM) );
+  double g = hydroKs*pow((Wt-hydroWatR)/(hydroWatS-hydroWatR),3+2/hydroLamba);
+  double e = ET*(Wt-hydroWatR)/(hydroWatS-hydroWatR);
+  return(Wt+f-e-g);
+}
+
+// ===================================================
+
+unsigned long long ModelParam::hashTables(TableGroup g) const {
+  FNVHash f;
+  f.add(g);
+  if (g==TAB_SOIL) {
+    f.add(hydroWatR); f.add(hydroWatS); f.add(hydroM); f.add(hydroKs); f.add(hydroFi); f.add(hydroLamba); f.add(hydroETa); f.add(hydroETb); f.add(hydroETx);
+    f.add(gSSMW); f.add(gSSMV);
+    f.add(disAvgWat); f.add(disMeanPos); f.add(disSdPos); f.add(disTem); f.add(disPre);
+  }
+  if (g==TAB_SW) {
+    f.add(tMax); f.add(nGSSMm0); f.add(nGSSMc0); f.add(nGSSMK);
+    f.add(disSdWat);
+  }
+  if (g==TAB_WEATHER) {
+    f.add(temMeanDry); f.add(temMeanWet); f.add(temVarDry); f.add(temVarWet); f.add(dryDayTh); f.add(precShape); f.add(precScale);
+    f.add(prDryWet); f.add(prWetWet);
+    f.add(disTem); f.add(disPre);
+  }
+  if (g==TAB_REWARD) {
+    f.add(opNum); f.add(rewRisk); f.add(watTh); f.add(watUpper); f.add(watLower); f.add(stress); f.add(strength);
+    f.add(weightWorkable); f.add(weightTraffic); f.add(coefLoss); f.add(priceYield); f.add(yieldHa); f.add(machCap);
+    f.add(disAvgWat); f.add(disSdWat);
+  }
+  return(f.h);
+}
@@ -0,0 +1,222 @@
+#ifndef PARAM_HPP
+#define PARAM_HPP
+
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// ===================================================
+
+/** Parameter values keyed by the names used in the list returned by \code{setParam} in R.
+ *
+ * Scalars are stored as vectors of length one and discretization matrices are
+ * stored row-wise, i.e. (center, lower, upper) for each interval.
+ */
+typedef map<string, vector<double> > ParamMap;
+
+// ===================================================
+
+/**
+* Discretization matrix of a continuous state variable. Row i holds the center point,
+* lower and upper limit of interval i (same layout as the matrices created by \code{setParam}).
+*/
+class DisMat
+{
+  public:
+
+    DisMat() : n_rows(0) {}
+
+    /** Constructor.
+    *
+    * @param rowWise Values given row-wise (center, lower, upper, center, lower, ...).
+    */
+    DisMat(const vector<double> & rowWise) : n_rows(rowWise.size()/3), val(rowWise) {}
+
+    double & operator()(int i, int j) {return val[3*i+j];}
+    double operator()(int i, int j) const {return val[3*i+j];}
+
+    /** Find the interval [lower, upper) containing x using binary search (the intervals must be sorted).
+    *
+    * @return The index of the interval or -1 if x is outside the intervals or NaN.
+    */
+    int find(double x) const {
+      int lo = 0, n = n_rows;
+      while (n>1) {
+        int half = n/2;
+        lo = (val[3*(lo+half)+1] <= x) ? lo+half : lo;   // compiled to a conditional move
+        n -= half;
+      }
+      if ( (n_rows==0) || !( (x>=val[3*lo+1]) && (x<val[3*lo+2]) ) ) return(-1);   // fails for NaN
+      return(lo);
+    }
+
+    int n_rows;   ///< Number of intervals.
+
+  private:
+    vector<double> val;
+};
+
+/** Print a discretization matrix (one interval per line). */
+inline ostream & operator<<(ostream & s, const DisMat & dis) {
+  for (int i=0; i<dis.n_rows; i++) s << dis(i,0) << " " << dis(i,1) << " " << dis(i,2) << endl;
+  return(s);
+}
+
+// ===================================================
+
+/** Hash values using the 64 bit FNV-1a algorithm. */
+class FNVHash
+{
+  public:
+    FNVHash() : h(14695981039346656037ULL) {}
+
+    void add(const void * p, size_t n) {
+      const unsigned char * c = (const unsigned char *)p;
+      for (size_t i=0; i<n; i++) { h ^= c[i]; h *= 1099511628211ULL; }
+    }
+    void add(double x) { add(&x, sizeof(double)); }
+    void add(const vector<double> & v) { add((double)v.size()); if (!v.empty()) add(&v[0], v.size()*sizeof(double)); }
+    void add(const DisMat & m) { for (int i=0; i<m.n_rows; i++) for (int j=0; j<3; j++) add(m(i,j)); }
+
+    unsigned long long h;
+};
+
+// ===================================================
+
+/** Groups of preprocessing tables in MDPV that depend on different parameters. */
+enum TableGroup {
+  TAB_SOIL = 0,     ///< prMW, prMP and prSP (soil water SSM, hydro model and grids)
+  TAB_SW = 1,       ///< prSW (non-Gaussian SSM)
+  TAB_WEATHER = 2,  ///< prT and prP (weather statistics)
+  TAB_REWARD = 3,   ///< rewDo
+  TAB_GROUPS = 4    ///< number of groups
+};
+
+// ===================================================
+
+/**
+* Parameters of the MDP model (the R independent version of the list created using \code{setParam}).
+*
+* @author Reza Pourmoayed
+*/
+struct ModelParam
+{
+  /** Default constructor. */
+  ModelParam() {}
+
+  /** Constructor. Copy the parameters from a parameter map.
+  *
+  * @param values Parameter values keyed by the names used in \code{setParam}.
+  */
+  ModelParam(const ParamMap & values);
+
+  /** Hash of all parameter values (FNV-1a). Used to check that e.g. a checkpoint file belongs to the model. */
+  unsigned long long hash() const;
+
+  /** Hash of a parameter hash and the solve settings that change the value function (precision, truncation
+  * epsilon, number of samples and seed). Used to tag checkpoint files.
+  */
+  static unsigned long long hashSolve(unsigned long long paramHash, int precision, double truncEps, int sampleN, unsigned long long seed);
+
+  /** Hash of the parameters used to calculate the tables in group g. Models with the same hash have identical tables. */
+  unsigned long long hashTables(TableGroup g) const;
+
+  /** Prediction of the soil water content at day t+1 using the hydro model (same as MDPV::Hydro and Hydro in R).
+  *
+  * @param Wt Soil water content at day t.
+  * @param Tt Temperature between day t and t+1.
+  * @param Pt Precipitation between day t and t+1.
+  */
+  double hydro(double Wt, double Tt, double Pt) const;
+
+  int opNum;
+  int tMax;
+  vector<double> opSeq;
+  vector<double> opE;
+  vector<double> opL;
+  vector<double> opD;
+  vector<double> opDelay;
+  vector<double> opFixCost;
+  vector<double> watTh;
+  double coefLoss;
+  double priceYield;
+  double machCap;
+  double yieldHa;
+  double fieldArea;
+  double coefTimeliness;
+  double costSkip;
+
+  vector<double> watUpper;
+  vector<double> watLower;
+  vector<double> stress;
+  vector<double> strength;
+  double weightCompletion;
+  double weightWorkable;
+  double weightTraffic;
+  int minOpt;
+  int maxOpt;
+
+  double temMeanDry;
+  double temMeanWet;
+  double temVarDry;
+  double temVarWet;
+  double dryDayTh;
+  double precShape;
+  double precScale;
+  double prDryWet;
+  double prWetWet;
+
+  double hydroWatR;
+  double hydroWatS;
+  double hydroM;
+  double hydroKs;
+  double hydroFi;
+  double hydroLamba;
+  double hydroETa;
+  double hydroETb;
+  double hydroETx;
+
+  double gSSMW;
+  double gSSMV;
+  double gSSMm0;
+  double gSSMc0;
+  double nGSSMm0;
+  double nGSSMc0;
+  double nGSSMK;
+
+  bool check;
+  bool rewRisk;
+
+  DisMat disMeanPos;
+  DisMat disSdPos;
+  DisMat disAvgWat;
+  DisMat disSdWat;
+  DisMat disTem;
+  DisMat disPre;
+
+  vector<double> centerPointsMeanPos;
+  vector<double> centerPointsSdPos;
+  vector<double> centerPointsAvgWat;
+  vector<double> centerPointsSdWat;
+  vector<double> centerPointsTem;
+  vector<double> centerPointsPre;
+};
+
+// ===================================================
+
+/** Read a parameter file.
+ *
+ * Each line contains a parameter name followed by its values separated by white space,
+ * e.g. "opD 6 4 4 4". Discretization matrices (\code{disAvgWat}, \code{disTem}, ...) are
+ * given row-wise. Text after a # is ignored. The file can be created with \code{writeParamFile} in R.
+ *
+ * @param fileName Name of the parameter file.
+ *
+ * @return The parameter values. Throws std::runtime_error if the file cannot be read.
+ */
+ParamMap readParamFile(const string & fileName);
+
+
+#endif
@@ -0,0 +1,204 @@
+#include "policyEval.h"
+#include "parallel.h"
+#include "trace.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+// ===================================================
+
+PolicyEval::PolicyEval(MDPV & model, ostream & out) : m(model), out(out) {
+  sizeG = m.sizeSMW*m.sizeSSW*m.sizeSMP*m.sizeSSP*m.sizeST*m.sizeSP;
+  sizeSlab = m.opNum*(m.opDMax+1)*sizeG;
+}
+
+// ===================================================
+
+int PolicyEval::AddCalendar(const vector<double> & firstDay){
+  if ((int)firstDay.size()!=m.opNum) throw runtime_error("A calendar rule needs a first day for each operation");
+  ostringstream s;
+  s << "calendar";
+  for(size_t i=0; i<firstDay.size(); i++) s << " " << firstDay[i];
+  names.push_back(s.str());
+  types.push_back(RULE_CALENDAR);
+  par.push_back(firstDay);
+  tables.push_back(vector<char>());
+  return(names.size()-1);
+}
+
+// ===================================================
+
+int PolicyEval::AddThreshold(const vector<double> & watMax){
+  if ((int)watMax.size()!=m.opNum) throw runtime_error("A threshold rule needs a threshold for each operation");
+  ostringstream s;
+  s << "threshold";
+  for(size_t i=0; i<watMax.size(); i++) s << " " << watMax[i];
+  names.push_back(s.str());
+  types.push_back(RULE_THRESHOLD);
+  par.push_back(watMax);
+  tables.push_back(vector<char>());
+  return(names.size()-1);
+}
+
+// ===================================================
+
+int PolicyEval::AddTable(const string & fileName){
+  FILE* pFile = fopen(fileName.c_str(), "rb");
+  if (pFile==NULL) throw runtime_error("Cannot open policy file " + fileName);
+  int header[9], rec[10];
+  uint32_t count;
+  double w;
+  if ( fread(header, sizeof(int), 9, pFile)!=9 || fread(&count, sizeof(uint32_t), 1, pFile)!=1 || header[1]!=m.tMax || header[2]!=m.opNum || header[3]!=m.sizeSMW ||
+       header[4]!=m.sizeSSW || header[5]!=m.sizeSMP || header[6]!=m.sizeSSP || header[7]!=m.sizeST || header[8]!=m.sizeSP ) {
+    fclose(pFile);
+    throw runtime_error("The policy file " + fileName + " does not match the model");
+  }
+  vector<char> tab((size_t)m.tMax*sizeSlab, 0);
+  for(uint32_t i=0; i<count; i++){
+    if ( fread(rec, sizeof(int), 10, pFile)!=10 || fread(&w, sizeof(double), 1, pFile)!=1 ) {
+      fclose(pFile);
+      throw runtime_error("The policy file " + fileName + " is truncated");
+    }
+    int t = rec[0], op = rec[1]-1, d = rec[2];
+    if ( (t<1) || (t>=m.tMax) || (op<0) || (op>=m.opNum) || (d<0) || (d>m.opDMax) ) continue;
+    int g = ((((rec[3]*m.sizeSSW+rec[4])*m.sizeSMP+rec[5])*m.sizeSSP+rec[6])*m.sizeST+rec[7])*m.sizeSP+rec[8];
+    tab[(size_t)t*sizeSlab+(op*(m.opDMax+1)+d)*sizeG+g] = (rec[9]>0);
+  }
+  fclose(pFile);
+  names.push_back("table " + fileName);
+  types.push_back(RULE_TABLE);
+  par.push_back(vector<double>());
+  tables.push_back(tab);
+  return(names.size()-1);
+}
+
+// ===================================================
+
+int PolicyEval::AddOptimal(){
+  if (m.valueFun.empty() || m.tFirstSolved>1) throw runtime_error("The model must be solved to evaluate the optimal policy");
+  int t, op, d, iMW, iSW, iMP, iSP, iT, iP;
+  vector<char> tab((size_t)m.tMax*sizeSlab, 0);
+  for(t=1; t<m.tMax; t++){
+    for(op=0; op<m.opNum; op++){
+      for(d=1; d<=m.opD[op]; d++){
+        if(!m.ValidState(t,op,d)) continue;
+        char* a = &tab[(size_t)t*sizeSlab+(op*(m.opDMax+1)+d)*sizeG];
+        for(iMW=0; iMW<m.sizeSMW; iMW++)
+          for(iSW=0; iSW<m.sizeSSW; iSW++)
+            for(iMP=0; iMP<m.sizeSMP; iMP++)
+              for(iSP=0; iSP<m.sizeSSP; iSP++)
+                for(iT=0; iT<m.sizeST; iT++)
+                  for(iP=0; iP<m.sizeSP; iP++) *a++ = (m.optAction[t][op][d][iMW][iSW][iMP][iSP][iT][iP]!="pos.");
+      }
+    }
+  }
+  names.push_back("optimal");
+  types.push_back(RULE_TABLE);
+  par.push_back(vector<double>());
+  tables.push_back(tab);
+  return(names.size()-1);
+}
+
+// ===================================================
+
+char PolicyEval::Action(int k, int t, int op, int d, int g, int iMW) const {
+  if (types[k]==RULE_CALENDAR) return(t>=par[k][op]);
+  if (types[k]==RULE_THRESHOLD) return(m.sMW[iMW]<=par[k][op]);
+  return(tables[k][(size_t)t*sizeSlab+(op*(m.opDMax+1)+d)*sizeG+g]);
+}
+
+// ===================================================
+
+vector<double> PolicyEval::Evaluate(int threads){
+  int n = Size(), t, op, d;
+  vector<double> mean(n, 0);
+
+  if (threads<=0) threads = thread::hardware_concurrency();
+  if (threads<=0) threads = 1;
+  if (!m.preprocessed) m.Preprocess();
+  m.RestoreTables();   // released in reduced precision
+  m.InitFinalValues();
+  out << "Evaluate " << n << " policies using " << threads << " threads." << endl;
+
+  cur.assign(n, vector<double>(sizeSlab, 0));
+  next.assign(n, vector<double>(sizeSlab, 0));   // the value at stage tMax is zero
+  initial.assign(n, vector<double>(sizeG, 0));
+  int t0 = (int)m.opE[0], d0 = (int)m.opD[0];
+  for(t=m.tMax-1; t>=t0; --t){
+    for(int k=0; k<n; k++) fill(cur[k].begin(), cur[k].end(), 0.0);   // states not valid at stage t have value zero
+    m.CalcTransPrSW(t);   // before the threads read the rows
+    for(op=0; op<m.opNum; op++){
+      for(d=1; d<=m.opD[op]; d++){
+        if(!m.ValidState(t,op,d)) continue;
+        ParallelFor(threads, sizeG, [this, t, op, d](long long from, long long to) { EvalStates(t, op, d, from, to); });
+      }
+    }
+    swap(cur, next);
+  }
+  for(int k=0; k<n; k++){
+    const double* v = &next[k][d0*sizeG];   // op = 0
+    initial[k].assign(v, v+sizeG);
+    for(int g=0; g<sizeG; g++) mean[k] += v[g]/sizeG;
+  }
+  cur.clear();
+  next.clear();
+  return(mean);
+}
+
+// ===================================================
+
+void PolicyEval::EvalStates(int t, int op, int d, int gFrom, int gTo){
+  TRACE_SPAN_ARG("evalStates", t);
+  int n = Size(), k, g;
+  int iMWt, iSWt, iMPt, iSPt, iTt, iPt, iSW;
+  vector<double> acc(n), reward(n), accSW(n*m.sizeSSW);
+  vector<const double*> v(n);   // value function of the successors of each policy
+  int slabPos = op*(m.opDMax+1)+d, slabDo = -1;
+  if (d>1) slabDo = op*(m.opDMax+1)+d-1;
+  else if (op<m.opNum-1) slabDo = (op+1)*(m.opDMax+1)+(int)m.opD[op+1];
+  bool forced = (d==m.opL[op]-t);
+
+  for(g=gFrom; g<gTo; g++){
+    iPt = g % m.sizeSP;
+    iTt = (g/m.sizeSP) % m.sizeST;
+    iSPt = (g/(m.sizeSP*m.sizeST)) % m.sizeSSP;
+    iMPt = (g/(m.sizeSP*m.sizeST*m.sizeSSP)) % m.sizeSMP;
+    iSWt = (g/(m.sizeSP*m.sizeST*m.sizeSSP*m.sizeSMP)) % m.sizeSSW;
+    iMWt = g/(m.sizeSP*m.sizeST*m.sizeSSP*m.sizeSMP*m.sizeSSW);
+
+    // the successor values and rewards of each policy (NULL if no expectation is needed)
+    for(k=0; k<n; k++){
+      acc[k] = 0;
+      if ( !forced && !Action(k, t, op, d, g, iMWt) ) {
+        v[k] = &next[k][slabPos*sizeG];
+        reward[k] = m.RewardPos();
+      } else if (slabDo>=0) {
+        v[k] = &next[k][slabDo*sizeG];
+        reward[k] = m.rewDo[op][iMWt][iSWt];
+      } else {
+        int opt = op, dt = d;
+        v[k] = NULL;
+        reward[k] = m.WeightDo(opt, dt, iMWt, iSWt, iMPt, iSPt, iTt, iPt, t);   // last operation finished
+      }
+    }
+
+    // the expectation over the successors as in MDPV::Expect (the trans pr are calculated once for all policies)
+    fill(accSW.begin(), accSW.end(), 0.0);
+    m.ForSuccessors(m.Row(iMWt, iMPt, iSPt, iTt, iPt), [&](int iMW, int iMP, int iSP, int iT, int iP, double pr4) {
+      for(int iSW=0; iSW<m.sizeSSW; iSW++){
+        int gN = ((((iMW*m.sizeSSW+iSW)*m.sizeSMP+iMP)*m.sizeSSP+iSP)*m.sizeST+iT)*m.sizeSP+iP;
+        for(int k=0; k<n; k++) if (v[k]!=NULL) accSW[k*m.sizeSSW+iSW] = accSW[k*m.sizeSSW+iSW] + pr4*v[k][gN];
+      }
+    });
+    const vector<double> & pSW = m.prSW[t][iSWt];
+    for(iSW=0; iSW<m.sizeSSW; iSW++){
+      double pr = exp(pSW[iSW]);
+      if (pr>0) for(k=0; k<n; k++) acc[k] = acc[k] + pr*accSW[k*m.sizeSSW+iSW];
+    }
+    for(k=0; k<n; k++) cur[k][slabPos*sizeG+g] = reward[k]+acc[k];
+  }
+}
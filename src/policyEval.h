@@ -0,0 +1,113 @@
+#ifndef POLICYEVAL_HPP
+#define POLICYEVAL_HPP
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "mdp.h"
+
+using namespace std;
+
+// ===================================================
+
+/**
+* Exact evaluation of arbitrary (non-optimal) policies of a model.
+*
+* A policy gives the action (pos. or do.) of each state. Supported policies are calendar rules (do operation op from
+* a given day), soil water threshold rules (do operation op if the mean soil water content is at most a threshold),
+* policy tables written using MDPV::writePolicy and the optimal policy of the model. At the last day of an operation
+* the operation is always done (doF.) as in the MDP.
+*
+* The expected value of all policies is found in one backward pass using the same trans pr and rewards as
+* MDPV::SolveMDP. The trans pr of a state are calculated once and used for all policies, i.e. evaluating many
+* policies costs little more than evaluating one. The value of the optimal policy equals the value function of
+* the model.
+*
+* @author Reza Pourmoayed
+*/
+class PolicyEval
+{
+  public:
+
+    /** Constructor.
+    *
+    * @param model The model (solved if the optimal policy is evaluated). The rewards and trans pr are calculated if needed.
+    * @param out Stream used for log output.
+    */
+    PolicyEval(MDPV & model, ostream & out = cout);
+
+
+    /** Add a calendar rule: operation op is done at the days t>=firstDay[op].
+    *
+    * @return The index of the policy.
+    */
+    int AddCalendar(const vector<double> & firstDay);
+
+
+    /** Add a soil water threshold rule: operation op is done if the center point of the mean soil water content is at most watMax[op].
+    *
+    * @return The index of the policy.
+    */
+    int AddThreshold(const vector<double> & watMax);
+
+
+    /** Add a policy table written using MDPV::writePolicy for a model of the same size. Throws std::runtime_error if
+    * the file cannot be read or the model size differs.
+    *
+    * @return The index of the policy.
+    */
+    int AddTable(const string & fileName);
+
+
+    /** Add the optimal policy of the model (the model must be solved).
+    *
+    * @return The index of the policy.
+    */
+    int AddOptimal();
+
+
+    /** Evaluate all policies.
+    *
+    * @param threads Number of threads used (0 = number of cores).
+    *
+    * @return The mean value of each policy over the initial states, i.e. the states at day opE of the first operation
+    *   with opD days left (see InitialValues).
+    */
+    vector<double> Evaluate(int threads = 1);
+
+
+    /** The value of policy k at the initial states (indexes iMW, iSW, iMP, iSP, iT, iP in the same order as in printPolicy). */
+    const vector<double> & InitialValues(int k) const {return(initial[k]);}
+
+    /** Number of policies. */
+    int Size() const {return(names.size());}
+
+    /** A description of policy k. */
+    const string & Name(int k) const {return(names[k]);}
+
+
+  private:
+
+    enum RuleType {RULE_CALENDAR, RULE_THRESHOLD, RULE_TABLE};
+
+    /** The action of policy k (0 = pos., 1 = do.) in a state that is not at the last day of an operation. */
+    char Action(int k, int t, int op, int d, int g, int iMW) const;
+
+    /** Evaluate the states with grid index g in [gFrom, gTo) for operation op and d remaining days at day t. */
+    void EvalStates(int t, int op, int d, int gFrom, int gTo);
+
+    MDPV & m;
+    ostream & out;
+    int sizeG;                         // number of grid states (iMW, iSW, iMP, iSP, iT, iP)
+    int sizeSlab;                      // number of states at a stage (op, d, grid)
+    vector<string> names;
+    vector<RuleType> types;
+    vector< vector<double> > par;      // first days or thresholds of each operation
+    vector< vector<char> > tables;     // actions [t][op][d][grid] of table policies
+    vector< vector<double> > cur;      // value of each policy at the current stage [op][d][grid]
+    vector< vector<double> > next;     // value of each policy at the next stage
+    vector< vector<double> > initial;  // value of each policy at the initial states
+};
+
+
+#endif
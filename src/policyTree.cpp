@@ -0,0 +1,128 @@
+#include "policyTree.h"
+#include <cstdio>
+#include <stdexcept>
+
+// ===================================================
+
+PolicyTree::PolicyTree(int tMax, int opNum, int opDMax, const vector<int> & sizes) :
+  tMax(tMax), opNum(opNum), opDMax(opDMax), sizes(sizes) {
+  root = vector<int>( (tMax+1)*opNum*(opDMax+1), -1 );
+}
+
+// ===================================================
+
+void PolicyTree::AddSlice(int t, int op, int d, const vector<char> & acts){
+  int i, f, n = acts.size();
+  vector< vector<short> > x(n, vector<short>(6));
+  vector<int> items(n), idx(6,0);
+
+  for(i=0; i<n; i++){    // state variable indexes of state i (loop order iMW, iSW, iMP, iSP, iT, iP)
+    for(f=0; f<6; f++) x[i][f]=idx[f];
+    for(f=5; f>=0; f--){
+      if(++idx[f]<sizes[f]) break;
+      idx[f]=0;
+    }
+    items[i]=i;
+  }
+  root[SliceIdx(t,op,d)] = Build(items, x, acts);
+}
+
+// ===================================================
+
+int PolicyTree::Build(const vector<int> & items, const vector< vector<short> > & x, const vector<char> & acts){
+  int i, f, c, a, best=0;
+  int cnt[3] = {0,0,0};
+  Node node;
+
+  for(i=0; i<(int)items.size(); i++) cnt[(int)acts[items[i]]]++;
+  for(a=1; a<3; a++) if(cnt[a]>cnt[best]) best=a;
+  if(cnt[best]==(int)items.size()){   // pure leaf
+    node.feature=-1; node.unused=0; node.threshold=0; node.left=best; node.right=-1;
+    nodes.push_back(node);
+    return(nodes.size()-1);
+  }
+
+  // find the split with the smallest Gini impurity
+  double gini, bestGini=-1, nL, nR, sL, sR;
+  int bestF=-1, bestC=-1;
+  for(f=0; f<6; f++){
+    vector< vector<int> > h(sizes[f], vector<int>(3,0));
+    for(i=0; i<(int)items.size(); i++) h[x[items[i]][f]][(int)acts[items[i]]]++;
+    int left[3] = {0,0,0};
+    for(c=0; c<sizes[f]-1; c++){
+      for(a=0; a<3; a++) left[a]+=h[c][a];
+      nL = left[0]+left[1]+left[2];
+      nR = items.size()-nL;
+      if( (nL==0) || (nR==0) ) continue;
+      sL=sR=0;
+      for(a=0; a<3; a++){
+        sL+=(double)left[a]*left[a];
+        sR+=(double)(cnt[a]-left[a])*(cnt[a]-left[a]);
+      }
+      gini = nL-sL/nL + nR-sR/nR;
+      if( (bestF<0) || (gini<bestGini) ){ bestGini=gini; bestF=f; bestC=c; }
+    }
+  }
+
+  vector<int> itemsL, itemsR;
+  for(i=0; i<(int)items.size(); i++){
+    if(x[items[i]][bestF]<=bestC) itemsL.push_back(items[i]); else itemsR.push_back(items[i]);
+  }
+  int n = nodes.size();
+  node.feature=bestF; node.unused=0; node.threshold=bestC; node.left=-1; node.right=-1;
+  nodes.push_back(node);
+  int l = Build(itemsL, x, acts);
+  int r = Build(itemsR, x, acts);
+  nodes[n].left=l;
+  nodes[n].right=r;
+  return(n);
+}
+
+// ===================================================
+
+int PolicyTree::Slices() const {
+  int n=0;
+  for(int i=0; i<(int)root.size(); i++) if(root[i]>=0) n++;
+  return(n);
+}
+
+// ===================================================
+
+long PolicyTree::Bytes() const {
+  return( 8 + 11*sizeof(int) + root.size()*sizeof(int) + nodes.size()*sizeof(Node) );
+}
+
+// ===================================================
+
+void PolicyTree::Write(const string & fileName) const {
+  FILE* pFile = fopen(fileName.c_str(), "wb");
+  if (pFile==NULL) throw runtime_error("Cannot open file " + fileName);
+  int header[11] = {tMax, opNum, opDMax, sizes[0], sizes[1], sizes[2], sizes[3], sizes[4], sizes[5], (int)root.size(), (int)nodes.size()};
+  fwrite("MDPTTRE1", sizeof(char), 8, pFile);
+  fwrite(header, sizeof(int), 11, pFile);
+  fwrite(&root[0], sizeof(int), root.size(), pFile);
+  if (!nodes.empty()) fwrite(&nodes[0], sizeof(Node), nodes.size(), pFile);
+  fclose(pFile);
+}
+
+// ===================================================
+
+void PolicyTree::Read(const string & fileName){
+  char magic[8];
+  int header[11];
+
+  FILE* pFile = fopen(fileName.c_str(), "rb");
+  if (pFile==NULL) throw runtime_error("Cannot open file " + fileName);
+  if ( fread(magic, sizeof(char), 8, pFile)!=8 || string(magic,8)!="MDPTTRE1" || fread(header, sizeof(int), 11, pFile)!=11 ) {
+    fclose(pFile);
+    throw runtime_error(fileName + " is not a policy tree file");
+  }
+  tMax=header[0]; opNum=header[1]; opDMax=header[2];
+  sizes.assign(header+3, header+9);
+  root.resize(header[9]);
+  nodes.resize(header[10]);
+  bool ok = fread(&root[0], sizeof(int), root.size(), pFile)==root.size();
+  if (ok && !nodes.empty()) ok = fread(&nodes[0], sizeof(Node), nodes.size(), pFile)==nodes.size();
+  fclose(pFile);
+  if (!ok) throw runtime_error("Cannot read policy tree file " + fileName);
+}
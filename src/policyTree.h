@@ -0,0 +1,96 @@
+#ifndef POLICYTREE_HPP
+#define POLICYTREE_HPP
+
+#include <string>
+#include <vector>
+using namespace std;
+
+// ===================================================
+
+/**
+* Compressed (lossless) representation of the optimal policy. For each (t,op,d) slice the optimal
+* action is given by a decision tree with splits of the form index <= threshold on the state
+* variables (iMW, iSW, iMP, iSP, iT, iP). The trees are learned greedily from the solved policy and
+* split until all leaves are pure, i.e. the tree returns the same action as the policy for all states.
+*
+* Binary file format: "MDPTTRE1", the integers (tMax, opNum, opDMax, sizeSMW, sizeSSW, sizeSMP, sizeSSP,
+* sizeST, sizeSP, number of slices, number of nodes), the root node of each slice (int, -1 if no states)
+* and the nodes. A node is stored as (feature (char), unused (char), threshold (short), left (int),
+* right (int)). For a leaf feature is -1 and left holds the action (0 = pos., 1 = do., 2 = doF.).
+*
+* @author Reza Pourmoayed
+*/
+class PolicyTree
+{
+  public:
+
+    PolicyTree() : tMax(0), opNum(0), opDMax(0) {}
+
+    /** Constructor.
+    *
+    * @param tMax Number of days.
+    * @param opNum Number of operations.
+    * @param opDMax Max number of days needed to complete an operation.
+    * @param sizes Number of states of each state variable (iMW, iSW, iMP, iSP, iT, iP).
+    */
+    PolicyTree(int tMax, int opNum, int opDMax, const vector<int> & sizes);
+
+
+    /** Learn the decision tree of slice (t,op,d).
+    *
+    * @param acts Action codes of the states ordered as in the loops over iMW, iSW, iMP, iSP, iT, iP.
+    */
+    void AddSlice(int t, int op, int d, const vector<char> & acts);
+
+
+    /** The action code of a state (0 = pos., 1 = do., 2 = doF.). Returns -1 if slice (t,op,d) is not given. */
+    int Action(int t, int op, int d, int iMW, int iSW, int iMP, int iSP, int iT, int iP) const {
+      int x[6] = {iMW, iSW, iMP, iSP, iT, iP};
+      int n = root[SliceIdx(t,op,d)];
+      if (n<0) return(-1);
+      while (nodes[n].feature>=0) n = (x[(int)nodes[n].feature] <= nodes[n].threshold) ? nodes[n].left : nodes[n].right;
+      return(nodes[n].left);
+    }
+
+
+    /** Number of nodes in all trees. */
+    int Nodes() const {return(nodes.size());}
+
+    /** Number of slices with a tree. */
+    int Slices() const;
+
+    /** Size in bytes of the binary file. */
+    long Bytes() const;
+
+    /** Write the trees to a binary file. */
+    void Write(const string & fileName) const;
+
+    /** Read the trees from a binary file. Throws std::runtime_error if the file cannot be read. */
+    void Read(const string & fileName);
+
+
+  private:
+
+    struct Node {
+      signed char feature;   // state variable split on (-1 for a leaf)
+      char unused;
+      short threshold;       // go left if index <= threshold
+      int left;              // left child (action if leaf)
+      int right;             // right child
+    };
+
+    int SliceIdx(int t, int op, int d) const {return( (t*opNum+op)*(opDMax+1)+d );}
+
+    /** Build the tree for the states given (rows in x) and return the index of the root node. */
+    int Build(const vector<int> & items, const vector< vector<short> > & x, const vector<char> & acts);
+
+    int tMax;
+    int opNum;
+    int opDMax;
+    vector<int> sizes;
+    vector<int> root;     // root node of each slice
+    vector<Node> nodes;
+};
+
+
+#endif
@@ -0,0 +1,142 @@
+#include "policyWriter.h"
+#include "mdp.h"
+#include "trace.h"
+#include <cstdint>
+#include <stdexcept>
+
+static const char * actionLabels[3] = {"pos.", "do.", "doF."};
+
+// ===================================================
+
+PolicyWriter::PolicyWriter(const MDPV & model, const string & binFile, const string & csvFile, int queueSize) :
+  m(model), bin(NULL), csv(NULL), maxQueue(queueSize<1 ? 1 : queueSize), done(false), failed(false) {
+  active = !binFile.empty() || !csvFile.empty();
+  if (!active) return;
+
+  vector<int> s = m.gridSizes();
+  int sizeG = s[0]*s[1]*s[2]*s[3]*s[4]*s[5];
+  if (!binFile.empty()) {
+    bin = fopen(binFile.c_str(), "wb");
+    if (bin==NULL) throw runtime_error("Cannot open " + binFile);
+    uint32_t n = 0;   // number of records
+    for(int t=1; t<m.stages(); t++)
+      for(int op=0; op<m.operations(); op++)
+        for(int d=1; d<=m.opDays(op); d++) if(m.ValidState(t,op,d)) n += sizeG;
+    int header[9] = {1, m.stages(), m.operations(), s[0], s[1], s[2], s[3], s[4], s[5]};
+    if ( fwrite(header, sizeof(int), 9, bin)!=9 || fwrite(&n, sizeof(uint32_t), 1, bin)!=1 ) {
+      fclose(bin);
+      throw runtime_error("Cannot write " + binFile);
+    }
+  }
+  if (!csvFile.empty()) {
+    csv = fopen(csvFile.c_str(), "w");
+    if (csv==NULL) {
+      if (bin!=NULL) fclose(bin);
+      throw runtime_error("Cannot open " + csvFile);
+    }
+    fprintf(csv, "statLbl;day;op;d;iMW;iSW;iMP;iSP;iT;iP;optAction;weight\n");
+  }
+  writer = thread(&PolicyWriter::Run, this);
+}
+
+// ===================================================
+
+PolicyWriter::~PolicyWriter(){
+  Close();
+}
+
+// ===================================================
+
+void PolicyWriter::Push(int t, vector<double> & vals, vector<char> & acts){
+  if (!active) return;
+  TRACE_SPAN_ARG("exportPush", t);   // includes the wait if the queue is full
+  unique_lock<mutex> lock(mtx);
+  cvPop.wait(lock, [this]{return(queue.size()<maxQueue || failed);});
+  queue.push_back(Stage());
+  queue.back().t = t;
+  queue.back().vals.swap(vals);
+  queue.back().acts.swap(acts);
+  cvPush.notify_one();
+}
+
+// ===================================================
+
+void PolicyWriter::Finish(){
+  if (!active) return;
+  Close();
+  if (failed) throw runtime_error("Error writing the policy");
+}
+
+// ===================================================
+
+void PolicyWriter::Close(){
+  if (!active) return;
+  {
+    lock_guard<mutex> lock(mtx);
+    done = true;
+  }
+  cvPush.notify_one();
+  if (writer.joinable()) writer.join();
+  if (bin!=NULL && fclose(bin)!=0) failed = true;
+  if (csv!=NULL && fclose(csv)!=0) failed = true;
+  bin = csv = NULL;
+  active = false;
+}
+
+// ===================================================
+
+void PolicyWriter::Run(){
+  while (true) {
+    Stage s;
+    {
+      unique_lock<mutex> lock(mtx);
+      cvPush.wait(lock, [this]{return(!queue.empty() || done);});
+      if (queue.empty()) return;
+      s.t = queue.front().t;
+      s.vals.swap(queue.front().vals);
+      s.acts.swap(queue.front().acts);
+      queue.pop_front();
+    }
+    cvPop.notify_one();
+    WriteStage(s);
+  }
+}
+
+// ===================================================
+
+void PolicyWriter::WriteStage(const Stage & s){
+  TRACE_SPAN_ARG("export", s.t);
+  vector<int> sz = m.gridSizes();
+  int rec[10], op, d, iMW, iSW, iMP, iSP, iT, iP;
+  size_t i = 0;
+  bool ok = true;
+
+  for(op=0; op<m.operations(); op++){
+    for(d=1; d<=m.opDays(op); d++){
+      if(!m.ValidState(s.t,op,d)) continue;
+      for(iMW=0; iMW<sz[0]; iMW++)
+        for(iSW=0; iSW<sz[1]; iSW++)
+          for(iMP=0; iMP<sz[2]; iMP++)
+            for(iSP=0; iSP<sz[3]; iSP++)
+              for(iT=0; iT<sz[4]; iT++)
+                for(iP=0; iP<sz[5]; iP++){
+                  if (i>=s.vals.size()) { ok = false; continue; }
+                  if (bin!=NULL) {
+                    rec[0]=s.t; rec[1]=op+1; rec[2]=d; rec[3]=iMW; rec[4]=iSW; rec[5]=iMP; rec[6]=iSP; rec[7]=iT; rec[8]=iP; rec[9]=s.acts[i];
+                    ok = ok && fwrite(rec, sizeof(int), 10, bin)==10 && fwrite(&s.vals[i], sizeof(double), 1, bin)==1;
+                  }
+                  if (csv!=NULL) {
+                    ok = ok && fprintf(csv, "(%d,%d,%d,%d,%d,%d,%d,%d,%d);%d;%d;%d;%d;%d;%d;%d;%d;%d;%s;%g\n",
+                                       op, d, iMW, iSW, iMP, iSP, iT, iP, s.t, s.t, op+1, d, iMW, iSW, iMP, iSP, iT, iP,
+                                       actionLabels[(int)s.acts[i]], s.vals[i])>0;
+                  }
+                  i++;
+                }
+    }
+  }
+  if (!ok) {
+    lock_guard<mutex> lock(mtx);
+    failed = true;
+    cvPop.notify_one();
+  }
+}
@@ -0,0 +1,92 @@
+#ifndef POLICYWRITER_HPP
+#define POLICYWRITER_HPP
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+class MDPV;
+
+// ===================================================
+
+/**
+* Write the optimal policy while the model is solved (pipelined export).
+*
+* The solver pushes each stage as soon as it is final (see MDPV::setExport) and a background thread writes it
+* to a binary file (same format as MDPV::writePolicy) and/or a csv file (same format as MDPV::printPolicy) while
+* the solver computes the next stage. The queue holds at most queueSize stages; if the writer falls behind, Push
+* blocks until a stage has been written (back-pressure), i.e. the memory used is bounded.
+*
+* @author Reza Pourmoayed
+*/
+class PolicyWriter
+{
+  public:
+
+    /** Constructor. Open the files and start the writer thread. Throws std::runtime_error if a file cannot be opened.
+    *
+    * @param model The model (only the dimensions are used).
+    * @param binFile Name of the binary file ("" = none).
+    * @param csvFile Name of the csv file ("" = none).
+    * @param queueSize Max number of stages waiting to be written.
+    */
+    PolicyWriter(const MDPV & model, const string & binFile, const string & csvFile, int queueSize = 2);
+
+
+    /** Destructor. Stops the writer thread (the files are incomplete if Finish has not been called). */
+    ~PolicyWriter();
+
+
+    /** True if a file is written. */
+    bool Active() const {return(active);}
+
+
+    /** Add stage t (stages must be pushed from tMax-1 down to 1). The vectors are taken over (swapped) and hold
+    * the value function and actions in the order of MDPV::getStage.
+    */
+    void Push(int t, vector<double> & vals, vector<char> & acts);
+
+
+    /** Wait until all stages have been written and close the files. Throws std::runtime_error if a write failed. */
+    void Finish();
+
+
+  private:
+
+    struct Stage {
+      int t;
+      vector<double> vals;
+      vector<char> acts;
+    };
+
+    /** Write the stages in the queue (run by the writer thread). */
+    void Run();
+
+    /** Write a stage to the files. */
+    void WriteStage(const Stage & s);
+
+    /** Stop the thread and close the files. */
+    void Close();
+
+    const MDPV & m;
+    FILE * bin;
+    FILE * csv;
+    bool active;
+    size_t maxQueue;
+    deque<Stage> queue;
+    bool done;                  // no more stages are pushed
+    bool failed;                // a write failed
+    mutex mtx;
+    condition_variable cvPush;  // signaled when a stage is added or done is set
+    condition_variable cvPop;   // signaled when a stage has been removed from the queue
+    thread writer;
+};
+
+
+#endif
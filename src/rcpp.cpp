@@ -1,31 +1,670 @@
+#include <Rcpp.h>
+#include <sstream>
 #include "mdp.h"
+#include "ensemble.h"
+#include "fieldBatch.h"
+#include "stateEncoder.h"
+#include "policyEval.h"
+#include "forwardDist.h"
+#include "fieldData.h"
+#include "forecast.h"
+#include "saa.h"
+#include "footprint.h"
+#include "trace.h"
 
 using namespace Rcpp;
 using namespace std;
 
+/** Convert the parameter list created using \code{setParam} into a parameter map (matrices stored row-wise). */
+static ParamMap asParamMap(const List & paramModel) {
+  ParamMap values;
+  CharacterVector names = paramModel.names();
+  for (int i=0; i<paramModel.size(); i++) {
+    SEXP x = paramModel[i];
+    if ( !Rf_isNumeric(x) && !Rf_isLogical(x) ) continue;
+    vector<double> & v = values[as<string>(names[i])];
+    if (Rf_isMatrix(x)) {
+      NumericMatrix m(x);
+      for (int r=0; r<m.nrow(); r++)
+        for (int c=0; c<m.ncol(); c++) v.push_back(m(r,c));
+    } else {
+      NumericVector n(x);
+      v.assign(n.begin(), n.end());
+    }
+  }
+  return(values);
+}
+
+/** Called after each stage so the solver can be interrupted from R. */
+static void checkInterrupt(int t) {
+  checkUserInterrupt();
+}
+
 //' Solving the MDP using value iteration algorithm.
 //'
 //' @param paramModel parameters a list created using \code{\link{setParameters}}.
+//' @param checkpointFile Name of a file where each solved stage is stored ("" = no checkpoints).
+//' @param resume If TRUE continue from the stages stored in \code{checkpointFile} (e.g. after an interrupted run).
+//' @param precision Storage precision of the transition probabilities used in the expectations
+//'   ("double", "float" or "q16" for 16 bit quantized probabilities). Sums are always accumulated in double.
+//' @param truncate Max probability mass removed from each row of the transition kernel when it is built (0 = exact kernel).
 //'
-//' @return A list
+//' @return A list with the total reward and a bound on the error of the value function at day 1 caused by the truncation.
 //' @export
 // [[Rcpp::export]]
-SEXP SolveMDPModel(const List paramModel) {
-   MDPV Model(paramModel);
+SEXP SolveMDPModel(const List paramModel, std::string checkpointFile = "", bool resume = false, std::string precision = "double", double truncate = 0) {
+   ModelParam param(asParamMap(paramModel));
+   MDPV Model(param, Rcout);
+   Model.setCheckpoint(checkpointFile, resume);
+   Model.setPrecision(MDPV::parsePrecision(precision));
+   Model.setTruncation(truncate);
+   Model.setStageCallback(checkInterrupt);
+   Model.setExport("", "policyMDP.csv");   // written while solving
    Rcout << "Total number of states: " << Model.countStatesMDP() << endl;
-   return( Model.SolveMDP() );
+   double totalRew = Model.SolveMDP();
+   return( wrap( List::create(Named("totalRew") = totalRew, Named("errorBound") = Model.valueErrorBound(1)) ) );
    //return(wrap(0));
 }
 
 
+//' Find the optimal action of a single state without solving the whole MDP.
+//'
+//' The recursion is evaluated top-down from the state, i.e. only the states reachable from the given state are evaluated.
+//' The state is given using the same indexes as in the policy file created using \code{SolveMDPModel}.
+//'
+//' @param paramModel parameters a list created using \code{\link{setParameters}}.
+//' @param day Current day.
+//' @param op Current tillage operation.
+//' @param d Remaining days for finishing operation op.
+//' @param iMW,iSW,iMP,iSP,iT,iP Indexes of the other state variables.
+//' @param prune Successors with a transition probability below \code{prune} are skipped and the mass of the others
+//'   scaled up (0 = exact value).
+//'
+//' @return A list with the optimal action and the value function (weight) of the state.
+//' @export
+// [[Rcpp::export]]
+SEXP SolveMDPState(const List paramModel, int day, int op, int d, int iMW, int iSW, int iMP, int iSP, int iT, int iP, double prune = 0) {
+   ModelParam param(asParamMap(paramModel));
+   MDPV Model(param, Rcout);
+   string action;
+   Model.setLazyPruning(prune);
+   double weight = Model.SolveState(day, op-1, d, iMW, iSW, iMP, iSP, iT, iP, action);
+   return( wrap( List::create(Named("optAction") = action, Named("weight") = weight) ) );
+}
+
+
+/** File prefix of the policies written by SolveMDPEnsemble. */
+static string ensemblePrefix;
+
+/** Write the policy of model i in the ensemble (called from the worker threads, no R API calls). */
+static void writeEnsemblePolicy(int i, MDPV & model) {
+  ostringstream s;
+  s << ensemblePrefix << "_" << i+1 << ".csv";
+  model.printPolicy(s.str());
+}
+
+
+//' Solve the MDP for many parameter sets in parallel.
+//'
+//' Parameter sets sharing preprocessing tables (e.g. only the weather statistics differ) calculate the shared tables once.
+//' The policy of parameter set i is written to the csv file \code{paste0(filePrefix, "_", i, ".csv")}.
+//'
+//' @param paramModels A list of parameter lists created using \code{\link{setParameters}}.
+//' @param threads Max number of models solved in parallel (0 = number of cores).
+//' @param memoryMB Max memory (MB) used by the models solved in parallel and the shared tables (0 = no limit).
+//' @param filePrefix Prefix of the policy files.
+//'
+//' @return A vector with the total reward of each model.
+//' @export
+// [[Rcpp::export]]
+SEXP SolveMDPEnsemble(const List paramModels, int threads = 0, double memoryMB = 0, std::string filePrefix = "policyMDP") {
+   vector<ModelParam> params;
+   for (int i=0; i<paramModels.size(); i++) params.push_back( ModelParam(asParamMap(as<List>(paramModels[i]))) );
+   ensemblePrefix = filePrefix;
+   Ensemble ensemble(params, Rcout);
+   vector<double> rew = ensemble.Solve(threads, memoryMB*1024*1024, writeEnsemblePolicy);
+   return( wrap(rew) );
+}
+
+
+//' Solve the MDP for many fields in the same weather cell.
+//'
+//' The fields must have the same grids and weather statistics but may have different soil and field parameters.
+//' The weather transition probabilities are calculated once and shared by the fields, and at each stage the value
+//' function of each field is contracted over the weather of the next day once.
+//' The policy of field i is written to the csv file \code{paste0(filePrefix, "_", i, ".csv")}.
+//'
+//' @param paramModels A list of parameter lists created using \code{\link{setParameters}} (one for each field).
+//' @param threads Number of threads used (0 = number of cores).
+//' @param filePrefix Prefix of the policy files.
+//'
+//' @return A vector with the total reward of each field.
+//' @export
+// [[Rcpp::export]]
+SEXP SolveMDPFields(const List paramModels, int threads = 1, std::string filePrefix = "policyMDP") {
+   vector<ModelParam> params;
+   for (int i=0; i<paramModels.size(); i++) params.push_back( ModelParam(asParamMap(as<List>(paramModels[i]))) );
+   FieldBatch batch(params, Rcout);
+   vector<double> rew = batch.Solve(threads);
+   ensemblePrefix = filePrefix;
+   for (int i=0; i<batch.Size(); i++) writeEnsemblePolicy(i, batch.Field(i));
+   return( wrap(rew) );
+}
+
+
+//' Create a state encoder kept in memory between calls (see \code{EncodeStates}).
+//'
+//' The encoder holds the discretization matrices of the parameters, i.e. repeated calls of \code{EncodeStates}
+//' (e.g. one per day) do not convert the parameters again. The memory is released when the object is garbage collected.
+//'
+//' @param paramModel parameters a list created using \code{\link{setParameters}}.
+//'
+//' @return An external pointer to the encoder.
+//' @export
+// [[Rcpp::export]]
+SEXP EncoderCreate(const List paramModel) {
+   XPtr<StateEncoder> p(new StateEncoder(ModelParam(asParamMap(paramModel))), true);
+   return(p);
+}
+
+
+//' Find the state indexes of many observations.
+//'
+//' The intervals are found using binary search in the discretization matrices (the vectorized version of \code{findIndex}).
+//'
+//' @param encoder An encoder created using \code{EncoderCreate} (or a parameter list created using
+//'   \code{\link{setParameters}}, the encoder is then built for this call only).
+//' @param obs A matrix with 6 columns holding the observations of the mean and sd of soil water content,
+//'   the posterior mean and sd of the latent variable, the temperature and the precipitation.
+//'
+//' @return An integer matrix with the (zero-based) indexes iMW, iSW, iMP, iSP, iT and iP of each observation (-1 if outside the grid or NA).
+//' @export
+// [[Rcpp::export]]
+IntegerMatrix EncodeStates(SEXP encoder, const NumericMatrix obs) {
+   if (obs.ncol()!=StateEncoder::VARS) stop("obs must have 6 columns");
+   if (TYPEOF(encoder)!=EXTPTRSXP) {   // a parameter list
+     XPtr<StateEncoder> p(new StateEncoder(ModelParam(asParamMap(as<List>(encoder)))), true);
+     return( EncodeStates(p, obs) );
+   }
+   XPtr<StateEncoder> p(encoder);
+   const StateEncoder & enc = *p;
+   int n = obs.nrow();
+   vector<int> idx(n*StateEncoder::VARS);
+   const double* x[StateEncoder::VARS];
+   for (int v=0; v<StateEncoder::VARS; v++) x[v] = &obs[v*n];
+   if (n>0) enc.Encode(n, x, &idx[0]);
+   IntegerMatrix res(n, StateEncoder::VARS);
+   for (int k=0; k<n; k++)
+     for (int v=0; v<StateEncoder::VARS; v++) res(k,v) = idx[k*StateEncoder::VARS+v];
+   colnames(res) = CharacterVector::create("iMW", "iSW", "iMP", "iSP", "iT", "iP");
+   return(res);
+}
+
+
+//' Validate the rewards and transition probabilities of the model.
+//'
+//' The checks are done once for the model (not during the solve). For each table of factored transition
+//' probabilities the row sums, NaN and -Inf values are found. The row sums of the full kernel are found as the
+//' product of the row sums of the factors for each parent state.
+//'
+//' @param paramModel parameters a list created using \code{\link{setParameters}}.
+//' @param threads Number of threads used for the kernel check.
+//' @param tol Max deviation of a row sum from one.
+//'
+//' @return A data frame with a row for each table (rows, bad rows, max deviation, number of NaN and -Inf values).
+//'   The -Inf values are zero transition probabilities (log scale) and are not errors.
+//' @export
+// [[Rcpp::export]]
+DataFrame ValidateModel(const List paramModel, int threads = 1, double tol = 1e-8) {
+   ModelParam param(asParamMap(paramModel));
+   MDPV Model(param, Rcout);
+   ValidationReport rep = Model.Validate(threads, tol);
+   int n = rep.tables.size();
+   CharacterVector name(n);
+   IntegerVector rows(n), badRows(n), nan(n), negInf(n);
+   NumericVector maxError(n);
+   for (int i=0; i<n; i++) {
+     name[i] = rep.tables[i].name;
+     rows[i] = rep.tables[i].rows;
+     badRows[i] = rep.tables[i].badRows;
+     maxError[i] = rep.tables[i].maxError;
+     nan[i] = rep.tables[i].nan;
+     negInf[i] = rep.tables[i].negInf;
+   }
+   return(DataFrame::create(Named("table")=name, Named("rows")=rows, Named("badRows")=badRows,
+     Named("maxError")=maxError, Named("nan")=nan, Named("negInf")=negInf, Named("stringsAsFactors")=false));
+}
+
+
+/** A model kept in R between calls (see MDPCreate). */
+struct MDPSession {
+  MDPSession(const ModelParam & p) : param(p), model(p, Rcout), solved(false), changed(false), totalRew(0) {}
+  ModelParam param;   // current parameters
+  MDPV model;
+  bool solved;        // the model has been solved
+  bool changed;       // the parameters have changed since the last solve
+  double totalRew;    // total reward of the last solve
+};
+
+/** The session of an external pointer created using MDPCreate. */
+static MDPSession & getSession(SEXP model) {
+  XPtr<MDPSession> p(model);
+  if (p.get()==NULL) stop("The model has been released");
+  return(*p);
+}
+
+//' Create a model kept in memory between calls.
+//'
+//' The model is solved using \code{MDPSolve}. The parameters can be changed using \code{MDPSetParam}. The next
+//' solve then only recalculates the preprocessing tables whose parameters have changed and only re-solves the
+//' states whose rewards, transition probabilities or successors have changed. The memory is released using
+//' \code{MDPRelease} (or when the object is garbage collected).
+//'
+//' @param paramModel parameters a list created using \code{\link{setParameters}}.
+//' @param precision Storage precision (see \code{SolveMDPModel}).
+//' @param truncate Max probability mass removed from each row of the transition kernel (see \code{SolveMDPModel}).
+//'
+//' @return An external pointer to the model.
+//' @export
+// [[Rcpp::export]]
+SEXP MDPCreate(const List paramModel, std::string precision = "double", double truncate = 0) {
+   XPtr<MDPSession> p(new MDPSession(ModelParam(asParamMap(paramModel))), true);
+   p->model.setPrecision(MDPV::parsePrecision(precision));
+   p->model.setTruncation(truncate);
+   p->model.setStageCallback(checkInterrupt);
+   return(p);
+}
+
+
+//' Change the parameters of a model created using \code{MDPCreate} (used in the next call of \code{MDPSolve}).
+//'
+//' @param model A model created using \code{MDPCreate}.
+//' @param paramModel The new parameters.
+//' @export
+// [[Rcpp::export]]
+void MDPSetParam(SEXP model, const List paramModel) {
+   MDPSession & s = getSession(model);
+   s.param = ModelParam(asParamMap(paramModel));
+   s.changed = true;
+}
+
+
+//' Change the storage precision and truncation of a model created using \code{MDPCreate}.
+//'
+//' All stages are solved again by the next call of \code{MDPSolve} (the value function depends on both).
+//'
+//' @param model A model created using \code{MDPCreate}.
+//' @param precision Storage precision (see \code{SolveMDPModel}).
+//' @param truncate Max probability mass removed from each row of the transition kernel (see \code{SolveMDPModel}).
+//' @export
+// [[Rcpp::export]]
+void MDPSetPrecision(SEXP model, std::string precision = "double", double truncate = 0) {
+   MDPSession & s = getSession(model);
+   s.model.setPrecision(MDPV::parsePrecision(precision));
+   s.model.setTruncation(truncate);
+   s.changed = true;
+}
+
+
+//' Solve a model created using \code{MDPCreate}.
+//'
+//' @param model A model created using \code{MDPCreate}.
+//' @param tStart First day of the planning horizon. Stages before are not solved (see \code{MDPGetValues}).
+//'   If the model is solved from tStart or earlier and the parameters have not changed nothing is solved,
+//'   and if it is solved from a later day only the missing stages are solved.
+//'
+//' @return A list with the total reward and the value function error bound (see \code{SolveMDPModel}).
+//' @export
+// [[Rcpp::export]]
+SEXP MDPSolve(SEXP model, int tStart = 1) {
+   MDPSession & s = getSession(model);
+   if (s.changed || (s.solved && tStart<s.model.firstSolved())) s.totalRew = s.model.ResolveMDP(s.param, tStart);
+   else if (!s.solved) s.totalRew = s.model.SolveMDP();
+   s.solved = true;
+   s.changed = false;
+   return( wrap( List::create(Named("totalRew") = s.totalRew, Named("errorBound") = s.model.valueErrorBound(1)) ) );
+}
 
 
+//' Values and optimal actions of states in a model solved using \code{MDPSolve}.
+//'
+//' @param model A model created using \code{MDPCreate}.
+//' @param states An integer matrix with 9 columns t, op, d, iMW, iSW, iMP, iSP, iT and iP (op is one-based and the
+//'   other indexes zero-based as in the policy file).
+//'
+//' @return A data frame with the value and optimal action of each state (NA if the state is not valid or its day is
+//'   before the first day solved, see the tStart argument of \code{MDPSolve}).
+//' @export
+// [[Rcpp::export]]
+DataFrame MDPGetValues(SEXP model, const IntegerMatrix states) {
+   MDPSession & s = getSession(model);
+   if (!s.solved) stop("The model has not been solved");
+   if (states.ncol()!=9) stop("states must have 9 columns");
+   vector<int> size = s.model.gridSizes();
+   int n = states.nrow();
+   NumericVector value(n);
+   CharacterVector action(n);
+   for (int k=0; k<n; k++) {
+     int t = states(k,0), op = states(k,1)-1, d = states(k,2);
+     bool ok = (t>=s.model.firstSolved()) && (t>=1) && (t<s.model.stages()) && (op>=0) && (op<s.model.operations()) && (d>=1) && (d<=s.model.opDays(op)) &&
+       s.model.ValidState(t,op,d);
+     for (int v=0; v<6; v++) ok = ok && (states(k,3+v)>=0) && (states(k,3+v)<size[v]);
+     if (!ok) {
+       value[k] = NA_REAL;
+       action[k] = NA_STRING;
+       continue;
+     }
+     value[k] = s.model.getValue(t, op, d, states(k,3), states(k,4), states(k,5), states(k,6), states(k,7), states(k,8));
+     action[k] = s.model.getAction(t, op, d, states(k,3), states(k,4), states(k,5), states(k,6), states(k,7), states(k,8));
+   }
+   return(DataFrame::create(Named("value")=value, Named("action")=action, Named("stringsAsFactors")=false));
+}
 
 
+//' Write the policy of a model solved using \code{MDPSolve}.
+//'
+//' @param model A model created using \code{MDPCreate}.
+//' @param fileName Name of the file. If the extension is .bin the policy is written in the binary format
+//'   (see the command line solver) and otherwise as csv.
+//' @export
+// [[Rcpp::export]]
+void MDPWritePolicy(SEXP model, std::string fileName) {
+   MDPSession & s = getSession(model);
+   if (!s.solved) stop("The model has not been solved");
+   if (fileName.size()>4 && fileName.substr(fileName.size()-4)==".bin") s.model.writePolicy(fileName);
+   else s.model.printPolicy(fileName);
+}
+
+
+//' Release the memory used by a model created using \code{MDPCreate}.
+//'
+//' The model cannot be used afterwards.
+//'
+//' @param model A model created using \code{MDPCreate}.
+//' @export
+// [[Rcpp::export]]
+void MDPRelease(SEXP model) {
+   XPtr<MDPSession> p(model);
+   if (p.get()==NULL) return;
+   delete p.get();
+   R_ClearExternalPtr(model);
+}
+
 
+//' Exact expected value of alternative policies.
+//'
+//' The policies are evaluated in one backward pass using the same transition probabilities and rewards as
+//' \code{SolveMDPModel} (no simulation). At the last day of an operation the operation is always done.
+//'
+//' @param paramModel parameters a list created using \code{\link{setParameters}}.
+//' @param calendar A matrix with a row for each calendar rule holding the first day each operation is done (NULL if none).
+//' @param threshold A matrix with a row for each threshold rule holding the max mean soil water content at which
+//'   each operation is done (NULL if none).
+//' @param tables Names of policy files in binary format (see the command line solver).
+//' @param optimal If TRUE the model is solved and the optimal policy is evaluated too.
+//' @param threads Number of threads used.
+//'
+//' @return A data frame with the mean value of each policy at the initial states (day opE of the first operation).
+//' @export
+// [[Rcpp::export]]
+DataFrame EvaluatePolicies(const List paramModel, SEXP calendar = R_NilValue, SEXP threshold = R_NilValue,
+                           CharacterVector tables = CharacterVector(), bool optimal = true, int threads = 1) {
+   ModelParam param(asParamMap(paramModel));
+   MDPV Model(param, Rcout);
+   PolicyEval eval(Model, Rcout);
+   if (optimal) {
+     Model.SolveMDP();
+     eval.AddOptimal();
+   }
+   for (int r=0; !Rf_isNull(calendar) && r<NumericMatrix(calendar).nrow(); r++) {
+     NumericVector x = NumericMatrix(calendar)(r,_);
+     eval.AddCalendar(vector<double>(x.begin(), x.end()));
+   }
+   for (int r=0; !Rf_isNull(threshold) && r<NumericMatrix(threshold).nrow(); r++) {
+     NumericVector x = NumericMatrix(threshold)(r,_);
+     eval.AddThreshold(vector<double>(x.begin(), x.end()));
+   }
+   for (int i=0; i<tables.size(); i++) eval.AddTable(as<string>(tables[i]));
+   vector<double> mean = eval.Evaluate(threads);
+   CharacterVector name(eval.Size());
+   for (int k=0; k<eval.Size(); k++) name[k] = eval.Name(k);
+   return(DataFrame::create(Named("policy")=name, Named("value")=wrap(mean), Named("stringsAsFactors")=false));
+}
 
 
+//' Exact distribution of the states under the optimal policy.
+//'
+//' The model is solved and the probability mass of the initial states is propagated forward through the
+//' transition probabilities using the optimal actions (no simulation).
+//'
+//' @param paramModel parameters a list created using \code{\link{setParameters}}.
+//' @param initial An integer matrix with 6 columns (iMW, iSW, iMP, iSP, iT, iP, zero-based) with a row for each
+//'   initial state at day opE of the first operation.
+//' @param prob The probability of each initial state.
+//'
+//' @return A list with the probability that the last operation is finished at each day (\code{completion}), the
+//'   probability of each action at each day (\code{actions}), a matrix with the probability that an operation (row)
+//'   is done at a day with mean soil water content in each interval (column) (\code{soilWater}) and the probability
+//'   mass not finished at the last day (\code{remaining}).
+//' @export
+// [[Rcpp::export]]
+List ForwardDistribution(const List paramModel, IntegerMatrix initial, NumericVector prob) {
+   if (initial.ncol()!=6 || initial.nrow()!=prob.size()) stop("initial must have 6 columns and a row for each probability");
+   ModelParam param(asParamMap(paramModel));
+   MDPV Model(param, Rcout);
+   Model.SolveMDP();
+   vector<int> sizes = Model.gridSizes(), grid;
+   for (int r=0; r<initial.nrow(); r++) {
+      int g = 0;
+      for (int k=0; k<6; k++) g = g*sizes[k]+initial(r,k);
+      grid.push_back(g);
+   }
+   ForwardDist fd(Model);
+   fd.Propagate(grid, vector<double>(prob.begin(), prob.end()));
+   const vector< vector<double> > & act = fd.ActionPr();
+   const vector< vector<double> > & sw = fd.SoilWater();
+   int tMax = act.size()-1;
+   IntegerVector day(tMax);
+   NumericVector pr(tMax), pos(tMax), dO(tMax), doF(tMax);
+   for (int t=1; t<=tMax; t++) {
+      day[t-1] = t;
+      pr[t-1] = fd.Completion()[t];
+      pos[t-1] = act[t][0];
+      dO[t-1] = act[t][1];
+      doF[t-1] = act[t][2];
+   }
+   NumericMatrix soilWater(sw.size(), sw[0].size());
+   for (size_t op=0; op<sw.size(); op++)
+      for (size_t i=0; i<sw[op].size(); i++) soilWater(op,i) = sw[op][i];
+   return(List::create(Named("completion")=DataFrame::create(Named("day")=day, Named("pr")=pr),
+                       Named("actions")=DataFrame::create(Named("day")=day, Named("pos")=pos, Named("do")=dO, Named("doF")=doF),
+                       Named("soilWater")=soilWater, Named("remaining")=fd.Remaining()));
+}
 
 
+//' Start recording a timeline of the solver.
+//'
+//' Spans for the preprocessing tables, stages, expectation kernels, threads and I/O are recorded in per-thread ring
+//' buffers until \code{TraceStop} is called. The cost is negligible when tracing is off.
+//'
+//' @param events Size of the ring buffer of each thread (the oldest events are overwritten if it is full).
+//' @export
+// [[Rcpp::export]]
+void TraceStart(int events = 65536) {
+   Tracer::Enable(events);
+}
 
 
+//' Stop recording and write the timeline.
+//'
+//' @param fileName Name of the file written in the Chrome trace JSON format (open it in chrome://tracing or
+//'   ui.perfetto.dev). If "" the events are discarded.
+//'
+//' @return The number of events written.
+//' @export
+// [[Rcpp::export]]
+int TraceStop(std::string fileName = "") {
+   Tracer::Disable();
+   int n = 0;
+   if (!fileName.empty()) n = Tracer::WriteChrome(fileName);
+   Tracer::Clear();
+   return(n);
+}
+
+
+//' Read sensor or weather data and find the daily states of the field.
+//'
+//' The file is parsed in chunks in C++ (no data frame of the readings is created). The readings are aggregated per
+//' day (mean soil water content and temperature, sum of precipitation), filtered using the Gaussian SSM (as
+//' \code{DLMfilter}) and encoded to state indexes (as \code{EncodeStates}). The separator (comma, semicolon or
+//' tab) is found from the header and the rows must be sorted by time. Column names are matched exactly or by prefix,
+//' e.g. "EC5" matches "EC5 (Soil moisture - \%)".
+//'
+//' @param paramModel parameters a list created using \code{\link{setParameters}}.
+//' @param fileName Name of the file.
+//' @param time Name of the time column (time stamps YYYY-MM-DD hh:mm:ss or day numbers).
+//' @param moisture Name of the soil water content column ("" if none, e.g. weather data).
+//' @param temperature Names of the temperature columns (the mean of the columns is used).
+//' @param rain Name of the precipitation column.
+//' @param chunkRows Number of rows parsed at a time.
+//'
+//' @return A data frame with a row for each day (\code{day} is days since 1970-01-01 or the day number of the file),
+//'   the number of readings, the daily observations (NA if not observed), the filter estimates and the zero-based
+//'   state indexes (-1 if outside the grid or not observed).
+//' @export
+// [[Rcpp::export]]
+DataFrame IngestSensorData(const List paramModel, std::string fileName, std::string time = "Timestamp",
+                           std::string moisture = "EC5", CharacterVector temperature = "SLHT5-Air",
+                           std::string rain = "RainMeter", int chunkRows = 65536) {
+   ModelParam param(asParamMap(paramModel));
+   FieldIngest ingest(param);
+   vector<string> temp;
+   for (int i=0; i<temperature.size(); i++) temp.push_back(as<string>(temperature[i]));
+   ingest.Read(fileName, time, moisture, temp, rain, chunkRows);
+   const vector<FieldDay> & days = ingest.Days();
+   int n = days.size();
+   IntegerVector day(n), readings(n);
+   NumericVector mois(n), tem(n), pre(n), meanPos(n), sdPos(n);
+   IntegerMatrix idx(n, StateEncoder::VARS);
+   for (int k=0; k<n; k++) {
+      day[k] = days[k].day;
+      readings[k] = days[k].n;
+      mois[k] = std::isnan(days[k].moisture) ? NA_REAL : days[k].moisture;
+      tem[k] = std::isnan(days[k].temperature) ? NA_REAL : days[k].temperature;
+      pre[k] = days[k].rain;
+      meanPos[k] = days[k].meanPos;
+      sdPos[k] = days[k].sdPos;
+      for (int v=0; v<StateEncoder::VARS; v++) idx(k,v) = days[k].idx[v];
+   }
+   return(DataFrame::create(Named("day")=day, Named("n")=readings, Named("moisture")=mois, Named("temperature")=tem,
+                            Named("rain")=pre, Named("meanPos")=meanPos, Named("sdPos")=sdPos,
+                            Named("iMW")=idx(_,0), Named("iSW")=idx(_,1), Named("iMP")=idx(_,2),
+                            Named("iSP")=idx(_,3), Named("iT")=idx(_,4), Named("iP")=idx(_,5)));
+}
+
+
+//' Solve the model with a forecast window of k days.
+//'
+//' The weather state of a day is replaced by the discretized temperature and precipitation of the day and the next
+//' k-1 days. The window is shifted each day and only the new last day is random (the weather chain of the model is
+//' used). With \code{days = 1} the model is solved. The number of states grows with (number of weather states)^k.
+//'
+//' @param paramModel parameters a list created using \code{\link{setParameters}}.
+//' @param days Number of days in the forecast window.
+//' @param threads Number of threads used (0 = number of cores).
+//'
+//' @return A list with the mean value of the initial states (\code{mean}), the number of states per stage
+//'   (\code{states}) and the memory used by the value function in MB (\code{memory}).
+//' @export
+// [[Rcpp::export]]
+List SolveMDPForecast(const List paramModel, int days = 2, int threads = 1) {
+   ModelParam param(asParamMap(paramModel));
+   MDPV Model(param, Rcout);
+   ForecastMDP forecast(Model, days, Rcout);
+   double mean = forecast.Solve(threads);
+   return(List::create(Named("mean")=mean, Named("states")=forecast.States(), Named("memory")=forecast.MemoryUse()));
+}
+
+
+//' Solve the model using the sample average approximation.
+//'
+//' Each expectation is estimated from \code{samples} successors drawn from the transition kernel for each state.
+//' The same successors are used for both actions (common random numbers). The model is solved \code{replications}
+//' times with the seeds \code{seed}, \code{seed+1}, ... and a confidence interval of the mean value of the initial
+//' states is found. The interval covers the expected value of the approximation, which is biased upwards
+//' compared to the exact solve; the bias shrinks with the number of samples.
+//'
+//' @param paramModel parameters a list created using \code{\link{setParameters}}.
+//' @param samples Number of successors drawn for each state.
+//' @param replications Number of solves.
+//' @param seed Seed of the first replication.
+//' @param level Confidence level.
+//'
+//' @return A list with the mean value of the initial states of each replication (\code{values}), their mean, sd and
+//'   confidence interval (\code{lower}, \code{upper}), the mean and max standard error of a sampled expectation,
+//'   the fraction of decisions where the actions are within 1.96 standard errors (\code{close}) and the time of a
+//'   replication in seconds.
+//' @export
+// [[Rcpp::export]]
+List SolveMDPSampled(const List paramModel, int samples = 32, int replications = 10, int seed = 1, double level = 0.95) {
+   ModelParam param(asParamMap(paramModel));
+   MDPV Model(param, Rcout);
+   SaaReport rep = SolveSAA(Model, samples, replications, seed, level);
+   return(List::create(Named("values")=rep.values, Named("mean")=rep.mean, Named("sd")=rep.sd,
+                       Named("lower")=rep.lower, Named("upper")=rep.upper, Named("meanSe")=rep.meanSe,
+                       Named("maxSe")=rep.maxSe, Named("close")=rep.close, Named("seconds")=rep.seconds));
+}
+
+
+//' Plan the memory and time of a solve without allocating the value function.
+//'
+//' The number of states and expectations are found in closed form from the parameters and the bytes of each
+//' table are found under each storage precision (see \code{SolveMDPModel}). If \code{probe > 0} the trans pr
+//' tables are calculated and the kernel is timed on \code{probe} parent states to estimate the solve time
+//' (an upper bound since action elimination is ignored). A precision and number of local workers within the
+//' memory budget using at most \code{cores} cores are recommended.
+//'
+//' @param paramModel parameters a list created using \code{\link{setParameters}}.
+//' @param memory Memory budget in MB (0 = no limit).
+//' @param cores Number of cores of the node.
+//' @param probe Number of parent states used to time the kernel (0 = no timing).
+//'
+//' @return A list with the number of states, expectations and transitions, a data frame with the bytes of each
+//'   table under each precision (\code{tables}), the total bytes and estimated seconds under each precision
+//'   (-1 if not probed) and the recommended \code{precision}, \code{workers} (0 = a single process),
+//'   \code{bytes}, \code{seconds} and whether it \code{fits} the budget.
+//' @export
+// [[Rcpp::export]]
+List PlanModel(const List paramModel, double memory = 0, int cores = 1, int probe = 1000) {
+   ModelParam param(asParamMap(paramModel));
+   FootprintPlanner planner(param);
+   if (probe>0) {
+      MDPV Model(param, Rcout);
+      planner.Probe(Model, probe);
+   }
+   FootprintReport rep = planner.Plan(memory*1024*1024, cores);
+   int n = rep.tables.size();
+   CharacterVector name(n);
+   NumericVector bDouble(n), bFloat(n), bQ16(n);
+   for (int i=0; i<n; i++) {
+      name[i] = rep.tables[i].name;
+      bDouble[i] = rep.tables[i].bytes[MDPV::PREC_DOUBLE];
+      bFloat[i] = rep.tables[i].bytes[MDPV::PREC_FLOAT];
+      bQ16[i] = rep.tables[i].bytes[MDPV::PREC_Q16];
+   }
+   DataFrame tables = DataFrame::create(Named("table")=name, Named("double")=bDouble, Named("float")=bFloat,
+                                        Named("q16")=bQ16, Named("stringsAsFactors")=false);
+   CharacterVector prec = CharacterVector::create("double", "float", "q16");
+   NumericVector total = NumericVector::create(rep.total[0], rep.total[1], rep.total[2]);
+   NumericVector seconds = NumericVector::create(rep.seconds[0], rep.seconds[1], rep.seconds[2]);
+   total.names() = prec;
+   seconds.names() = prec;
+   List res = List::create(Named("states")=rep.states, Named("expectations")=rep.expectations,
+                       Named("transitions")=rep.transitions, Named("tables")=tables, Named("total")=total,
+                       Named("seconds")=seconds, Named("precision")=prec[rep.precision]);
+   res["workers"] = rep.workers;
+   res["bytes"] = rep.bytes;
+   res["time"] = rep.time;
+   res["fits"] = rep.fits;
+   return(res);
+}
@@ -0,0 +1,126 @@
+#include "refine.h"
+#include <cmath>
+#include <stdexcept>
+
+// ===================================================
+
+/** Go to the next combination of indexes (the last index is changed first). Returns false after the last one. */
+static bool nextIndex(vector<int> & idx, const vector<int> & sizes){
+  for(int f=(int)idx.size()-1; f>=0; f--){
+    if(++idx[f]<sizes[f]) return(true);
+    idx[f]=0;
+  }
+  return(false);
+}
+
+// ===================================================
+
+int RefineGrid(const MDPV & model, ModelParam & param, int v, double valueTol, int maxSize){
+  vector<double> * centers;
+  DisMat * dis;
+  if (v==0) { centers = &param.centerPointsAvgWat; dis = &param.disAvgWat; }
+  else if (v==2) { centers = &param.centerPointsMeanPos; dis = &param.disMeanPos; }
+  else if (v==3) { centers = &param.centerPointsSdPos; dis = &param.disSdPos; }
+  else throw runtime_error("Only the grids of MW, MP and SP can be refined");
+
+  vector<int> sizes = model.gridSizes();
+  int n = sizes[v];
+  int t, op, d, i;
+  double val, vMin=0, vMax=0;
+  bool first=true;
+  vector<char> flag(n, 0);   // flag[i] true if a center point is added between i and i+1
+
+  // range of the value function
+  for(t=1; t<model.stages(); t++){
+    for(op=0; op<model.operations(); op++){
+      for(d=1; d<=model.opDays(op); d++){
+        if(!model.ValidState(t,op,d)) continue;
+        vector<int> x(6,0);
+        do {
+          val = model.getValue(t,op,d,x[0],x[1],x[2],x[3],x[4],x[5]);
+          if (first || val<vMin) vMin=val;
+          if (first || val>vMax) vMax=val;
+          first=false;
+        } while (nextIndex(x, sizes));
+      }
+    }
+  }
+
+  // compare neighbouring states
+  for(t=1; t<model.stages(); t++){
+    for(op=0; op<model.operations(); op++){
+      for(d=1; d<=model.opDays(op); d++){
+        if(!model.ValidState(t,op,d)) continue;
+        vector<int> x(6,0), y;
+        do {
+          if (x[v]==n-1 || flag[x[v]]) continue;
+          y = x;
+          y[v]++;
+          if ( model.getAction(t,op,d,x[0],x[1],x[2],x[3],x[4],x[5]) != model.getAction(t,op,d,y[0],y[1],y[2],y[3],y[4],y[5]) ||
+               ( (valueTol>0) && fabs(model.getValue(t,op,d,x[0],x[1],x[2],x[3],x[4],x[5]) - model.getValue(t,op,d,y[0],y[1],y[2],y[3],y[4],y[5])) > valueTol*(vMax-vMin) ) )
+            flag[x[v]] = 1;
+        } while (nextIndex(x, sizes));
+      }
+    }
+  }
+
+  // add the center points and recalculate the intervals
+  vector<double> c, stress, strength;
+  int added=0;
+  for(i=0; i<n; i++){
+    c.push_back((*centers)[i]);
+    if (v==0) { stress.push_back(param.stress[i]); strength.push_back(param.strength[i]); }
+    if ( (i<n-1) && flag[i] && (n+added<maxSize) ) {
+      c.push_back( ((*centers)[i]+(*centers)[i+1])/2 );
+      if (v==0) { stress.push_back( (param.stress[i]+param.stress[i+1])/2 ); strength.push_back( (param.strength[i]+param.strength[i+1])/2 ); }
+      added++;
+    }
+  }
+  if (added==0) return(0);
+  vector<double> rowWise;
+  int m = c.size();
+  for(i=0; i<m; i++){
+    rowWise.push_back(c[i]);
+    rowWise.push_back( i==0 ? (*dis)(0,1) : (c[i-1]+c[i])/2 );
+    rowWise.push_back( i==m-1 ? (*dis)(n-1,2) : (c[i]+c[i+1])/2 );
+  }
+  *centers = c;
+  *dis = DisMat(rowWise);
+  if (v==0) { param.stress = stress; param.strength = strength; }
+  return(added);
+}
+
+// ===================================================
+
+MDPV * SolveAdaptive(ModelParam & param, const vector<int> & vars, int levels, double valueTol, ostream & out){
+  const char * names[6] = {"MW", "SW", "MP", "SP", "T", "P"};
+  MDPV * model = new MDPV(param, out);
+  out << "Adaptive solve. Level 0 states: " << model->countStatesMDP() << endl;
+  model->SolveMDP();
+
+  for(int level=1; level<=levels; level++){
+    int added=0;
+    try {
+      for(size_t k=0; k<vars.size(); k++) added += RefineGrid(*model, param, vars[k], valueTol);
+    } catch (...) {
+      delete model;
+      throw;
+    }
+    if (added==0) {
+      out << "No intervals refined at level " << level << "." << endl;
+      break;
+    }
+    delete model;
+    model = new MDPV(param, out);
+    out << "Level " << level << ": added " << added << " center points. States: " << model->countStatesMDP() << endl;
+    model->SolveMDP();
+  }
+
+  for(size_t k=0; k<vars.size(); k++){
+    const vector<double> & c = vars[k]==0 ? param.centerPointsAvgWat : (vars[k]==2 ? param.centerPointsMeanPos : param.centerPointsSdPos);
+    out << "Grid " << names[vars[k]] << ":";
+    for(size_t i=0; i<c.size(); i++) out << " " << c[i];
+    out << endl;
+  }
+  return(model);
+}
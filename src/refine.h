@@ -0,0 +1,48 @@
+#ifndef REFINE_HPP
+#define REFINE_HPP
+
+#include <iostream>
+#include <vector>
+#include "mdp.h"
+
+using namespace std;
+
+// ===================================================
+
+/** Refine the grid of a state variable where the solution of a model changes.
+ *
+ * For each pair of neighbouring intervals (i, i+1) of state variable v the optimal actions and values of the
+ * states only differing in the index of v are compared. If the optimal action differs or the values differ by
+ * more than valueTol times the range of the value function, a center point is added between the two center
+ * points. The discretization matrix is recalculated with the interval limits midway between the center points
+ * (the outer limits are kept). For the mean of the soil water content stress and strength are interpolated.
+ *
+ * @param model A solved model.
+ * @param param The parameters of the model (updated).
+ * @param v State variable (0 = MW, 2 = MP or 3 = SP as in StateEncoder). Throws std::runtime_error otherwise.
+ * @param valueTol Relative value difference (0 = only refine where the optimal action changes).
+ * @param maxSize Max number of intervals of v after refinement.
+ *
+ * @return The number of center points added.
+ */
+int RefineGrid(const MDPV & model, ModelParam & param, int v, double valueTol, int maxSize = 100);
+
+
+/** Solve the model coarse-to-fine.
+ *
+ * The model is solved using the grids given in param. The grids of the state variables in vars are then refined
+ * where the solution changes (see RefineGrid) and the model is solved again on the non-uniform grid. This is
+ * repeated at most levels times or until no intervals are refined.
+ *
+ * @param param The parameters of the coarse model (updated to the final grid).
+ * @param vars The state variables refined.
+ * @param levels Max number of refinements.
+ * @param valueTol See RefineGrid.
+ * @param out Stream used for log output.
+ *
+ * @return The solved model on the final grid (to be deleted by the caller).
+ */
+MDPV * SolveAdaptive(ModelParam & param, const vector<int> & vars, int levels, double valueTol, ostream & out = cout);
+
+
+#endif
@@ -0,0 +1,56 @@
+#include "saa.h"
+#include "distributions.h"
+#include "trace.h"
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+
+// ===================================================
+
+void SaaReport::print(ostream & out) const {
+  out << "Sample average approximation (" << samples << " samples, " << replications << " replications):" << endl;
+  out << "  Mean value of the initial states: " << mean;
+  if (replications>1) out << " (" << 100*level << "% CI [" << lower << ", " << upper << "], sd " << sd << ")";
+  out << endl;
+  out << "  Standard error of an expectation: mean " << meanSe << ", max " << maxSe << endl;
+  out << "  Decisions within 1.96 standard errors: " << 100*close << "%" << endl;
+  out << "  Time per replication: " << seconds << " s" << endl;
+}
+
+// ===================================================
+
+SaaReport SolveSAA(MDPV & model, int samples, int replications, unsigned long long seed, double level){
+  if (samples<=0) throw runtime_error("The number of samples must be positive");
+  if (replications<=0) throw runtime_error("The number of replications must be positive");
+  SaaReport rep;
+  rep.samples = samples;
+  rep.replications = replications;
+  rep.level = level;
+  rep.meanSe = rep.maxSe = rep.close = rep.seconds = 0;
+  long long decisions = 0, close = 0;
+
+  for(int r=0; r<replications; r++){
+    TRACE_SPAN_ARG("replication", r);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    model.setSampling(samples, seed+r);
+    model.SolveMDP();
+    rep.seconds += chrono::duration<double>(chrono::steady_clock::now()-start).count()/replications;
+    rep.values.push_back(model.initialValue());
+    const SampleStats & st = model.sampleStats();
+    rep.meanSe += st.meanSe()/replications;
+    rep.maxSe = max(rep.maxSe, st.maxSe);
+    decisions += st.decisions;
+    close += st.close;
+  }
+  model.setSampling(0);
+  rep.close = decisions>0 ? (double)close/decisions : 0;
+
+  rep.mean = rep.sd = 0;
+  for(int r=0; r<replications; r++) rep.mean += rep.values[r]/replications;
+  for(int r=0; r<replications; r++) rep.sd += (rep.values[r]-rep.mean)*(rep.values[r]-rep.mean);
+  rep.sd = (replications>1) ? sqrt(rep.sd/(replications-1)) : 0;
+  double half = (replications>1) ? tQuantile(1-(1-level)/2, replications-1)*rep.sd/sqrt((double)replications) : 0;
+  rep.lower = rep.mean-half;
+  rep.upper = rep.mean+half;
+  return(rep);
+}
@@ -0,0 +1,50 @@
+#ifndef SAA_HPP
+#define SAA_HPP
+
+#include <iostream>
+#include <vector>
+#include "mdp.h"
+
+using namespace std;
+
+// ===================================================
+
+/** Result of SolveSAA. */
+struct SaaReport {
+  int samples;              // successors drawn for each parent state
+  int replications;         // number of solves (independent seeds)
+  double level;             // confidence level
+  vector<double> values;    // mean value of the initial states of each replication
+  double mean, sd;          // mean and sd of values
+  double lower, upper;      // confidence interval of the mean
+  double meanSe;            // mean standard error of a sampled expectation
+  double maxSe;             // max standard error of a sampled expectation
+  double close;             // fraction of decisions within 1.96 standard errors (see SampleStats)
+  double seconds;           // mean time of a replication
+
+  /** Print the report. */
+  void print(ostream & out) const;
+};
+
+// ===================================================
+
+/** Solve the model using the sample average approximation (see MDPV::setSampling).
+ *
+ * The model is solved replications times with the seeds seed, seed+1, ... and the mean value of the initial states
+ * (MDPV::initialValue) of each solve is recorded. The confidence interval is the t interval of the mean over the
+ * replications. Note that it covers the expected value of the SAA solve, which is biased upwards compared to the
+ * exact solve (the max of noisy estimates). The bias and the share of close decisions shrink with the number of
+ * samples.
+ *
+ * @param model The model (holds the solution of the last replication afterwards).
+ * @param samples Number of successors drawn for each parent state (> 0).
+ * @param replications Number of solves (>= 2 for an interval).
+ * @param seed Seed of the first replication.
+ * @param level Confidence level.
+ *
+ * @return The report. Throws std::runtime_error if samples or replications are not positive.
+ */
+SaaReport SolveSAA(MDPV & model, int samples, int replications, unsigned long long seed = 1, double level = 0.95);
+
+
+#endif
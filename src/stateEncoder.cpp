@@ -0,0 +1,39 @@
+#include "stateEncoder.h"
+#include <algorithm>
+
+// ===================================================
+
+StateEncoder::StateEncoder(const ModelParam & param){
+  const DisMat* src[VARS] = {&param.disAvgWat, &param.disSdWat, &param.disMeanPos, &param.disSdPos, &param.disTem, &param.disPre};
+  for(int v=0; v<VARS; v++) dis[v] = *src[v];
+  opNum = param.opNum;
+  opDMax = (int)*max_element(param.opD.begin(), param.opD.end());
+}
+
+// ===================================================
+
+void StateEncoder::Encode(int n, const double* const x[VARS], int* idx) const {
+  for(int v=0; v<VARS; v++){   // one variable at a time so its intervals stay in cache
+    for(int k=0; k<n; k++) idx[k*VARS+v] = Index(v, x[v][k]);
+  }
+}
+
+// ===================================================
+
+long long StateEncoder::Offset(int t, int op, int d, const int* idx) const {
+  long long off = ((long long)t*opNum+op)*(opDMax+1)+d;
+  for(int v=0; v<VARS; v++){
+    if (idx[v]<0) return(-1);
+    off = off*dis[v].n_rows + idx[v];
+  }
+  return(off);
+}
+
+// ===================================================
+
+void StateEncoder::EncodeOffsets(int n, int t, int op, int d, const double* const x[VARS], long long* off) const {
+  vector<int> idx(n*VARS);
+  if (n==0) return;
+  Encode(n, x, &idx[0]);
+  for(int k=0; k<n; k++) off[k] = Offset(t, op, d, &idx[k*VARS]);
+}
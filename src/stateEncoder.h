@@ -0,0 +1,84 @@
+#ifndef STATEENCODER_HPP
+#define STATEENCODER_HPP
+
+#include <vector>
+#include "param.h"
+
+using namespace std;
+
+// ===================================================
+
+/**
+* Map continuous observations to the indexes of the state variables (iMW, iSW, iMP, iSP, iT, iP).
+*
+* The encoder is built once from the discretization matrices. The interval of an observation is found
+* using DisMat::find (a branch-free binary search over the lower limits of the intervals, the intervals must be
+* sorted as created by \code{setParam}). The batch functions work on arrays so many observations
+* (e.g. all fields in the morning) are encoded in one call.
+*
+* @author Reza Pourmoayed
+*/
+class StateEncoder
+{
+  public:
+
+    /** Number of continuous state variables (soil water mean and sd, posterior mean and sd, temperature, precipitation). */
+    static const int VARS = 6;
+
+    /** Constructor.
+    *
+    * @param param Model parameters holding the discretization matrices.
+    */
+    StateEncoder(const ModelParam & param);
+
+
+    /** The index of the interval of state variable v containing x (-1 if outside the grid or NaN).
+    *
+    * @param v State variable (0 = MW, 1 = SW, 2 = MP, 3 = SP, 4 = T, 5 = P).
+    * @param x Observation.
+    */
+    int Index(int v, double x) const {return(dis[v].find(x));}
+
+
+    /** Encode a batch of n observations.
+    *
+    * @param n Number of observations.
+    * @param x Observations of each state variable (x[v] points to n values of state variable v).
+    * @param idx Output (n*VARS values). The indexes (iMW, iSW, iMP, iSP, iT, iP) of observation k are stored
+    *   in idx[k*VARS] ... idx[k*VARS+5] (-1 if outside the grid or NaN).
+    */
+    void Encode(int n, const double* const x[VARS], int* idx) const;
+
+
+    /** Flat offset of a state in the arrays of the solver (valueFun[t][op][d][iMW][iSW][iMP][iSP][iT][iP]).
+    *
+    * @param t Day.
+    * @param op Tillage operation (zero-based).
+    * @param d Remaining days for finishing operation op.
+    * @param idx The indexes (iMW, iSW, iMP, iSP, iT, iP).
+    *
+    * @return The offset or -1 if one of the indexes is -1.
+    */
+    long long Offset(int t, int op, int d, const int* idx) const;
+
+
+    /** Encode a batch of n observations at day t with operation op and d remaining days directly to offsets (see Offset).
+    *
+    * @param off Output (n values).
+    */
+    void EncodeOffsets(int n, int t, int op, int d, const double* const x[VARS], long long* off) const;
+
+
+    /** Number of intervals of state variable v. */
+    int Size(int v) const {return(dis[v].n_rows);}
+
+
+  private:
+
+    DisMat dis[VARS];             // discretization matrix of each state variable
+    int opNum;
+    int opDMax;
+};
+
+
+#endif
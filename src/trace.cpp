@@ -0,0 +1,135 @@
+#include "trace.h"
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+atomic<bool> Tracer::on(false);
+
+/** The ring buffer of a thread. */
+struct TraceBuffer {
+  vector<TraceEvent> ev;
+  atomic<long long> head;   // number of events recorded (the last ev.size() are kept)
+  int tid;                  // lane in the timeline
+  TraceBuffer(int n, int tid) : ev(n), head(0), tid(tid) {}
+};
+
+static mutex traceMtx;
+static vector<TraceBuffer*> traceBuffers;    // all buffers (never deleted)
+static vector<TraceBuffer*> traceFree;       // buffers of threads that have exited
+static int traceSize = 65536;
+static chrono::steady_clock::time_point traceEpoch = chrono::steady_clock::now();
+
+/** The buffer of the calling thread (returned to traceFree when the thread exits). */
+struct TraceThread {
+  TraceBuffer * buf;
+  TraceThread() : buf(NULL) {}
+  ~TraceThread() {
+    if (buf==NULL) return;
+    lock_guard<mutex> lock(traceMtx);
+    traceFree.push_back(buf);
+  }
+};
+
+static thread_local TraceThread traceThread;
+
+// ===================================================
+
+void Tracer::Enable(int eventsPerThread){
+  lock_guard<mutex> lock(traceMtx);
+  if (eventsPerThread<1) eventsPerThread = 1;
+  traceSize = eventsPerThread;
+  for(size_t i=0; i<traceBuffers.size(); i++){
+    traceBuffers[i]->ev.assign(traceSize, TraceEvent());
+    traceBuffers[i]->head.store(0);
+  }
+  traceEpoch = chrono::steady_clock::now();
+  on.store(true);
+}
+
+// ===================================================
+
+void Tracer::Disable(){
+  on.store(false);
+}
+
+// ===================================================
+
+void Tracer::Clear(){
+  lock_guard<mutex> lock(traceMtx);
+  for(size_t i=0; i<traceBuffers.size(); i++) traceBuffers[i]->head.store(0);
+}
+
+// ===================================================
+
+long long Tracer::Now(){
+  return(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now()-traceEpoch).count());
+}
+
+// ===================================================
+
+void Tracer::Record(const char * name, int arg, long long start, long long end){
+  TraceThread & th = traceThread;
+  if (th.buf==NULL) {
+    lock_guard<mutex> lock(traceMtx);
+    if (!traceFree.empty()) {
+      th.buf = traceFree.back();
+      traceFree.pop_back();
+    } else {
+      th.buf = new TraceBuffer(traceSize, traceBuffers.size());
+      traceBuffers.push_back(th.buf);
+    }
+  }
+  TraceBuffer & b = *th.buf;
+  long long h = b.head.load(memory_order_relaxed);
+  TraceEvent & e = b.ev[h % b.ev.size()];
+  e.name = name;
+  e.start = start;
+  e.dur = end-start;
+  e.arg = arg;
+  b.head.store(h+1, memory_order_release);
+}
+
+// ===================================================
+
+long long Tracer::Dropped(){
+  lock_guard<mutex> lock(traceMtx);
+  long long n = 0;
+  for(size_t i=0; i<traceBuffers.size(); i++){
+    long long h = traceBuffers[i]->head.load(memory_order_acquire);
+    if (h>(long long)traceBuffers[i]->ev.size()) n += h-traceBuffers[i]->ev.size();
+  }
+  return(n);
+}
+
+// ===================================================
+
+int Tracer::WriteChrome(const string & fileName){
+  lock_guard<mutex> lock(traceMtx);
+  FILE* pFile = fopen(fileName.c_str(), "w");
+  if (pFile==NULL) throw runtime_error("Cannot open " + fileName);
+  int n = 0, events = 0;
+  fprintf(pFile, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  for(int tid=0; tid<(int)traceBuffers.size(); tid++){
+    fprintf(pFile, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"thread %d\"}}",
+            n==0 ? "" : ",\n", tid, tid);
+    n++;
+  }
+  for(size_t i=0; i<traceBuffers.size(); i++){
+    const TraceBuffer & b = *traceBuffers[i];
+    long long h = b.head.load(memory_order_acquire), size = b.ev.size();
+    for(long long k=(h>size ? h-size : 0); k<h; k++){
+      const TraceEvent & e = b.ev[k % size];
+      fprintf(pFile, "%s{\"name\":\"%s\",\"cat\":\"mdp\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+              n==0 ? "" : ",\n", e.name, b.tid, e.start/1000.0, e.dur/1000.0);
+      if (e.arg>=0) fprintf(pFile, ",\"args\":{\"arg\":%d}", e.arg);
+      fprintf(pFile, "}");
+      n++;
+      events++;
+    }
+  }
+  fprintf(pFile, "\n]}\n");
+  if (fclose(pFile)!=0) throw runtime_error("Error writing " + fileName);
+  return(events);
+}
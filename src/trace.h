@@ -0,0 +1,107 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <atomic>
+#include <string>
+
+using namespace std;
+
+// Event tracing (timeline of spans). Tracing is toggled at runtime using Tracer::Enable and Tracer::Disable. When
+// it is off a span costs a relaxed atomic load. Define NO_TRACE to remove the spans at compile time.
+//
+// Example. TRACE_SPAN_ARG("stage", t);   // the rest of the scope is recorded as a span named stage with argument t
+//-----------------------------------------------------------------------------
+
+/** An event recorded by a span (complete event in the Chrome trace format). */
+struct TraceEvent {
+  const char * name;     // must be a string literal (only the pointer is stored)
+  long long start;       // ns since Tracer::Enable
+  long long dur;         // ns
+  int arg;               // argument shown in the trace (-1 = none)
+};
+
+// ===================================================
+
+/**
+* Per-thread ring buffers of trace events with export to the Chrome trace JSON format (chrome://tracing or
+* ui.perfetto.dev).
+*
+* Each thread writes to its own ring buffer without locks. A mutex is only used the first time a thread records an
+* event and when a thread exits (the buffer is kept and reused by the next thread, i.e. threads of consecutive
+* thread pools are shown in the same lanes of the timeline). If a buffer is full the oldest
+* events are overwritten. Enable, Clear and WriteChrome must be called while no other thread records events
+* (e.g. before and after a solve).
+*
+* @author Reza Pourmoayed
+*/
+class Tracer
+{
+  public:
+
+    /** Start tracing. Events recorded earlier are removed.
+    *
+    * @param eventsPerThread Size of the ring buffer of each thread.
+    */
+    static void Enable(int eventsPerThread = 65536);
+
+    /** Stop tracing (the recorded events are kept). */
+    static void Disable();
+
+    /** True if tracing is on. */
+    static bool On() {return(on.load(memory_order_relaxed));}
+
+    /** Remove the recorded events. */
+    static void Clear();
+
+    /** Write the recorded events to a file in the Chrome trace JSON format.
+    *
+    * @return The number of events written. Throws std::runtime_error if the file cannot be written.
+    */
+    static int WriteChrome(const string & fileName);
+
+    /** Number of events overwritten because a ring buffer was full. */
+    static long long Dropped();
+
+    /** Current time in ns since tracing was enabled. */
+    static long long Now();
+
+    /** Record a span of the calling thread. */
+    static void Record(const char * name, int arg, long long start, long long end);
+
+  private:
+
+    static atomic<bool> on;
+};
+
+// ===================================================
+
+/** A scoped span: records the time from construction to destruction if tracing is on at construction. */
+class TraceSpan
+{
+  public:
+
+    TraceSpan(const char * name, int arg = -1) : name(name), arg(arg), start(Tracer::On() ? Tracer::Now() : -1) {}
+
+    ~TraceSpan() {
+      if (start>=0) Tracer::Record(name, arg, start, Tracer::Now());
+    }
+
+  private:
+
+    const char * name;
+    int arg;
+    long long start;
+};
+
+#define TRACE_JOIN2(a,b) a##b
+#define TRACE_JOIN(a,b) TRACE_JOIN2(a,b)
+
+#ifdef NO_TRACE
+#define TRACE_SPAN(name)
+#define TRACE_SPAN_ARG(name, arg)
+#else
+#define TRACE_SPAN(name) TraceSpan TRACE_JOIN(traceSpan, __LINE__)(name)
+#define TRACE_SPAN_ARG(name, arg) TraceSpan TRACE_JOIN(traceSpan, __LINE__)(name, arg)
+#endif
+
+#endif